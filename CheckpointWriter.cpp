@@ -0,0 +1,104 @@
+#include "CheckpointWriter.h"
+#include <algorithm>
+
+CheckpointWriter::CheckpointWriter(int every)
+    : written(0), skipped(0), failed(false) {
+    this->every = std::max(every, 1);
+    this->snapshot = nullptr;
+    this->snapshotStep = 0;
+    this->pending = false;
+    this->running = false;
+    this->stopping = false;
+}
+
+CheckpointWriter::~CheckpointWriter() {
+    this->close();
+    delete this->snapshot;
+}
+
+bool CheckpointWriter::open(const std::string& path) {
+    if (this->running) {
+        return false;
+    }
+    this->path = path;
+    this->pending = false;
+    this->stopping = false;
+    this->failed = false;
+    this->running = true;
+    this->writer = std::thread(&CheckpointWriter::writerLoop, this);
+    return true;
+}
+
+bool CheckpointWriter::checkpoint(const Fluid& fluid, long step) {
+    if (!this->running || step % this->every != 0) {
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        if (this->pending) {
+            this->skipped++;
+            return false;
+        }
+    }
+
+    // the writer is idle, so the snapshot is ours until pending is set. This copy is the
+    // only part of a checkpoint the step loop pays for
+    if (this->snapshot == nullptr) {
+        this->snapshot = new Fluid(fluid);
+    } else {
+        *this->snapshot = fluid;
+    }
+    this->snapshotStep = step;
+
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->pending = true;
+    }
+    this->wake.notify_one();
+    return true;
+}
+
+void CheckpointWriter::writerLoop() {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->wake.wait(lock, [this] { return this->stopping || this->pending; });
+            if (!this->pending) {
+                return;  // stopping and nothing left to write
+            }
+        }
+
+        if (this->snapshot->saveCheckpoint(this->path, this->snapshotStep)) {
+            this->written++;
+        } else {
+            this->failed = true;
+        }
+
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->pending = false;
+    }
+}
+
+bool CheckpointWriter::close() {
+    if (!this->running) {
+        return !this->failed;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->wake.notify_one();
+    this->writer.join();
+    this->running = false;
+    return !this->failed;
+}
+
+long CheckpointWriter::checkpointsWritten() const {
+    return this->written;
+}
+
+long CheckpointWriter::checkpointsSkipped() const {
+    return this->skipped;
+}
@@ -0,0 +1,54 @@
+#ifndef CHECKPOINT_WRITER_H
+#define CHECKPOINT_WRITER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "Fluid.h"
+
+// periodic Fluid::saveCheckpoint off the step loop. checkpoint() only copies the Fluid into
+// a snapshot; the file is written on a background thread. If the previous checkpoint is
+// still being written the new one is skipped, the solver never waits for the disk.
+class CheckpointWriter {
+private:
+    std::string path;
+    int every;
+
+    Fluid* snapshot;  // created on the first checkpoint, reused after that
+    long snapshotStep;
+    bool pending;     // snapshot waits for (or is being written by) the writer
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::thread writer;
+    bool running;
+    bool stopping;
+
+    std::atomic<long> written;
+    std::atomic<long> skipped;
+    std::atomic<bool> failed;
+
+    void writerLoop();
+
+public:
+    explicit CheckpointWriter(int every = 100);
+    ~CheckpointWriter();
+
+    CheckpointWriter(const CheckpointWriter&) = delete;
+    CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+    // starts the writer thread; every checkpoint replaces path
+    bool open(const std::string& path);
+    // snapshots the fluid if step is a multiple of `every`. Returns true if a checkpoint
+    // was queued, false if it was not due or the writer is still busy
+    bool checkpoint(const Fluid& fluid, long step);
+    // waits for the queued checkpoint. Returns false if any write failed. Called by the
+    // destructor if still open
+    bool close();
+
+    long checkpointsWritten() const;
+    long checkpointsSkipped() const;
+};
+
+#endif // CHECKPOINT_WRITER_H
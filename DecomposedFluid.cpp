@@ -0,0 +1,369 @@
+#include "DecomposedFluid.h"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+int DecomposedFluid::rankCount(int width, int ranks, int halo) {
+    halo = std::max(halo, 1);
+    return std::max(1, std::min(ranks, width / halo));
+}
+
+DecomposedFluid::DecomposedFluid(int width, int height, float gravity, float density, float overrelax,
+                                 int ranks, int halo, int threadsPerRank, bool pin)
+    : pool(DecomposedFluid::rankCount(width, ranks, halo)) {
+    this->width = width;
+    this->height = height;
+    this->halo = std::max(halo, 1);
+    this->gravity = gravity;
+    this->stride = static_cast<int>(FieldArena::slotSize((height + 2) * sizeof(float)) / sizeof(float));
+    this->dirty = true;
+    this->haloOverruns = 0;
+
+    int numRanks = this->pool.size();
+    this->subdomains.resize(numRanks);
+    for (int rank = 0; rank < numRanks; rank++) {
+        Subdomain& sub = this->subdomains[rank];
+        sub.first = 1 + static_cast<int>(static_cast<long long>(width) * rank / numRanks);
+        sub.last = static_cast<int>(static_cast<long long>(width) * (rank + 1) / numRanks);
+        // the outer strips end at the grid's own ghost columns
+        sub.offset = rank == 0 ? 0 : sub.first - this->halo;
+        int local_last = rank == numRanks - 1 ? width + 1 : sub.last + this->halo;
+        sub.columns = local_last - sub.offset + 1;
+    }
+
+    // halo columns of s, u, v and m at most
+    size_t message = static_cast<size_t>(this->halo) * this->stride * 4;
+    this->transport.reset(new SharedMemoryTransport(numRanks, message * sizeof(float)));
+
+    // every rank allocates (and first touches) its own fields on its own thread
+    this->pool.parallelFor(0, numRanks, [&](int begin, int end) {
+        for (int rank = begin; rank < end; rank++) {
+            this->createRank(rank, density, overrelax, threadsPerRank, pin);
+        }
+    });
+}
+
+DecomposedFluid::~DecomposedFluid() {
+}
+
+void DecomposedFluid::createRank(int rank, float density, float overrelax, int threadsPerRank, bool pin) {
+#if defined(__linux__)
+    if (pin) {
+        // the rank's share of the CPUs; its red-black workers inherit the mask
+        int cpus = static_cast<int>(std::thread::hardware_concurrency());
+        int numRanks = this->getRanks();
+        int cpu_begin = cpus * rank / numRanks;
+        int cpu_end = std::max(cpus * (rank + 1) / numRanks, cpu_begin + 1);
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu = cpu_begin; cpu < cpu_end && cpu < CPU_SETSIZE; cpu++) {
+            CPU_SET(cpu % std::max(cpus, 1), &set);
+        }
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+#else
+    (void)pin;
+#endif
+
+    Subdomain& sub = this->subdomains[rank];
+    sub.fluid.reset(new Fluid(sub.columns - 2, this->height, this->gravity, density, overrelax,
+                              PressureSolver::RedBlack, threadsPerRank));
+    // backtraces in global coordinates round like the single grid's
+    sub.fluid->setColumnOffset(sub.offset);
+    size_t message = static_cast<size_t>(this->halo) * this->stride * 4;
+    sub.toLeft.assign(message, 0.0f);
+    sub.toRight.assign(message, 0.0f);
+    sub.fromLeft.assign(message, 0.0f);
+    sub.fromRight.assign(message, 0.0f);
+}
+
+void DecomposedFluid::exchangeHalo(int rank, bool solid, bool velocity, bool smoke) {
+    Subdomain& sub = this->subdomains[rank];
+    Fluid& fluid = *sub.fluid;
+    int stride = this->stride;
+    int halo = this->halo;
+    int column_size = this->height + 2;
+
+    // fields in message order; s travels as 0 / 1 floats
+    std::vector<const float*> sources;
+    if (velocity) {
+        sources.push_back(fluid.getUField());
+        sources.push_back(fluid.getVField());
+    }
+    if (smoke) {
+        sources.push_back(fluid.getSmokeField());
+    }
+    int count = static_cast<int>(sources.size()) + (solid ? 1 : 0);
+
+    // my first halo owned columns go left, my last halo owned columns go right
+    int send_left = sub.first - sub.offset;
+    int send_right = sub.last - halo + 1 - sub.offset;
+    auto pack = [&](float* out, int i_local) {
+        for (int k = 0; k < halo; k++) {
+            int i = i_local + k;
+            float* column = out + k * count * stride;
+            int f = 0;
+            if (solid) {
+                for (int j = 0; j < column_size; j++) {
+                    column[j] = fluid.isFluid(i, j) ? 1.0f : 0.0f;
+                }
+                f++;
+            }
+            for (const float* source : sources) {
+                std::copy(source + i * stride, source + i * stride + column_size, column + f * stride);
+                f++;
+            }
+        }
+    };
+    pack(sub.toLeft.data(), send_left);
+    pack(sub.toRight.data(), send_right);
+
+    size_t bytes = static_cast<size_t>(halo) * count * stride * sizeof(float);
+    this->transport->exchange(rank, sub.toLeft.data(), sub.toRight.data(),
+                              sub.fromLeft.data(), sub.fromRight.data(), bytes);
+
+    // the pointers of the sources stay valid, nothing swapped since they were taken
+    auto unpack = [&](const float* in, int i_local) {
+        for (int k = 0; k < halo; k++) {
+            int i = i_local + k;
+            const float* column = in + k * count * stride;
+            int f = 0;
+            if (solid) {
+                for (int j = 0; j < column_size; j++) {
+                    fluid.setFluid(i, j, column[j] != 0.0f ? 1 : 0);
+                }
+                f++;
+            }
+            if (velocity) {
+                std::copy(column + f * stride, column + f * stride + column_size, fluid.getUField() + i * stride);
+                std::copy(column + (f + 1) * stride, column + (f + 1) * stride + column_size, fluid.getVField() + i * stride);
+                f += 2;
+            }
+            if (smoke) {
+                for (int j = 0; j < column_size; j++) {
+                    fluid.setSmoke(i, j, column[f * stride + j]);
+                }
+                f++;
+            }
+        }
+    };
+    if (rank > 0) {
+        unpack(sub.fromLeft.data(), 0);
+    }
+    if (rank + 1 < this->getRanks()) {
+        unpack(sub.fromRight.data(), sub.last + 1 - sub.offset);
+    }
+}
+
+void DecomposedFluid::exchangeFaces(int rank, int color) {
+    Subdomain& sub = this->subdomains[rank];
+    float* u = sub.fluid->getUField();
+    int stride = this->stride;
+
+    // the face left of my first column and the face right of my last column
+    int left_face = sub.first - sub.offset;
+    int right_face = sub.last + 1 - sub.offset;
+    std::copy(u + left_face * stride, u + (left_face + 1) * stride, sub.toLeft.begin());
+    std::copy(u + right_face * stride, u + (right_face + 1) * stride, sub.toRight.begin());
+
+    this->transport->exchange(rank, sub.toLeft.data(), sub.toRight.data(),
+                              sub.fromLeft.data(), sub.fromRight.data(), stride * sizeof(float));
+
+    // rows where the neighbour's cell next to the face had this pass's colour are theirs
+    if (rank > 0) {
+        int neighbour = sub.first - 1;
+        for (int j = 1; j <= this->height; j++) {
+            if (((neighbour + j) & 1) == color) {
+                u[left_face * stride + j] = sub.fromLeft[j];
+            }
+        }
+    }
+    if (rank + 1 < this->getRanks()) {
+        int neighbour = sub.last + 1;
+        for (int j = 1; j <= this->height; j++) {
+            if (((neighbour + j) & 1) == color) {
+                u[right_face * stride + j] = sub.fromRight[j];
+            }
+        }
+    }
+}
+
+void DecomposedFluid::stepRank(int rank, float dt, int tot_iter, float g) {
+    Subdomain& sub = this->subdomains[rank];
+    Fluid& fluid = *sub.fluid;
+    int stride = this->stride;
+
+    if (this->dirty) {
+        this->exchangeHalo(rank, true, true, true);
+    }
+
+    fluid.propagateGravity(dt, g);
+    fluid.resetPressure();
+
+    // global colour c is local colour (c + offset) % 2
+    int i_begin = sub.first - sub.offset;
+    int i_end = sub.last + 1 - sub.offset;
+    fluid.prepareRedBlack();
+    for (int iter = 0; iter < tot_iter; iter++) {
+        for (int color = 0; color < 2; color++) {
+            fluid.relaxRedBlack(dt, (color + sub.offset) & 1, i_begin, i_end);
+            this->exchangeFaces(rank, color);
+        }
+    }
+
+    fluid.extrapolate();
+    this->exchangeHalo(rank, false, true, false);
+
+    if (this->getRanks() > 1) {
+        // backtraces start at owned faces and must land inside the local grid
+        const float* u = fluid.getUField();
+        const float* v = fluid.getVField();
+        float largest = 0.0f;
+        for (int c = i_begin * stride; c < (i_end + 1) * stride; c++) {
+            largest = std::max(largest, std::max(std::fabs(u[c]), std::fabs(v[c])));
+        }
+        if (dt * largest + 2.0f > this->halo) {
+            this->haloOverruns.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    fluid.advect(dt);
+    this->exchangeHalo(rank, false, true, false);
+    fluid.advectSmoke(dt);
+    this->exchangeHalo(rank, false, false, true);
+}
+
+void DecomposedFluid::simulate(float dt, int tot_iter, float g) {
+    // one chunk per pool thread, so every rank runs at once and the exchanges can meet
+    this->pool.parallelFor(0, this->getRanks(), [&](int begin, int end) {
+        for (int rank = begin; rank < end; rank++) {
+            this->stepRank(rank, dt, tot_iter, g);
+        }
+    });
+    this->dirty = false;
+}
+
+void DecomposedFluid::setFluid(int i, int j, int value) {
+    this->forEachRankWithColumn(i, [&](Subdomain& sub, int i_local) {
+        sub.fluid->setFluid(i_local, j, value);
+    });
+    this->dirty = true;
+}
+
+void DecomposedFluid::setSmoke(int i, int j, float value) {
+    this->forEachRankWithColumn(i, [&](Subdomain& sub, int i_local) {
+        sub.fluid->setSmoke(i_local, j, value);
+    });
+}
+
+void DecomposedFluid::setU(int i, int j, float value) {
+    this->forEachRankWithColumn(i, [&](Subdomain& sub, int i_local) {
+        sub.fluid->setU(i_local, j, value);
+    });
+}
+
+void DecomposedFluid::setV(int i, int j, float value) {
+    this->forEachRankWithColumn(i, [&](Subdomain& sub, int i_local) {
+        sub.fluid->setV(i_local, j, value);
+    });
+}
+
+int DecomposedFluid::addCircleObstacle(float x, float y, float radius) {
+    // a rank rasterizes its local interior; the halo sync fills in its outermost columns
+    for (Subdomain& sub : this->subdomains) {
+        sub.fluid->addCircleObstacle(x - sub.offset, y, radius);
+    }
+    this->dirty = true;
+    return 0;
+}
+
+void DecomposedFluid::gather(std::vector<float>& out, const std::function<const float*(Fluid&)>& field) {
+    out.resize(this->getFieldSize());
+    int stride = this->stride;
+    int numRanks = this->getRanks();
+    for (int rank = 0; rank < numRanks; rank++) {
+        Subdomain& sub = this->subdomains[rank];
+        const float* f = field(*sub.fluid);
+        int first = rank == 0 ? 0 : sub.first;
+        int last = rank == numRanks - 1 ? this->width + 1 : sub.last;
+        const float* begin = f + (first - sub.offset) * stride;
+        const float* end = f + (last + 1 - sub.offset) * stride;
+        std::copy(begin, end, out.begin() + first * stride);
+    }
+}
+
+float* DecomposedFluid::getPressureField() {
+    this->gather(this->p_view, [](Fluid& fluid) { return fluid.getPressureField(); });
+    return this->p_view.data();
+}
+
+const float* DecomposedFluid::getSmokeField() {
+    this->gather(this->m_view, [](Fluid& fluid) { return fluid.getSmokeField(); });
+    return this->m_view.data();
+}
+
+float* DecomposedFluid::getUField() {
+    this->gather(this->u_view, [](Fluid& fluid) { return fluid.getUField(); });
+    return this->u_view.data();
+}
+
+float* DecomposedFluid::getVField() {
+    this->gather(this->v_view, [](Fluid& fluid) { return fluid.getVField(); });
+    return this->v_view.data();
+}
+
+int DecomposedFluid::getStride() const {
+    return this->stride;
+}
+
+int DecomposedFluid::getFieldSize() const {
+    return (this->width + 2) * this->stride;
+}
+
+int DecomposedFluid::getWidth() const {
+    return this->width;
+}
+
+int DecomposedFluid::getHeight() const {
+    return this->height;
+}
+
+bool DecomposedFluid::setSimdLevel(SimdLevel level) {
+    if (level > detectSimdLevel()) {
+        return false;
+    }
+    for (Subdomain& sub : this->subdomains) {
+        sub.fluid->setSimdLevel(level);
+    }
+    return true;
+}
+
+SimdLevel DecomposedFluid::getSimdLevel() const {
+    return this->subdomains[0].fluid->getSimdLevel();
+}
+
+int DecomposedFluid::getThreadsPerRank() const {
+    return this->subdomains[0].fluid->getNumThreads();
+}
+
+int DecomposedFluid::getRanks() const {
+    return static_cast<int>(this->subdomains.size());
+}
+
+int DecomposedFluid::getHalo() const {
+    return this->halo;
+}
+
+void DecomposedFluid::getRankColumns(int rank, int& first, int& last) const {
+    first = this->subdomains[rank].first;
+    last = this->subdomains[rank].last;
+}
+
+long DecomposedFluid::getHaloOverruns() const {
+    return this->haloOverruns.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,128 @@
+#ifndef DECOMPOSED_FLUID_H
+#define DECOMPOSED_FLUID_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "Fluid.h"
+#include "HaloTransport.h"
+#include "ThreadPool.h"
+
+// one grid split into strips of columns, each stepped by its own Fluid on its own thread
+// (optionally pinned to its share of the CPUs, along with the rank's red-black workers).
+//
+// A rank's Fluid covers its own columns plus `halo` columns of each neighbour. Halo 1 only
+// reuses the ghost border the Fluid constructor adds for the data layout: every backtrace
+// can leave it, so it never gives the single-domain result. Halos travel through a
+// HaloTransport at the points the step needs neighbour data:
+//   - after every red-black colour pass, the u faces on the strip boundaries. A face is
+//     written by the cell of the current colour next to it, so each side takes the rows
+//     its neighbour relaxed
+//   - after extrapolate, u and v (advect backtraces into the neighbours)
+//   - after advect, u and v; after advectSmoke, the smoke
+// The projection is the red-black sweep, whose result does not depend on how the columns
+// are split, so a run gives exactly the fields of a single Fluid with
+// PressureSolver::RedBlack, as long as no backtrace leaves the halo (dt * |velocity| + 2
+// below halo); steps where it might are counted in getHaloOverruns().
+//
+// Setup goes through the Fluid-like setters (so Scenario::setup / apply work unchanged);
+// obstacles are static. Tiles, CG, compact smoke, smoke detail, passive scalars, FLIP and
+// the MacCormack / BFECC advection stay single-domain.
+class DecomposedFluid {
+private:
+    struct Subdomain {
+        std::unique_ptr<Fluid> fluid;
+        int first;    // owned interior columns [first, last], global indices
+        int last;
+        int offset;   // global column of local column 0
+        int columns;  // local padded columns
+        // message buffers
+        std::vector<float> toLeft;
+        std::vector<float> toRight;
+        std::vector<float> fromLeft;
+        std::vector<float> fromRight;
+    };
+
+    int width;   // interior, like the constructor arguments
+    int height;
+    int stride;
+    int halo;
+    float gravity;
+
+    std::vector<Subdomain> subdomains;
+    std::unique_ptr<HaloTransport> transport;
+    ThreadPool pool;  // one thread per rank
+    bool dirty;       // cells were set since the last full halo sync
+    std::atomic<long> haloOverruns;
+
+    // assembled fields for the getters
+    std::vector<float> p_view;
+    std::vector<float> m_view;
+    std::vector<float> u_view;
+    std::vector<float> v_view;
+
+    // ranks lowered until each owns at least halo columns
+    static int rankCount(int width, int ranks, int halo);
+    void createRank(int rank, float density, float overrelax, int threadsPerRank, bool pin);
+    void stepRank(int rank, float dt, int tot_iter, float g);
+    // ships the halo columns of the chosen fields to both neighbours
+    void exchangeHalo(int rank, bool solid, bool velocity, bool smoke);
+    // settles the strip boundary u faces after a pass of global colour `color`
+    void exchangeFaces(int rank, int color);
+    // copies the owned columns of every rank (and the outer ghost columns) into out
+    void gather(std::vector<float>& out, const std::function<const float*(Fluid&)>& field);
+
+    template <typename Fn>
+    void forEachRankWithColumn(int i, Fn fn) {
+        for (Subdomain& sub : this->subdomains) {
+            if (i >= sub.offset && i < sub.offset + sub.columns) {
+                fn(sub, i - sub.offset);
+            }
+        }
+    }
+
+public:
+    // ranks is lowered until every rank owns at least halo columns; the default of 6 covers
+    // backtraces shorter than 4 cells per step. threadsPerRank drives each rank's red-black
+    // sweep. pin binds rank r to the r-th share of the CPUs (Linux)
+    DecomposedFluid(int width, int height, float gravity, float density, float overrelax,
+                    int ranks, int halo = 6, int threadsPerRank = 1, bool pin = false);
+    ~DecomposedFluid();
+
+    DecomposedFluid(const DecomposedFluid&) = delete;
+    DecomposedFluid& operator=(const DecomposedFluid&) = delete;
+
+    void simulate(float dt, int tot_iter, float g);
+
+    void setFluid(int i, int j, int value);
+    void setSmoke(int i, int j, float value);
+    void setU(int i, int j, float value);
+    void setV(int i, int j, float value);
+    // static circle, rasterized by every rank that holds a covered column. Returns 0
+    int addCircleObstacle(float x, float y, float radius);
+
+    // the global fields, assembled from the ranks on every call
+    float* getPressureField();
+    const float* getSmokeField();
+    float* getUField();
+    float* getVField();
+    int getStride() const;
+    int getFieldSize() const;
+    int getWidth() const;
+    int getHeight() const;
+
+    // forwarded to every rank, false (and no change) when the CPU lacks the level
+    bool setSimdLevel(SimdLevel level);
+    SimdLevel getSimdLevel() const;
+    int getThreadsPerRank() const;
+
+    int getRanks() const;
+    int getHalo() const;
+    // owned interior columns of a rank
+    void getRankColumns(int rank, int& first, int& last) const;
+    // rank steps whose backtrace could reach past the halo
+    long getHaloOverruns() const;
+};
+
+#endif // DECOMPOSED_FLUID_H
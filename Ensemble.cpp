@@ -0,0 +1,131 @@
+#include "Ensemble.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+Ensemble::Ensemble(int numThreads) : pool(numThreads) {
+    this->simdLevel = detectSimdLevel();
+}
+
+int Ensemble::add(const EnsembleMember& member) {
+    Scenario scenario(member.width, member.height, member.scenario);
+    scenario.setInflowSpeed(member.inflowSpeed);
+    if (member.circleRadius >= 0.0f) {
+        scenario.setCircle(member.circleX, member.circleY, member.circleRadius);
+    }
+
+    this->members.push_back(member);
+    this->scenarios.push_back(scenario);
+    this->fluids.emplace_back(nullptr);
+    this->stats.emplace_back();
+    return static_cast<int>(this->members.size()) - 1;
+}
+
+int Ensemble::size() const {
+    return static_cast<int>(this->members.size());
+}
+
+int Ensemble::getNumThreads() const {
+    return this->pool.size();
+}
+
+void Ensemble::setSimdLevel(SimdLevel level) {
+    this->simdLevel = level;
+    for (std::unique_ptr<Fluid>& fluid : this->fluids) {
+        if (fluid) {
+            fluid->setSimdLevel(level);
+        }
+    }
+}
+
+void Ensemble::createMember(int k) {
+    const EnsembleMember& member = this->members[k];
+    // one thread per member: the parallelism is across members
+    this->fluids[k].reset(new Fluid(member.width, member.height, member.gravity, member.density,
+                                    member.overrelax, member.solver, 1));
+    this->fluids[k]->setSimdLevel(this->simdLevel);
+    this->scenarios[k].setup(*this->fluids[k]);
+}
+
+float Ensemble::smokeFlux(Fluid& fluid, int i, float dt) {
+    // upwind smoke times the face velocity, h = 1
+    const float* u = fluid.getUField();
+    const float* m = fluid.getSmokeField();
+    int stride = fluid.getStride();
+    float flux = 0.0f;
+    for (int j = 1; j <= fluid.getHeight(); j++) {
+        float face = u[i * stride + j];
+        float smoke = face > 0.0f ? m[(i - 1) * stride + j] : m[i * stride + j];
+        flux += face * smoke * dt;
+    }
+    return flux;
+}
+
+void Ensemble::stepMember(int k, int steps, float dt, int tot_iter) {
+    if (!this->fluids[k]) {
+        this->createMember(k);
+    }
+    Fluid& fluid = *this->fluids[k];
+    const EnsembleMember& member = this->members[k];
+    const Scenario& scenario = this->scenarios[k];
+    EnsembleStats& stats = this->stats[k];
+
+    int plane = 1 + member.width * 3 / 4;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int step = 0; step < steps; step++) {
+        scenario.apply(fluid);
+        fluid.simulate(dt, tot_iter, member.gravity);
+        stats.smokeOutflow += Ensemble::smokeFlux(fluid, plane, dt);
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    stats.steps += steps;
+    stats.stepMs = ms / std::max(steps, 1);
+
+    const float* u = fluid.getUField();
+    const float* v = fluid.getVField();
+    const float* p = fluid.getPressureField();
+    const float* m = fluid.getSmokeField();
+    int stride = fluid.getStride();
+    double pressure = 0.0;
+    double smoke = 0.0;
+    float divergence = 0.0f;
+    int fluidCells = 0;
+    for (int i = 1; i <= member.width; i++) {
+        for (int j = 1; j <= member.height; j++) {
+            int c = i * stride + j;
+            smoke += m[c];
+            if (!fluid.isFluid(i, j)) {
+                continue;
+            }
+            fluidCells++;
+            pressure += p[c];
+            float d = u[c + stride] - u[c] + v[c + 1] - v[c];
+            divergence = std::max(divergence, std::fabs(d));
+        }
+    }
+    stats.meanPressure = fluidCells > 0 ? static_cast<float>(pressure / fluidCells) : 0.0f;
+    stats.maxDivergence = divergence;
+    stats.totalSmoke = static_cast<float>(smoke);
+}
+
+void Ensemble::run(int steps, float dt, int tot_iter) {
+    this->pool.run(this->size(), [&](int k, int) {
+        this->stepMember(k, steps, dt, tot_iter);
+    });
+}
+
+const EnsembleMember& Ensemble::getMember(int k) const {
+    return this->members[k];
+}
+
+const EnsembleStats& Ensemble::getStats(int k) const {
+    return this->stats[k];
+}
+
+Fluid* Ensemble::getFluid(int k) {
+    return this->fluids[k].get();
+}
+
+long Ensemble::stealCount() const {
+    return this->pool.stealCount();
+}
@@ -0,0 +1,83 @@
+#ifndef ENSEMBLE_H
+#define ENSEMBLE_H
+
+#include <memory>
+#include <vector>
+#include "Fluid.h"
+#include "Scenario.h"
+#include "WorkStealingPool.h"
+
+// parameters of one ensemble member. The circle only applies to JetCircle; a negative
+// radius keeps the scenario's default circle
+struct EnsembleMember {
+    int width = 64;
+    int height = 64;
+    ScenarioType scenario = ScenarioType::JetCircle;
+    PressureSolver solver = PressureSolver::GaussSeidel;
+    float gravity = 9.81f;
+    float density = 1.0f;
+    float overrelax = 1.9f;
+    float inflowSpeed = 200.0f;
+    float circleX = 0.0f;
+    float circleY = 0.0f;
+    float circleRadius = -1.0f;
+};
+
+// summary of a member, refreshed by every Ensemble::run
+struct alignas(64) EnsembleStats {
+    long steps = 0;              // steps taken since the member was created
+    double stepMs = 0.0;         // wall time of the last run, per step
+    float meanPressure = 0.0f;   // over the fluid cells, after the last step
+    float maxDivergence = 0.0f;  // largest |div u| of a fluid cell after the last step
+    float totalSmoke = 0.0f;     // smoke on the grid after the last step
+    // smoke carried across the column at 3/4 of the width (downstream of the default
+    // circle), summed over every step since creation
+    float smokeOutflow = 0.0f;
+};
+
+// a batch of independent Fluid instances stepped on a work-stealing pool, one member per
+// task, for parameter sweeps over many small grids. Every member runs single-threaded
+// and is created by the worker that first steps it, so its fields come from that thread's
+// allocator arena (and its memory node) instead of one shared heap.
+class Ensemble {
+private:
+    WorkStealingPool pool;
+    SimdLevel simdLevel;
+
+    std::vector<EnsembleMember> members;
+    std::vector<std::unique_ptr<Fluid>> fluids;
+    std::vector<Scenario> scenarios;
+    std::vector<EnsembleStats> stats;
+
+    // creates the Fluid of member k on the calling thread
+    void createMember(int k);
+    void stepMember(int k, int steps, float dt, int tot_iter);
+    // smoke flux across column i over one step
+    static float smokeFlux(Fluid& fluid, int i, float dt);
+
+public:
+    // numThreads <= 0 uses every hardware thread
+    explicit Ensemble(int numThreads = 0);
+
+    Ensemble(const Ensemble&) = delete;
+    Ensemble& operator=(const Ensemble&) = delete;
+
+    // returns the member index
+    int add(const EnsembleMember& member);
+    int size() const;
+    int getNumThreads() const;
+    // kernel level of every member, the best the CPU supports by default
+    void setSimdLevel(SimdLevel level);
+
+    // steps every member `steps` times and refreshes its stats
+    void run(int steps, float dt, int tot_iter);
+
+    const EnsembleMember& getMember(int k) const;
+    const EnsembleStats& getStats(int k) const;
+    // nullptr until the member has been run once
+    Fluid* getFluid(int k);
+    // tasks moved between workers by the pool so far
+    long stealCount() const;
+};
+
+#endif // ENSEMBLE_H
@@ -0,0 +1,128 @@
+#include "FieldArena.h"
+#include <cstring>
+#include <new>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#define FLUID_HAVE_MMAP
+#endif
+
+namespace {
+const size_t HUGE_PAGE = 2 * 1024 * 1024;
+}
+
+FieldArena::FieldArena() {
+    this->data = nullptr;
+    this->bytes = 0;
+    this->alignment = CACHE_LINE;
+    this->hugePages = false;
+    this->fileMapped = false;
+}
+
+FieldArena::FieldArena(size_t bytes, bool hugePages) {
+    this->alignment = CACHE_LINE;
+    this->hugePages = false;
+    this->fileMapped = false;
+
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    if (hugePages) {
+        // THP only backs whole, aligned 2 MB pages
+        this->alignment = HUGE_PAGE;
+        bytes = (bytes + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+    }
+#endif
+
+    this->bytes = bytes;
+    this->data = static_cast<char*>(::operator new(bytes, std::align_val_t(this->alignment)));
+
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    if (hugePages) {
+        this->hugePages = madvise(this->data, bytes, MADV_HUGEPAGE) == 0;
+    }
+#else
+    (void)hugePages;
+#endif
+
+    // zeroing after madvise lets the first touch fault in huge pages
+    std::memset(this->data, 0, bytes);
+}
+
+FieldArena::~FieldArena() {
+    if (this->data == nullptr) {
+        return;
+    }
+#if defined(FLUID_HAVE_MMAP)
+    if (this->fileMapped) {
+        munmap(this->data, this->bytes);
+        return;
+    }
+#endif
+    ::operator delete(this->data, std::align_val_t(this->alignment));
+}
+
+FieldArena FieldArena::mapFile(const std::string& path, size_t offset, size_t bytes) {
+    FieldArena arena;
+#if defined(FLUID_HAVE_MMAP)
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return arena;
+    }
+    // MAP_PRIVATE keeps the file as it is when the fields are written to. The fd can go
+    // right away, the mapping holds its own reference to the file
+    void* address = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, static_cast<off_t>(offset));
+    close(fd);
+    if (address == MAP_FAILED) {
+        return arena;
+    }
+    arena.data = static_cast<char*>(address);
+    arena.bytes = bytes;
+    arena.fileMapped = true;
+#else
+    (void)path;
+    (void)offset;
+    (void)bytes;
+#endif
+    return arena;
+}
+
+FieldArena::FieldArena(FieldArena&& other) noexcept {
+    this->data = other.data;
+    this->bytes = other.bytes;
+    this->alignment = other.alignment;
+    this->hugePages = other.hugePages;
+    this->fileMapped = other.fileMapped;
+    other.data = nullptr;
+    other.bytes = 0;
+    other.hugePages = false;
+    other.fileMapped = false;
+}
+
+FieldArena& FieldArena::operator=(FieldArena&& other) noexcept {
+    if (this != &other) {
+        std::swap(this->data, other.data);
+        std::swap(this->bytes, other.bytes);
+        std::swap(this->alignment, other.alignment);
+        std::swap(this->hugePages, other.hugePages);
+        std::swap(this->fileMapped, other.fileMapped);
+    }
+    return *this;
+}
+
+char* FieldArena::get() const {
+    return this->data;
+}
+
+size_t FieldArena::size() const {
+    return this->bytes;
+}
+
+bool FieldArena::usesHugePages() const {
+    return this->hugePages;
+}
+
+size_t FieldArena::slotSize(size_t bytes) {
+    return (bytes + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+}
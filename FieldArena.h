@@ -0,0 +1,44 @@
+#ifndef FIELD_ARENA_H
+#define FIELD_ARENA_H
+
+#include <cstddef>
+#include <string>
+
+// one zeroed, 64-byte aligned block that holds every grid field of a Fluid, so each field
+// starts on a cache line and they all share one allocation. With hugePages on Linux the
+// block is rounded up to 2 MB pages and handed to transparent huge pages. An arena can also
+// be a private (copy-on-write) mapping of a file region, see mapFile.
+class FieldArena {
+private:
+    char* data;
+    size_t bytes;
+    size_t alignment;
+    bool hugePages;  // madvise accepted the request
+    bool fileMapped; // data is an mmap of a file, released with munmap
+
+public:
+    static const size_t CACHE_LINE = 64;
+
+    FieldArena();
+    FieldArena(size_t bytes, bool hugePages);
+    ~FieldArena();
+
+    FieldArena(const FieldArena&) = delete;
+    FieldArena& operator=(const FieldArena&) = delete;
+    FieldArena(FieldArena&& other) noexcept;
+    FieldArena& operator=(FieldArena&& other) noexcept;
+
+    char* get() const;
+    size_t size() const;
+    bool usesHugePages() const;
+
+    // maps bytes of path starting at offset (a multiple of the page size) copy-on-write:
+    // pages load on first touch and writes never reach the file. Returns an empty arena
+    // (get() == nullptr) if the file cannot be mapped or the platform has no mmap
+    static FieldArena mapFile(const std::string& path, size_t offset, size_t bytes);
+
+    // bytes rounded up to whole cache lines, the size of one slot in the arena
+    static size_t slotSize(size_t bytes);
+};
+
+#endif // FIELD_ARENA_H
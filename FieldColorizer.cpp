@@ -0,0 +1,144 @@
+#include "FieldColorizer.h"
+#include <algorithm>
+
+FieldColorizer::FieldColorizer(int width, int height, int stride, int smokeFactor, int smokeStride) {
+    this->width = width;
+    this->height = height;
+    this->stride = stride;
+    this->smokeFactor = std::max(smokeFactor, 1);
+    this->smokeStride = this->smokeFactor == 1 ? stride : smokeStride;
+    this->minPressure = 0.0f;
+    this->maxPressure = 0.0f;
+    this->hasRange = false;
+
+    this->buildRamp();
+}
+
+void FieldColorizer::buildRamp() {
+    this->ramp.resize(RAMP_SIZE * 3);
+
+    for (int k = 0; k < RAMP_SIZE; k++) {
+        // same bands as the old getScientificColor in main.cpp, which never reached val == 1
+        float val = std::min(static_cast<float>(k) / (RAMP_SIZE - 1), 0.9999f);
+
+        float m = 0.25f;
+        int num = static_cast<int>(val / m);
+        float s = (val - num * m) / m;
+        float r = 0.0f, g = 0.0f, b = 0.0f;
+
+        switch (num) {
+            case 0: r = 0.0f; g = s; b = 1.0f; break;        // Blue to Cyan
+            case 1: r = 0.0f; g = 1.0f; b = 1.0f - s; break; // Cyan to Green
+            case 2: r = s; g = 1.0f; b = 0.0f; break;        // Green to Yellow
+            case 3: r = 1.0f; g = 1.0f - s; b = 0.0f; break; // Yellow to Red
+        }
+
+        this->ramp[k * 3 + 0] = static_cast<std::uint8_t>(255 * r);
+        this->ramp[k * 3 + 1] = static_cast<std::uint8_t>(255 * g);
+        this->ramp[k * 3 + 2] = static_cast<std::uint8_t>(255 * b);
+    }
+}
+
+void FieldColorizer::fill(const float* pressureField, const float* smokeField, std::uint8_t* rgba) {
+    int stride = this->stride;
+
+    // first frame: there is no previous range to map with yet
+    if (!this->hasRange) {
+        this->minPressure = pressureField[stride + 1];
+        this->maxPressure = pressureField[stride + 1];
+        for (int i = 1; i < this->width + 1; i++) {
+            for (int j = 1; j < this->height + 1; j++) {
+                this->minPressure = std::min(this->minPressure, pressureField[i * stride + j]);
+                this->maxPressure = std::max(this->maxPressure, pressureField[i * stride + j]);
+            }
+        }
+        this->hasRange = true;
+    }
+
+    // map with the range measured last frame and measure this frame's range in the same pass
+    float minVal = this->minPressure;
+    float d = this->maxPressure - this->minPressure;
+    float scale = (d == 0.0f) ? 0.0f : (RAMP_SIZE - 1) / d;
+    int flat = (RAMP_SIZE - 1) / 2;
+
+    float newMin = pressureField[stride + 1];
+    float newMax = newMin;
+
+    if (this->smokeFactor > 1) {
+        this->fillFine(pressureField, smokeField, rgba, minVal, scale, newMin, newMax);
+        this->minPressure = newMin;
+        this->maxPressure = newMax;
+        return;
+    }
+
+    for (int i = 1; i < this->width + 1; i++) {
+        const float* pressureColumn = pressureField + i * stride;
+        const float* smokeColumn = smokeField + i * stride;
+
+        for (int j = 1; j < this->height + 1; j++) {
+            float pressure = pressureColumn[j];
+            newMin = std::min(newMin, pressure);
+            newMax = std::max(newMax, pressure);
+
+            int index = flat;
+            if (scale != 0.0f) {
+                index = static_cast<int>((pressure - minVal) * scale);
+                index = std::max(0, std::min(RAMP_SIZE - 1, index));
+            }
+            const std::uint8_t* color = &this->ramp[index * 3];
+
+            // blend smoke (white) over the pressure colour
+            float smoke = std::max(0.0f, std::min(1.0f, smokeColumn[j]));
+            float clear = 255.0f * (1.0f - smoke);
+
+            std::uint8_t* pixel = rgba + (static_cast<size_t>(j - 1) * this->width + (i - 1)) * 4;
+            pixel[0] = static_cast<std::uint8_t>(color[0] * smoke + clear);
+            pixel[1] = static_cast<std::uint8_t>(color[1] * smoke + clear);
+            pixel[2] = static_cast<std::uint8_t>(color[2] * smoke + clear);
+        }
+    }
+
+    this->minPressure = newMin;
+    this->maxPressure = newMax;
+}
+
+void FieldColorizer::fillFine(const float* pressureField, const float* smokeField, std::uint8_t* rgba,
+                              float minVal, float scale, float& newMin, float& newMax) const {
+    int stride = this->stride;
+    int f = this->smokeFactor;
+    size_t pixelWidth = static_cast<size_t>(this->width) * f;
+    int flat = (RAMP_SIZE - 1) / 2;
+
+    for (int i = 1; i < this->width + 1; i++) {
+        const float* pressureColumn = pressureField + i * stride;
+
+        for (int j = 1; j < this->height + 1; j++) {
+            float pressure = pressureColumn[j];
+            newMin = std::min(newMin, pressure);
+            newMax = std::max(newMax, pressure);
+
+            int index = flat;
+            if (scale != 0.0f) {
+                index = static_cast<int>((pressure - minVal) * scale);
+                index = std::max(0, std::min(RAMP_SIZE - 1, index));
+            }
+            const std::uint8_t* color = &this->ramp[index * 3];
+
+            // the f x f smoke cells of the cell, fine cell (fi, fj) is pixel (fi - 1, fj - 1)
+            for (int a = 0; a < f; a++) {
+                int fi = (i - 1) * f + 1 + a;
+                const float* smokeColumn = smokeField + static_cast<size_t>(fi) * this->smokeStride;
+                for (int b = 0; b < f; b++) {
+                    int fj = (j - 1) * f + 1 + b;
+                    float smoke = std::max(0.0f, std::min(1.0f, smokeColumn[fj]));
+                    float clear = 255.0f * (1.0f - smoke);
+
+                    std::uint8_t* pixel = rgba + (static_cast<size_t>(fj - 1) * pixelWidth + (fi - 1)) * 4;
+                    pixel[0] = static_cast<std::uint8_t>(color[0] * smoke + clear);
+                    pixel[1] = static_cast<std::uint8_t>(color[1] * smoke + clear);
+                    pixel[2] = static_cast<std::uint8_t>(color[2] * smoke + clear);
+                }
+            }
+        }
+    }
+}
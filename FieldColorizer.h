@@ -0,0 +1,43 @@
+#ifndef FIELD_COLORIZER_H
+#define FIELD_COLORIZER_H
+
+#include <cstdint>
+#include <vector>
+
+// maps pressure (scientific colour ramp) blended with smoke to an RGBA pixel buffer in a
+// single pass over the fields. No graphics dependency, so the benchmark can time it.
+class FieldColorizer {
+private:
+    int width;   // interior cells, without the ghost border
+    int height;
+    int stride;  // column stride of the fields
+    int smokeFactor;  // smoke cells per cell along each axis, Fluid::getSmokeResolution()
+    int smokeStride;  // column stride of the smoke field
+
+    // getScientificColor sampled over [0, 1], RGB triplets
+    static const int RAMP_SIZE = 1024;
+    std::vector<std::uint8_t> ramp;
+
+    // pressure range used to map this frame, measured while mapping the previous one
+    float minPressure;
+    float maxPressure;
+    bool hasRange;
+
+    void buildRamp();
+    // fill() with smoke detail: pressure per cell, smoke per fine cell
+    void fillFine(const float* pressureField, const float* smokeField, std::uint8_t* rgba,
+                  float minVal, float scale, float& newMin, float& newMax) const;
+
+public:
+    // stride is Fluid::getStride(). With smoke detail the smoke field is the fine one,
+    // Fluid::getFineSmokeField() with smokeStride Fluid::getFineSmokeStride()
+    FieldColorizer(int width, int height, int stride, int smokeFactor = 1, int smokeStride = 0);
+
+    // fields use the Fluid layout: width + 2 columns of stride floats. rgba holds
+    // width * height pixels, row j-1 / column i-1 for cell (i, j); alpha is left untouched.
+    // With smoke detail it holds width * factor by height * factor pixels, one per fine
+    // smoke cell, each blended over the pressure colour of its cell
+    void fill(const float* pressureField, const float* smokeField, std::uint8_t* rgba);
+};
+
+#endif // FIELD_COLORIZER_H
@@ -0,0 +1,53 @@
+#ifndef FIELD_VIEW_H
+#define FIELD_VIEW_H
+
+#include <algorithm>
+#include <type_traits>
+
+// a window onto one field of a grid: element (i, j) at data[i * stride + j] for i in
+// [0, columns), j in [0, rows). Views of Fluid fields cover the padded grid, so (i, j) is
+// the same cell as in setU(i, j) and columns / rows are getWidth() + 2 / getHeight() + 2.
+// A view owns nothing; T is const for the read-only ones.
+template <typename T>
+struct FieldView {
+    T* data = nullptr;
+    int stride = 0;
+    int columns = 0;
+    int rows = 0;
+
+    FieldView() {}
+    FieldView(T* data, int stride, int columns, int rows)
+        : data(data), stride(stride), columns(columns), rows(rows) {}
+
+    // a writable view reads as a const one
+    template <typename U, typename = typename std::enable_if<std::is_same<const U, T>::value>::type>
+    FieldView(const FieldView<U>& other)
+        : data(other.data), stride(other.stride), columns(other.columns), rows(other.rows) {}
+
+    T& operator()(int i, int j) const {
+        return this->data[i * this->stride + j];
+    }
+
+    // rows contiguous elements of column i
+    T* column(int i) const {
+        return this->data + i * this->stride;
+    }
+
+    bool empty() const {
+        return this->data == nullptr || this->columns <= 0 || this->rows <= 0;
+    }
+
+    // the cells [i0, i0 + columns) x [j0, j0 + rows), clipped to this view
+    FieldView sub(int i0, int j0, int columns, int rows) const {
+        int i_begin = std::max(i0, 0);
+        int j_begin = std::max(j0, 0);
+        int i_end = std::min(i0 + columns, this->columns);
+        int j_end = std::min(j0 + rows, this->rows);
+        if (this->data == nullptr || i_end <= i_begin || j_end <= j_begin) {
+            return FieldView();
+        }
+        return FieldView(this->data + i_begin * this->stride + j_begin, this->stride, i_end - i_begin, j_end - j_begin);
+    }
+};
+
+#endif // FIELD_VIEW_H
@@ -0,0 +1,343 @@
+#include "FlipSolver.h"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include "ThreadPool.h"
+
+namespace {
+
+// bilinear sample of a face component at (x, y), dx / dy place the samples like
+// Fluid::sampleField. Particles stay inside the walls, so only the far corner is clamped
+inline float sampleFace(const float* f, int stride, int width, int height, float h,
+                        float x, float y, float dx, float dy) {
+    float X = (x - dx) / h;
+    float Y = (y - dy) / h;
+    // X, Y >= 0.5, the cast floors
+    int x0 = std::min(static_cast<int>(X), width - 2);
+    int y0 = std::min(static_cast<int>(Y), height - 2);
+    float wx = X - x0;
+    float wy = Y - y0;
+    const float* c = f + x0 * stride + y0;
+    return (1 - wx) * ((1 - wy) * c[0] + wy * c[1]) + wx * ((1 - wy) * c[stride] + wy * c[stride + 1]);
+}
+
+}
+
+FlipSolver::FlipSolver(int width, int height, int stride, float h, int particlesPerCell, float flipRatio, int sortInterval) {
+    this->width = width;
+    this->height = height;
+    this->stride = stride;
+    this->h = h;
+    this->particlesPerCell = std::max(particlesPerCell, 1);
+    this->flipRatio = std::max(std::min(flipRatio, 1.0f), 0.0f);
+    this->sortInterval = std::max(sortInterval, 1);
+    this->stepsSinceSort = 0;
+    this->rng = 0x9e3779b9u;
+}
+
+int FlipSolver::cellOf(float x, float y) const {
+    int i = std::min(static_cast<int>(x / this->h), this->width - 2);
+    int j = std::min(static_cast<int>(y / this->h), this->height - 2);
+    return i * this->stride + j;
+}
+
+float FlipSolver::random() {
+    // xorshift32, the top 24 bits as a float in [0, 1)
+    this->rng ^= this->rng << 13;
+    this->rng ^= this->rng >> 17;
+    this->rng ^= this->rng << 5;
+    return (this->rng >> 8) * (1.0f / 16777216.0f);
+}
+
+void FlipSolver::clampPosition(float& x, float& y) const {
+    x = std::max(std::min(x, (this->width - 1) * this->h), this->h);
+    y = std::max(std::min(y, (this->height - 1) * this->h), this->h);
+}
+
+void FlipSolver::seedCell(int i, int j, int count, int first, const float* u, const float* v) {
+    // one particle per sub-cell of an n x n split, jittered inside it
+    int n = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(this->particlesPerCell))));
+    float h = this->h;
+    FlipParticles& out = this->sorted;
+    for (int k = 0; k < count; k++) {
+        float x = (i + ((k % n) + this->random()) / n) * h;
+        float y = (j + (((k / n) % n) + this->random()) / n) * h;
+        out.x[first + k] = x;
+        out.y[first + k] = y;
+        out.u[first + k] = sampleFace(u, this->stride, this->width, this->height, h, x, y, 0.0f, 0.5f * h);
+        out.v[first + k] = sampleFace(v, this->stride, this->width, this->height, h, x, y, 0.5f * h, 0.0f);
+    }
+}
+
+void FlipSolver::seed(const unsigned char* s, const float* u, const float* v) {
+    this->particles = FlipParticles();
+    this->sortByCell(s, u, v);
+}
+
+void FlipSolver::sortByCell(const unsigned char* s, const float* u, const float* v) {
+    int count = this->particles.size();
+    const FlipParticles& in = this->particles;
+
+    // counting sort: count every cell, lay the cells out in memory order, scatter
+    this->keys.resize(count);
+    this->cellCount.assign(static_cast<size_t>(this->width) * this->stride, 0);
+    this->cellStart.resize(this->cellCount.size());
+    for (int p = 0; p < count; p++) {
+        this->keys[p] = this->cellOf(in.x[p], in.y[p]);
+        this->cellCount[this->keys[p]]++;
+    }
+
+    // cellCount turns into the particles still to place: none in solid cells, at most
+    // cap in crowded ones, and -particlesPerCell for empty fluid cells to reseed
+    int cap = 2 * this->particlesPerCell;
+    int total = 0;
+    for (int i = 1; i < this->width - 1; i++) {
+        for (int j = 1; j < this->height - 1; j++) {
+            int c = i * this->stride + j;
+            this->cellStart[c] = total;
+            if (s[c] == 0) {
+                this->cellCount[c] = 0;
+            } else if (this->cellCount[c] == 0) {
+                this->cellCount[c] = -this->particlesPerCell;
+                total += this->particlesPerCell;
+            } else {
+                this->cellCount[c] = std::min(this->cellCount[c], cap);
+                total += this->cellCount[c];
+            }
+        }
+    }
+
+    FlipParticles& out = this->sorted;
+    out.x.resize(total);
+    out.y.resize(total);
+    out.u.resize(total);
+    out.v.resize(total);
+    for (int p = 0; p < count; p++) {
+        int c = this->keys[p];
+        if (this->cellCount[c] <= 0) {
+            continue;
+        }
+        int d = this->cellStart[c]++;
+        this->cellCount[c]--;
+        out.x[d] = in.x[p];
+        out.y[d] = in.y[p];
+        out.u[d] = in.u[p];
+        out.v[d] = in.v[p];
+    }
+    for (int i = 1; i < this->width - 1; i++) {
+        for (int j = 1; j < this->height - 1; j++) {
+            int c = i * this->stride + j;
+            if (this->cellCount[c] < 0) {
+                this->seedCell(i, j, this->particlesPerCell, this->cellStart[c], u, v);
+            }
+        }
+    }
+
+    std::swap(this->particles, this->sorted);
+    this->stepsSinceSort = 0;
+}
+
+void FlipSolver::binColumns() {
+    int count = this->particles.size();
+    const float* x = this->particles.x.data();
+
+    this->keys.resize(count);
+    this->columnStart.assign(this->width + 1, 0);
+    for (int p = 0; p < count; p++) {
+        int i = std::min(static_cast<int>(x[p] / this->h), this->width - 2);
+        this->keys[p] = i;
+        this->columnStart[i + 1]++;
+    }
+    for (int i = 0; i < this->width; i++) {
+        this->columnStart[i + 1] += this->columnStart[i];
+    }
+
+    // stable, so sorted particles keep their order
+    std::vector<int>& cursor = this->cellStart;
+    cursor.assign(this->columnStart.begin(), this->columnStart.end() - 1);
+    this->order.resize(count);
+    for (int p = 0; p < count; p++) {
+        this->order[cursor[this->keys[p]]++] = p;
+    }
+}
+
+void FlipSolver::splatColumns(int i_begin, int i_end, const unsigned char* s, float* sum_u, float* sum_v,
+                              float* weight_u, float* weight_v) const {
+    const FlipParticles& in = this->particles;
+    int stride = this->stride;
+    float h = this->h;
+
+    for (int k = this->columnStart[i_begin]; k < this->columnStart[i_end]; k++) {
+        int p = this->order[k];
+        float x = in.x[p];
+        float y = in.y[p];
+        // particles the obstacles moved over carry nothing
+        if (s[this->cellOf(x, y)] == 0) {
+            continue;
+        }
+
+        // u at (i h, (j + 1/2) h), v at ((i + 1/2) h, j h), tent weights like sampleFace
+        float X = x / h;
+        float Y = y / h - 0.5f;
+        int x0 = std::min(static_cast<int>(X), this->width - 2);
+        int y0 = std::min(static_cast<int>(Y), this->height - 2);
+        float wx = X - x0;
+        float wy = Y - y0;
+        int c = x0 * stride + y0;
+        float w00 = (1 - wx) * (1 - wy), w01 = (1 - wx) * wy, w10 = wx * (1 - wy), w11 = wx * wy;
+        float pu = in.u[p];
+        sum_u[c] += w00 * pu;
+        sum_u[c + 1] += w01 * pu;
+        sum_u[c + stride] += w10 * pu;
+        sum_u[c + stride + 1] += w11 * pu;
+        weight_u[c] += w00;
+        weight_u[c + 1] += w01;
+        weight_u[c + stride] += w10;
+        weight_u[c + stride + 1] += w11;
+
+        X = x / h - 0.5f;
+        Y = y / h;
+        x0 = std::min(static_cast<int>(X), this->width - 2);
+        y0 = std::min(static_cast<int>(Y), this->height - 2);
+        wx = X - x0;
+        wy = Y - y0;
+        c = x0 * stride + y0;
+        w00 = (1 - wx) * (1 - wy), w01 = (1 - wx) * wy, w10 = wx * (1 - wy), w11 = wx * wy;
+        float pv = in.v[p];
+        sum_v[c] += w00 * pv;
+        sum_v[c + 1] += w01 * pv;
+        sum_v[c + stride] += w10 * pv;
+        sum_v[c + stride + 1] += w11 * pv;
+        weight_v[c] += w00;
+        weight_v[c + 1] += w01;
+        weight_v[c + stride] += w10;
+        weight_v[c + stride + 1] += w11;
+    }
+}
+
+void FlipSolver::particleToGrid(float* u, float* v, float* prev_u, float* prev_v, float* weight_u, float* weight_v,
+                                const unsigned char* s, ThreadPool* pool) {
+    if (++this->stepsSinceSort >= this->sortInterval) {
+        this->sortByCell(s, u, v);
+    }
+    this->binColumns();
+
+    int stride = this->stride;
+    int width = this->width;
+    int height = this->height;
+
+    // prev_u / prev_v collect the weighted sums first
+    pool->parallelFor(0, width, [&](int i_begin, int i_end) {
+        size_t begin = static_cast<size_t>(i_begin) * stride;
+        size_t end = static_cast<size_t>(i_end) * stride;
+        std::fill(prev_u + begin, prev_u + end, 0.0f);
+        std::fill(prev_v + begin, prev_v + end, 0.0f);
+        std::fill(weight_u + begin, weight_u + end, 0.0f);
+        std::fill(weight_v + begin, weight_v + end, 0.0f);
+    });
+
+    int batches = (width - 2 + BATCH_COLUMNS - 1) / BATCH_COLUMNS;
+    for (int color = 0; color < 2; color++) {
+        pool->parallelFor(0, (batches - color + 1) / 2, [&](int k_begin, int k_end) {
+            for (int k = k_begin; k < k_end; k++) {
+                int i_begin = 1 + (2 * k + color) * BATCH_COLUMNS;
+                int i_end = std::min(i_begin + BATCH_COLUMNS, width - 1);
+                this->splatColumns(i_begin, i_end, s, prev_u, prev_v, weight_u, weight_v);
+            }
+        });
+    }
+
+    // the faces advect would update: interior, between two fluid cells
+    pool->parallelFor(0, width, [&](int i_begin, int i_end) {
+        for (int i = i_begin; i < i_end; i++) {
+            bool interior = i >= 1 && i < width - 1;
+            for (int j = 0; j < height; j++) {
+                int c = i * stride + j;
+                bool inside = interior && j >= 1 && j < height - 1 && s[c] != 0;
+                if (inside && s[c - stride] != 0 && weight_u[c] > 0.0f) {
+                    u[c] = prev_u[c] / weight_u[c];
+                }
+                if (inside && s[c - 1] != 0 && weight_v[c] > 0.0f) {
+                    v[c] = prev_v[c] / weight_v[c];
+                }
+                prev_u[c] = u[c];
+                prev_v[c] = v[c];
+            }
+        }
+    });
+}
+
+void FlipSolver::gridToParticle(const float* u, const float* v, const float* prev_u, const float* prev_v,
+                                const unsigned char* s, float dt, ThreadPool* pool) {
+    FlipParticles& p = this->particles;
+    int stride = this->stride;
+    int width = this->width;
+    int height = this->height;
+    float h = this->h;
+    float h2 = 0.5f * h;
+    float ratio = this->flipRatio;
+
+    pool->parallelFor(0, p.size(), [&](int begin, int end) {
+        for (int k = begin; k < end; k++) {
+            float x = p.x[k];
+            float y = p.y[k];
+            float grid_u = sampleFace(u, stride, width, height, h, x, y, 0.0f, h2);
+            float grid_v = sampleFace(v, stride, width, height, h, x, y, h2, 0.0f);
+            float old_u = sampleFace(prev_u, stride, width, height, h, x, y, 0.0f, h2);
+            float old_v = sampleFace(prev_v, stride, width, height, h, x, y, h2, 0.0f);
+            // FLIP keeps the particle's own velocity and adds what the grid stages changed
+            p.u[k] = ratio * (p.u[k] + grid_u - old_u) + (1.0f - ratio) * grid_u;
+            p.v[k] = ratio * (p.v[k] + grid_v - old_v) + (1.0f - ratio) * grid_v;
+
+            // midpoint through the divergence-free grid velocity
+            float mid_x = x + 0.5f * dt * grid_u;
+            float mid_y = y + 0.5f * dt * grid_v;
+            this->clampPosition(mid_x, mid_y);
+            float new_x = x + dt * sampleFace(u, stride, width, height, h, mid_x, mid_y, 0.0f, h2);
+            float new_y = y + dt * sampleFace(v, stride, width, height, h, mid_x, mid_y, h2, 0.0f);
+            this->clampPosition(new_x, new_y);
+            if (s[this->cellOf(new_x, new_y)] != 0) {
+                p.x[k] = new_x;
+                p.y[k] = new_y;
+            }
+        }
+    });
+}
+
+int FlipSolver::getParticlesPerCell() const {
+    return this->particlesPerCell;
+}
+
+float FlipSolver::getFlipRatio() const {
+    return this->flipRatio;
+}
+
+void FlipSolver::setFlipRatio(float flipRatio) {
+    this->flipRatio = std::max(std::min(flipRatio, 1.0f), 0.0f);
+}
+
+int FlipSolver::getSortInterval() const {
+    return this->sortInterval;
+}
+
+void FlipSolver::setSortInterval(int sortInterval) {
+    this->sortInterval = std::max(sortInterval, 1);
+}
+
+const FlipParticles& FlipSolver::getParticles() const {
+    return this->particles;
+}
+
+int FlipSolver::getStepsSinceSort() const {
+    return this->stepsSinceSort;
+}
+
+unsigned int FlipSolver::getRandomState() const {
+    return this->rng;
+}
+
+void FlipSolver::setState(FlipParticles particles, int stepsSinceSort, unsigned int rng) {
+    this->particles = std::move(particles);
+    this->stepsSinceSort = stepsSinceSort;
+    this->rng = rng;
+}
@@ -0,0 +1,104 @@
+#ifndef FLIP_SOLVER_H
+#define FLIP_SOLVER_H
+
+#include <vector>
+
+class ThreadPool;
+
+// particle state of the FLIP / PIC mode, one array per component. Positions are in the
+// same units as the backtraces of Fluid::advect: cell (i, j) covers [i h, (i + 1) h) x
+// [j h, (j + 1) h) of the padded grid
+struct FlipParticles {
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> u;
+    std::vector<float> v;
+
+    int size() const {
+        return static_cast<int>(this->x.size());
+    }
+};
+
+// velocity carried on particles through the staggered grid of a Fluid (Zhu & Bridson,
+// "Animating Sand as a Fluid", 2005). Every step the particles are splatted onto the u / v
+// faces, the Fluid projects the grid, and the particles pick up the change of their faces
+// (FLIP) blended with the new face velocities (PIC) before moving through the grid.
+// Nothing is resampled on the grid, so vortices do not lose energy to interpolation.
+//
+// A particle in column i only writes faces of columns i - 1 to i + 1, so the splat runs in
+// batches of BATCH_COLUMNS columns coloured alternately: batches of one colour never share
+// a face and run in parallel without atomics, then the other colour follows. Particles
+// are binned by column every step for that (a permutation of indices only), and every
+// sortInterval steps the arrays themselves are sorted by cell so the batches and the
+// grid-to-particle pass walk memory in order. The sort also drops particles in solid
+// cells, caps crowded cells at twice particlesPerCell and reseeds empty fluid cells.
+// Every face sums its particles in the same order whatever the thread count.
+class FlipSolver {
+private:
+    static const int BATCH_COLUMNS = 4;
+
+    int width;   // padded, like Fluid::width
+    int height;
+    int stride;
+    float h;
+
+    int particlesPerCell;
+    float flipRatio;
+    int sortInterval;
+    int stepsSinceSort;
+    unsigned int rng;  // jitter of reseeded particles
+
+    FlipParticles particles;
+    FlipParticles sorted;  // sort target, swapped in
+
+    std::vector<int> keys;         // cell of every particle
+    std::vector<int> cellStart;    // sort scratch, per cell
+    std::vector<int> cellCount;
+    std::vector<int> order;        // particle indices grouped by column
+    std::vector<int> columnStart;  // width + 1 offsets into order
+
+    int cellOf(float x, float y) const;
+    float random();
+    // count particles with jittered positions in cell (i, j) at index first, velocity
+    // sampled from the grid
+    void seedCell(int i, int j, int count, int first, const float* u, const float* v);
+    void sortByCell(const unsigned char* s, const float* u, const float* v);
+    void binColumns();
+    void splatColumns(int i_begin, int i_end, const unsigned char* s, float* sum_u, float* sum_v,
+                      float* weight_u, float* weight_v) const;
+    void clampPosition(float& x, float& y) const;
+
+public:
+    // same dimensions and column stride as the Fluid fields it moves through
+    FlipSolver(int width, int height, int stride, float h, int particlesPerCell, float flipRatio, int sortInterval);
+
+    // replaces the particles with particlesPerCell jittered ones in every interior fluid
+    // cell, moving with the grid velocity
+    void seed(const unsigned char* s, const float* u, const float* v);
+
+    // sets every face between two interior fluid cells that has particles around to their
+    // weighted average velocity, other faces keep theirs. prev_u / prev_v get the result,
+    // for the FLIP update after the projection. weight_u / weight_v are scratch, all four
+    // are full fields
+    void particleToGrid(float* u, float* v, float* prev_u, float* prev_v, float* weight_u, float* weight_v,
+                        const unsigned char* s, ThreadPool* pool);
+    // the particles take the change of the grid since particleToGrid (FLIP) blended with the
+    // new grid velocity (PIC) and move dt through the new grid (midpoint rule). A particle
+    // whose move ends in a solid cell stays where it is
+    void gridToParticle(const float* u, const float* v, const float* prev_u, const float* prev_v,
+                        const unsigned char* s, float dt, ThreadPool* pool);
+
+    int getParticlesPerCell() const;
+    float getFlipRatio() const;
+    void setFlipRatio(float flipRatio);
+    int getSortInterval() const;
+    void setSortInterval(int sortInterval);
+
+    const FlipParticles& getParticles() const;
+    // checkpoint state: the particles, the steps since the last sort and the jitter state
+    int getStepsSinceSort() const;
+    unsigned int getRandomState() const;
+    void setState(FlipParticles particles, int stepsSinceSort, unsigned int rng);
+};
+
+#endif // FLIP_SOLVER_H
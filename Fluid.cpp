@@ -1,58 +1,386 @@
 #include "Fluid.h"
+#include "ThreadPool.h"
+#include "PcgSolver.h"
+#include "FlipSolver.h"
 #include <algorithm>
-#include <string>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
 
-Fluid::Fluid(int width, int height, float gravity,float density,float overrelax) {
+namespace {
+
+unsigned char* copyFlags(const unsigned char* src, int count) {
+    if (src == nullptr) {
+        return nullptr;
+    }
+    unsigned char* dst = new unsigned char[count];
+    std::copy(src, src + count, dst);
+    return dst;
+}
+
+}
+
+Fluid::Fluid(int width, int height, float gravity,float density,float overrelax, PressureSolver solver, int numThreads, bool hugePages) {
     // give buffer for easy calculation later
     this->width = width + 2;
     this->height = height + 2;
     this->gravity = gravity;
     this->density = density;
-    this->totCells = this->width * this->height;
+    // pad columns to whole cache lines so every column of every field starts aligned
+    this->stride = static_cast<int>(FieldArena::slotSize(this->height * sizeof(float)) / sizeof(float));
+    this->totCells = this->width * this->stride;
     this->overrelax = overrelax;
-    this->u = new float[this->totCells];
-    this->v = new float[this->totCells];
-    this->s = new int[this->totCells];
-    this->p = new float[this->totCells];
-    this->m = new float[this->totCells];
-    
-    this->temp_u = new float[this->totCells];
-    this->temp_v = new float[this->totCells];
-    this->temp_f = new float[this->totCells];
-    this->temp_m = new float[this->totCells];
-    
-    for(int i = 0; i < this->totCells; i++) {
-        this->u[i] = 0.0f;
-        this->v[i] = 0.0f;
-        this->s[i] = 0;
-        this->p[i] = 0.0f;
-        this->m[i] = 0.0f;
-    }
+
+    // one zeroed block for all fields: u = v = p = m = 0 and s = 0 (solid) everywhere.
+    // zero bits are 0.0 in every smoke storage
+    this->smokeStorage = SmokeStorage::Float32;
+    this->smoke_view = nullptr;
+    this->arena = FieldArena(Fluid::slotOffset(Fluid::FIELD_COUNT, this->totCells, this->smokeStorage), hugePages);
+    this->assignFields(this->arena.get());
+    this->scalars = nullptr;
+    this->temp_scalars = nullptr;
+    this->smokeFactor = 1;
+    this->fineWidth = 0;
+    this->fineHeight = 0;
+    this->fineStride = 0;
+    this->fine_m = nullptr;
+    this->temp_fine_m = nullptr;
     
     this->h = 1.0;
+
+    this->pressureSolver = solver;
+    this->numThreads = numThreads;
+    this->pool = nullptr;
+
+    this->pcg = nullptr;
+    this->flip = nullptr;
+    this->pcgTolerance = 1e-3f;
+    this->pcgMaxIter = 500;
+
+    this->simdLevel = detectSimdLevel();
+
+    this->obstacle_cells = nullptr;
+
+    this->columnOffset = 0;
+
+    this->advectionScheme = AdvectionScheme::SemiLagrangian;
+    this->temporalBlocking = 0;
+
+    this->cflNumber = 0.0f;
+    this->maxSubsteps = 16;
+    this->profiler = nullptr;
+
+    this->tileSize = 0;
+    this->tilesX = 0;
+    this->tilesY = 0;
+    this->tileThreshold = 1e-4f;
+    this->tile_flow = nullptr;
+    this->tile_smoke = nullptr;
+    this->tile_scratch = nullptr;
 }
 
 Fluid::~Fluid() {
-    delete[] this->u;
-    delete[] this->v;
-    delete[] this->s;
-    delete[] this->p;
-    delete[] this->m;
-    delete[] this->temp_u;
-    delete[] this->temp_v;
-    delete[] this->temp_f;
-    delete[] this->temp_m;
+    this->release();
+}
+
+Fluid::Fluid(const Fluid& other) {
+    this->copySettings(other);
+
+    this->arena = FieldArena(other.arena.size(), other.arena.usesHugePages());
+    std::copy(other.arena.get(), other.arena.get() + other.arena.size(), this->arena.get());
+
+    // same offsets as in other; the front / back buffers may have been swapped there
+    char* base = this->arena.get();
+    const char* other_base = other.arena.get();
+    auto rebase = [&](const void* field) {
+        return base + (static_cast<const char*>(field) - other_base);
+    };
+    this->u = reinterpret_cast<float*>(rebase(other.u));
+    this->v = reinterpret_cast<float*>(rebase(other.v));
+    this->s = reinterpret_cast<unsigned char*>(rebase(other.s));
+    this->p = reinterpret_cast<float*>(rebase(other.p));
+    this->m = reinterpret_cast<unsigned char*>(rebase(other.m));
+    this->temp_u = reinterpret_cast<float*>(rebase(other.temp_u));
+    this->temp_v = reinterpret_cast<float*>(rebase(other.temp_v));
+    this->temp_m = reinterpret_cast<unsigned char*>(rebase(other.temp_m));
+    this->s_mask = reinterpret_cast<float*>(rebase(other.s_mask));
+    this->smoke_view = nullptr;
+
+    this->scalar_arena = FieldArena(other.scalar_arena.size(), false);
+    std::copy(other.scalar_arena.get(), other.scalar_arena.get() + other.scalar_arena.size(), this->scalar_arena.get());
+    this->scalars = nullptr;
+    this->temp_scalars = nullptr;
+    if (other.scalars != nullptr) {
+        char* scalar_base = this->scalar_arena.get();
+        const char* other_scalar_base = other.scalar_arena.get();
+        this->scalars = reinterpret_cast<float*>(scalar_base + (reinterpret_cast<const char*>(other.scalars) - other_scalar_base));
+        this->temp_scalars = reinterpret_cast<float*>(scalar_base + (reinterpret_cast<const char*>(other.temp_scalars) - other_scalar_base));
+    }
+
+    this->fine_arena = FieldArena(other.fine_arena.size(), false);
+    std::copy(other.fine_arena.get(), other.fine_arena.get() + other.fine_arena.size(), this->fine_arena.get());
+    this->fine_m = nullptr;
+    this->temp_fine_m = nullptr;
+    if (other.fine_m != nullptr) {
+        char* fine_base = this->fine_arena.get();
+        const char* other_fine_base = other.fine_arena.get();
+        this->fine_m = reinterpret_cast<float*>(fine_base + (reinterpret_cast<const char*>(other.fine_m) - other_fine_base));
+        this->temp_fine_m = reinterpret_cast<float*>(fine_base + (reinterpret_cast<const char*>(other.temp_fine_m) - other_fine_base));
+    }
+
+    this->pool = nullptr;
+    this->pcg = nullptr;
+    this->profiler = nullptr;
+    // the particles are state, unlike the solver caches
+    this->flip = other.flip != nullptr ? new FlipSolver(*other.flip) : nullptr;
+
+    this->obstacles = other.obstacles;
+    this->emitters = other.emitters;
+    this->obstacle_cells = copyFlags(other.obstacle_cells, this->totCells);
+
+    int tiles = this->tilesX * this->tilesY;
+    this->tile_flow = copyFlags(other.tile_flow, tiles);
+    this->tile_smoke = copyFlags(other.tile_smoke, tiles);
+    this->tile_scratch = copyFlags(other.tile_scratch, tiles);
+}
+
+Fluid& Fluid::operator=(const Fluid& other) {
+    if (this != &other) {
+        Fluid copy(other);
+        this->release();
+        this->steal(copy);
+    }
+    return *this;
+}
+
+Fluid::Fluid(Fluid&& other) noexcept {
+    this->steal(other);
+}
+
+Fluid& Fluid::operator=(Fluid&& other) noexcept {
+    if (this != &other) {
+        this->release();
+        this->steal(other);
+    }
+    return *this;
+}
+
+void Fluid::copySettings(const Fluid& other) {
+    this->width = other.width;
+    this->height = other.height;
+    this->stride = other.stride;
+    this->totCells = other.totCells;
+    this->gravity = other.gravity;
+    this->density = other.density;
+    this->overrelax = other.overrelax;
+    this->h = other.h;
+    this->smokeStorage = other.smokeStorage;
+    this->scalar_names = other.scalar_names;
+    this->smokeFactor = other.smokeFactor;
+    this->fineWidth = other.fineWidth;
+    this->fineHeight = other.fineHeight;
+    this->fineStride = other.fineStride;
+
+    this->pressureSolver = other.pressureSolver;
+    this->numThreads = other.numThreads;
+    this->pcgTolerance = other.pcgTolerance;
+    this->pcgMaxIter = other.pcgMaxIter;
+    this->stats = other.stats;
+    this->simdLevel = other.simdLevel;
+    this->columnOffset = other.columnOffset;
+    this->advectionScheme = other.advectionScheme;
+    this->temporalBlocking = other.temporalBlocking;
+    this->cflNumber = other.cflNumber;
+    this->maxSubsteps = other.maxSubsteps;
+
+    this->tileSize = other.tileSize;
+    this->tilesX = other.tilesX;
+    this->tilesY = other.tilesY;
+    this->tileThreshold = other.tileThreshold;
+}
+
+void Fluid::release() {
+    // the fields go with the arena
+    this->arena = FieldArena();
+    this->u = nullptr;
+    this->v = nullptr;
+    this->s = nullptr;
+    this->p = nullptr;
+    this->m = nullptr;
+    this->temp_u = nullptr;
+    this->temp_v = nullptr;
+    this->temp_m = nullptr;
+    this->s_mask = nullptr;
+
+    delete[] this->smoke_view;
+    this->smoke_view = nullptr;
+    this->scalar_arena = FieldArena();
+    this->scalars = nullptr;
+    this->temp_scalars = nullptr;
+    this->scalar_names.clear();
+    this->advect_arena = FieldArena();
+    this->fine_arena = FieldArena();
+    this->fine_m = nullptr;
+    this->temp_fine_m = nullptr;
+    delete this->pool;
+    delete this->pcg;
+    delete this->flip;
+    delete this->profiler;
+    delete[] this->obstacle_cells;
+    delete[] this->tile_flow;
+    delete[] this->tile_smoke;
+    delete[] this->tile_scratch;
+    this->pool = nullptr;
+    this->pcg = nullptr;
+    this->flip = nullptr;
+    this->profiler = nullptr;
+    this->obstacle_cells = nullptr;
+    this->tile_flow = nullptr;
+    this->tile_smoke = nullptr;
+    this->tile_scratch = nullptr;
+    this->obstacles.clear();
+    this->emitters.clear();
+}
+
+void Fluid::steal(Fluid& other) {
+    this->copySettings(other);
+
+    this->arena = std::move(other.arena);
+    this->u = other.u;
+    this->v = other.v;
+    this->s = other.s;
+    this->p = other.p;
+    this->m = other.m;
+    this->temp_u = other.temp_u;
+    this->temp_v = other.temp_v;
+    this->temp_m = other.temp_m;
+    this->s_mask = other.s_mask;
+    this->smoke_view = other.smoke_view;
+    this->scalar_arena = std::move(other.scalar_arena);
+    this->scalars = other.scalars;
+    this->temp_scalars = other.temp_scalars;
+    this->advect_arena = std::move(other.advect_arena);
+    this->fine_arena = std::move(other.fine_arena);
+    this->fine_m = other.fine_m;
+    this->temp_fine_m = other.temp_fine_m;
+
+    this->pool = other.pool;
+    this->pcg = other.pcg;
+    this->flip = other.flip;
+    this->profiler = other.profiler;
+    this->obstacles = std::move(other.obstacles);
+    this->emitters = std::move(other.emitters);
+    this->obstacle_cells = other.obstacle_cells;
+    this->tile_flow = other.tile_flow;
+    this->tile_smoke = other.tile_smoke;
+    this->tile_scratch = other.tile_scratch;
+
+    // leave other empty; its destructor then has nothing left to free
+    other.arena = FieldArena();
+    other.u = nullptr;
+    other.v = nullptr;
+    other.s = nullptr;
+    other.p = nullptr;
+    other.m = nullptr;
+    other.temp_u = nullptr;
+    other.temp_v = nullptr;
+    other.temp_m = nullptr;
+    other.s_mask = nullptr;
+    other.smoke_view = nullptr;
+    other.scalar_arena = FieldArena();
+    other.scalars = nullptr;
+    other.temp_scalars = nullptr;
+    other.fine_arena = FieldArena();
+    other.fine_m = nullptr;
+    other.temp_fine_m = nullptr;
+    other.pool = nullptr;
+    other.pcg = nullptr;
+    other.flip = nullptr;
+    other.profiler = nullptr;
+    other.obstacle_cells = nullptr;
+    other.tile_flow = nullptr;
+    other.tile_smoke = nullptr;
+    other.tile_scratch = nullptr;
+}
+
+size_t Fluid::slotOffset(int slot, int totCells, SmokeStorage storage) {
+    // bytes per element of u, v, s, p, m, temp_u, temp_v, temp_m, s_mask
+    int smoke = smokeStorageBytes(storage);
+    const int element_bytes[FIELD_COUNT] = {4, 4, 1, 4, smoke, 4, 4, smoke, 4};
+
+    size_t offset = 0;
+    for (int k = 0; k < slot; k++) {
+        offset += FieldArena::slotSize(static_cast<size_t>(totCells) * element_bytes[k]);
+    }
+    return offset;
+}
+
+void Fluid::assignFields(char* base) {
+    auto slot = [&](int k) {
+        return base + Fluid::slotOffset(k, this->totCells, this->smokeStorage);
+    };
+    this->u = reinterpret_cast<float*>(slot(0));
+    this->v = reinterpret_cast<float*>(slot(1));
+    this->s = reinterpret_cast<unsigned char*>(slot(2));
+    this->p = reinterpret_cast<float*>(slot(3));
+    this->m = reinterpret_cast<unsigned char*>(slot(4));
+    this->temp_u = reinterpret_cast<float*>(slot(5));
+    this->temp_v = reinterpret_cast<float*>(slot(6));
+    this->temp_m = reinterpret_cast<unsigned char*>(slot(7));
+    this->s_mask = reinterpret_cast<float*>(slot(8));
+}
+
+void Fluid::setSmokeStorage(SmokeStorage storage) {
+    if (storage == this->smokeStorage) {
+        return;
+    }
+
+    // new arena laid out for the new smoke size; the other fields move over unchanged
+    FieldArena old_arena = std::move(this->arena);
+    float* old_u = this->u;
+    float* old_v = this->v;
+    unsigned char* old_s = this->s;
+    float* old_p = this->p;
+    unsigned char* old_m = this->m;
+    SmokeStorage old_storage = this->smokeStorage;
+
+    this->smokeStorage = storage;
+    this->arena = FieldArena(Fluid::slotOffset(Fluid::FIELD_COUNT, this->totCells, storage), old_arena.usesHugePages());
+    this->assignFields(this->arena.get());
+
+    std::copy(old_u, old_u + this->totCells, this->u);
+    std::copy(old_v, old_v + this->totCells, this->v);
+    std::copy(old_s, old_s + this->totCells, this->s);
+    std::copy(old_p, old_p + this->totCells, this->p);
+    for (int c = 0; c < this->totCells; c++) {
+        encodeSmoke(this->m, c, storage, decodeSmoke(old_m, c, old_storage));
+    }
+
+    delete[] this->smoke_view;
+    this->smoke_view = nullptr;
+}
+
+SmokeStorage Fluid::getSmokeStorage() const {
+    return this->smokeStorage;
 }
 
 void Fluid::propagateGravity(float dt, float g) {
     //grid is defined where origin is at bottom left corner :)
-    int stride = this->height;
     
     // can adjust later
     for(int i = 1; i < this->width; i++){
+        this->gravityColumn(i, dt, g);
+    }
+
+}
+
+void Fluid::gravityColumn(int i, float dt, float g){
+    int stride = this->stride;
 
-        // avoid update the boundary cell
-        for(int j = 1; j < this->height-1; j++){
+    // avoid update the boundary cell. quiescent tiles skip gravity along with the
+    // projection that would balance it
+    this->forEachActiveRun(this->tile_flow, this->tileColumn(i), [&](int j_begin, int j_end){
+        for(int j = j_begin; j < j_end; j++){
             // check cell above (i,j) and below (i,j-1) are free fluid.
             if (this->s[i * stride + j] != 0 && this->s[i * stride + j-1] != 0){
 
@@ -60,296 +388,2021 @@ void Fluid::propagateGravity(float dt, float g) {
 
             }
         }
-    }
-
+    });
 }
 
-void Fluid::applyIncompressibility(float dt, int tot_iter){
-    int stride = this->height;
+void Fluid::relaxCell(int i, int j, float dt){
+    int stride = this->stride;
 
-    //Gauss-Seidel method to solve incompressibility equations 
+    // check that the current cell is free fluid and not solid or boundary
+    float cur_s = this->s[i * stride + j];
     
-    for(int iter = 0;iter<tot_iter;iter++){
-        for(int i = 1;i < this->width-1;i++){
-            for(int j = 1;j < this->height-1;j++){
+    if(cur_s != 0){
+        // get the surrounding cells. Here, we use column major order for x index. Might change later...
+        float s_left = this->s[(i-1) * stride + j];
+        float s_right = this->s[(i+1) * stride + j];
+        float s_up = this->s[i * stride + (j+1)];
+        float s_down = this->s[i * stride + (j-1)];
 
-                // check that the current cell is free fluid and not solid or boundary
-                float cur_s = this->s[i * stride + j];
-                
-                if(cur_s != 0){
-                    // get the surrounding cells. Here, we use column major order for x index. Might change later...
-                    float s_left = this->s[(i-1) * stride + j];
-                    float s_right = this->s[(i+1) * stride + j];
-                    float s_up = this->s[i * stride + (j+1)];
-                    float s_down = this->s[i * stride + (j-1)];
+        float s_factor = s_left + s_right + s_up + s_down;
 
-                    float s_factor = s_left + s_right + s_up + s_down;
+        // s_facotr == 0  really should not happen in this code but just in case
+        if(s_factor != 0){
+            // get divergence of the velocity field at the current cell
 
-                    // s_facotr == 0  really should not happen in this code but just in case
-                    if(s_factor != 0){
-                        // get divergence of the velocity field at the current cell
+            // def outward flux as positive
+            float d = this->u[(i+1) * stride + j] - this->u[i * stride + j] + this->v[i * stride + (j+1)] - this->v[i * stride + j];
 
-                        // def outward flux as positive
-                        float d = this->u[(i+1) * stride + j] - this->u[i * stride + j] + this->v[i * stride + (j+1)] - this->v[i * stride + j];
+            float p = -d / s_factor;
 
-                        float p = -d / s_factor;
+            // solve based on poisson equation (but Gauss-Seidel method using iterated neighboring cells)
 
-                        // solve based on poisson equation (but Gauss-Seidel method using iterated neighboring cells)
+            this->u[i * stride + j] -= p * s_left * this->overrelax;
+            this->u[(i+1) * stride + j] += p * s_right * this->overrelax;
+            this->v[i * stride + j] -= p * s_down * this->overrelax;
+            this->v[i * stride + j+1] += p * s_up * this->overrelax;
 
-                        this->u[i * stride + j] -= p * s_left * this->overrelax;
-                        this->u[(i+1) * stride + j] += p * s_right * this->overrelax;
-                        this->v[i * stride + j] -= p * s_down * this->overrelax;
-                        this->v[i * stride + j+1] += p * s_up * this->overrelax;
+            this->p[i * stride + j] += p * this->overrelax*this->density*this->h/dt;
 
-                        this->p[i * stride + j] += p * this->overrelax*this->density*this->h/dt;
+        }
 
-                    }
+    }
+}
 
-                    
+void Fluid::applyIncompressibility(float dt, int tot_iter){
+    this->applyIncompressibility(dt, tot_iter, this->pressureSolver);
+}
 
+void Fluid::applyIncompressibility(float dt, int tot_iter, PressureSolver solver){
+    switch(solver){
+        case PressureSolver::GaussSeidel:
+            this->applyIncompressibilityGaussSeidel(dt, tot_iter);
+            break;
+        case PressureSolver::RedBlack:
+            this->applyIncompressibilityRedBlack(dt, tot_iter);
+            break;
+        case PressureSolver::ConjugateGradient:
+            this->applyIncompressibilityConjugateGradient(dt);
+            break;
+    }
+}
 
+void Fluid::applyIncompressibilityGaussSeidel(float dt, int tot_iter){
+    //Gauss-Seidel method to solve incompressibility equations 
+    this->stats.pressureIterations = tot_iter;
 
-                }
+    if(this->temporalBlocking > 1){
+        for(int done = 0; done < tot_iter; done += this->temporalBlocking){
+            this->relaxWavefront(dt, std::min(this->temporalBlocking, tot_iter - done), nullptr, nullptr);
+        }
+        return;
+    }
+    
+    for(int iter = 0;iter<tot_iter;iter++){
+        for(int i = 1;i < this->width-1;i++){
+            this->relaxColumn(i, dt);
+        }
+    }
 
-            }
+}
 
+void Fluid::relaxColumn(int i, float dt){
+    this->forEachActiveRun(this->tile_flow, this->tileColumn(i), [&](int j_begin, int j_end){
+        for(int j = j_begin;j < j_end;j++){
+            this->relaxCell(i, j, dt);
         }
+    });
+}
 
+void Fluid::relaxWavefront(float dt, int iterations, const std::function<void(int)>& first,
+                           const std::function<void(int)>& last){
+    // relaxing column i writes the u faces i and i + 1 and its own v and p, so it only
+    // shares data with columns i - 1 and i + 1. Iteration k of column i runs at time
+    // i + 2k: after iteration k of column i - 1 and iteration k - 1 of column i + 1, and
+    // before iteration k + 1 of column i - 1, the same order the plain sweeps give every
+    // pair of neighbours. The columns of one time step are two or more apart, so the result
+    // is exactly that of the plain sweeps while only about 2 * iterations columns are live
+    int columns = this->width - 2;
+    for(int t = 0; t < columns + 2 * (iterations - 1); t++){
+        for(int k = 0; k < iterations; k++){
+            int i = 1 + t - 2 * k;
+            if(i < 1){
+                break;
+            }
+            if(i > columns){
+                continue;
+            }
+            if(k == 0 && first){
+                first(i);
+            }
+            this->relaxColumn(i, dt);
+            if(k == iterations - 1 && last){
+                last(i);
+            }
+        }
     }
-
-
 }
 
-void Fluid::extrapolate() {
-    int stride = this->height;
-    
-    // Extrapolate u field
-    for (int i = 0; i < this->width; i++) {
+void Fluid::stepFused(float dt, int tot_iter, float g){
+    int stride = this->stride;
+    int height = this->height;
+    this->stats.pressureIterations = tot_iter;
+
+    // relaxation never reads the u rows extrapolate writes, nor writes the v columns it
+    // copies from after their column's last pass; gravity and the reset of a column only
+    // have to land before its first relaxation
+    auto prepare = [&](int i){
+        this->gravityColumn(i, dt, g);
+        std::fill(this->p + i * stride, this->p + i * stride + height, 0.0f);
+    };
+    auto extrapolateU = [&](int i){
         this->u[i * stride + 0] = this->u[i * stride + 1];
-        this->u[i * stride + this->height - 1] = this->u[i * stride + this->height - 2];
+        this->u[i * stride + height - 1] = this->u[i * stride + height - 2];
+    };
+
+    // the columns outside the sweep
+    this->gravityColumn(this->width - 1, dt, g);
+    std::fill(this->p, this->p + height, 0.0f);
+    std::fill(this->p + (this->width - 1) * stride, this->p + (this->width - 1) * stride + height, 0.0f);
+    if(tot_iter <= 0){
+        for(int i = 1; i < this->width - 1; i++){
+            prepare(i);
+        }
     }
-    
-    // Extrapolate v field
-    for (int j = 0; j < this->height; j++) {
+
+    for(int done = 0; done < tot_iter; done += this->temporalBlocking){
+        int iterations = std::min(this->temporalBlocking, tot_iter - done);
+        std::function<void(int)> first;
+        std::function<void(int)> last;
+        if(done == 0){
+            first = prepare;
+        }
+        if(done + iterations == tot_iter){
+            last = extrapolateU;
+        }
+        this->relaxWavefront(dt, iterations, first, last);
+    }
+
+    if(tot_iter <= 0){
+        for(int i = 1; i < this->width - 1; i++){
+            extrapolateU(i);
+        }
+    }
+    extrapolateU(0);
+    extrapolateU(this->width - 1);
+    for(int j = 0; j < height; j++){
         this->v[0 * stride + j] = this->v[1 * stride + j];
         this->v[(this->width - 1) * stride + j] = this->v[(this->width - 2) * stride + j];
     }
 }
 
-float Fluid::interpolateComponent(float x, float y, std::string vec_type){
-    int stride = this->height;
-
-    float half_cell = this->h/2;
-
-    // bounding with ghost cells
-    x = std::max(std::min(x, this->width * this->h), this->h);
-    y = std::max(std::min(y, this->height * this->h), this->h);
-
-    float dx = 0;
-    float dy = 0;
-
-    //temp array to avoid allocation repetition
-    float* f = this->temp_f;
+void Fluid::applyIncompressibilityRedBlack(float dt, int tot_iter){
+    // same SOR update as the Gauss-Seidel sweep but in checkerboard order. A cell only writes
+    // its own four faces and its own pressure, and cells of one colour never share a face,
+    // so every colour pass can be split across threads by columns.
+    this->stats.pressureIterations = tot_iter;
+    this->prepareRedBlack();
 
-    if(vec_type == "u"){
-        std::copy(this->u, this->u + this->totCells, f);
-        dy=half_cell;
-    }
-    else if(vec_type == "v"){
-        std::copy(this->v, this->v + this->totCells, f);
-        dx=half_cell;
-    }
-    else if(vec_type == "s"){
-        std::copy(this->m, this->m + this->totCells, f);
-        dx=half_cell;
-        dy=half_cell;
-    }
-    else{
-        return 0.0f;
+    for(int iter = 0;iter<tot_iter;iter++){
+        for(int color = 0;color < 2;color++){
+            this->relaxRedBlack(dt, color, 1, this->width-1);
+        }
     }
+}
 
-    // create bounding box for interpolation
-    int x0 = std::min(static_cast<int>(std::floor((x - dx)/this->h)), this->width-1);
-    int x1 = std::min(x0 + 1, this->width-1);
-
-    int y0 = std::min(static_cast<int>(std::floor((y - dy)/this->h)), this->height-1); 
-    int y1 = std::min(y0 + 1, this->height-1);
-
-    float w_right = ((x - dx) - x0*this->h)/this->h;
-    float w_up = ((y - dy) - y0*this->h)/this->h;
-
-    float w_left = 1-w_right;
-    float w_down = 1-w_up;
+void Fluid::prepareRedBlack(){
+    const SimdKernels* kernels = this->getKernels();
+    if(kernels != nullptr && kernels->relaxColumns != nullptr){
+        // s does not change during the solve, convert it once instead of on every read
+        for(int c = 0; c < this->totCells; c++){
+            this->s_mask[c] = static_cast<float>(this->s[c]);
+        }
+    }
+}
 
-    float interpolated_value = w_left * w_down * f[x0 * stride + y0] + w_right * w_down * f[x1 * stride + y0] + w_right * w_up * f[x1 * stride + y1] + w_left * w_up * f[x0 * stride + y1];
+void Fluid::relaxRedBlack(float dt, int color, int i_begin, int i_end){
+    ThreadPool* pool = this->getThreadPool();
+
+    const SimdKernels* kernels = this->getKernels();
+    if(kernels != nullptr && kernels->relaxColumns != nullptr){
+        pool->parallelFor(i_begin, i_end, [&](int chunk_begin, int chunk_end){
+            for(int i = chunk_begin;i < chunk_end;i++){
+                this->forEachActiveRun(this->tile_flow, this->tileColumn(i), [&](int j_begin, int j_end){
+                    kernels->relaxColumns(this->u, this->v, this->p, this->s_mask, i, i + 1, j_begin, j_end,
+                                          color, this->stride, this->overrelax, this->density, this->h, dt);
+                });
+            }
+        });
+        return;
+    }
 
-    return interpolated_value;
+    pool->parallelFor(i_begin, i_end, [&](int chunk_begin, int chunk_end){
+        for(int i = chunk_begin;i < chunk_end;i++){
+            this->forEachActiveRun(this->tile_flow, this->tileColumn(i), [&](int j_begin, int j_end){
+                // first j in this run with (i + j) % 2 == color
+                int j_start = j_begin + ((i + j_begin + color) & 1);
+                for(int j = j_start;j < j_end;j += 2){
+                    this->relaxCell(i, j, dt);
+                }
+            });
+        }
+    });
 }
 
+void Fluid::applyIncompressibilityConjugateGradient(float dt){
+    int stride = this->stride;
 
+    if(this->pcg == nullptr){
+        this->pcg = new PcgSolver(this->width, this->height, this->stride);
+    }
 
-void Fluid::advect(float dt){
-    // use semi-lagrangian advection
-    
-    float* u_new = this->temp_u;
-    float* v_new = this->temp_v;
-    
-    std::copy(this->u, this->u + this->totCells, u_new);
-    std::copy(this->v, this->v + this->totCells, v_new);
+    // solve in velocity units; p still holds last frame's pressure and is the initial guess
+    float to_velocity = dt / (this->density * this->h);
+    float* x = this->p;
+    for(int c = 0; c < this->totCells; c++){
+        x[c] *= to_velocity;
+    }
 
-    int stride = this->height;
-    float half_cell = this->h/2;
+    float residual = 0.0f;
+    this->stats.pressureIterations = this->pcg->solve(this->u, this->v, this->s, x, this->pcgTolerance, this->pcgMaxIter, residual);
+    this->stats.pressureResidual = residual;
 
-    for(int i = 1; i < this->width - 1; i++){
+    // subtract the pressure gradient on every face between two open cells; x is 0 outside the unknowns
+    for(int i = 1; i < this->width; i++){
         for(int j = 1; j < this->height - 1; j++){
+            if(this->s[i * stride + j] != 0 && this->s[(i-1) * stride + j] != 0){
+                this->u[i * stride + j] -= x[i * stride + j] - x[(i-1) * stride + j];
+            }
+        }
+    }
+    for(int i = 1; i < this->width - 1; i++){
+        for(int j = 1; j < this->height; j++){
+            if(this->s[i * stride + j] != 0 && this->s[i * stride + j-1] != 0){
+                this->v[i * stride + j] -= x[i * stride + j] - x[i * stride + j-1];
+            }
+        }
+    }
 
-            // u 
+    float to_pressure = this->density * this->h / dt;
+    for(int c = 0; c < this->totCells; c++){
+        x[c] *= to_pressure;
+    }
+}
 
-            //if above and below are boundary, don't advect
-            if(this->s[i * stride + j] != 0 && this->s[(i-1) * stride + j] != 0){
+ThreadPool* Fluid::getThreadPool(){
+    if(this->pool == nullptr){
+        this->pool = new ThreadPool(this->numThreads);
+    }
+    return this->pool;
+}
 
-                // universal loc of the u vector given (i,j)
-                float x = i * this->h;
-                float y = j * this->h + half_cell;
+void Fluid::setPressureSolver(PressureSolver solver){
+    this->pressureSolver = solver;
+}
 
-                float cur_u = this->u[i * stride + j];
+PressureSolver Fluid::getPressureSolver() const {
+    return this->pressureSolver;
+}
 
-                // get interpolated velocity surrounding the u vector
-                float cur_v = (this->v[i * stride + j] + this->v[(i-1) * stride + j]+this->v[i * stride + (j+1)] + this->v[(i-1) * stride + (j+1)]) / 4;
+void Fluid::setNumThreads(int numThreads){
+    if(numThreads != this->numThreads){
+        this->numThreads = numThreads;
+        // rebuilt lazily on the next parallel solve
+        delete this->pool;
+        this->pool = nullptr;
+    }
+}
 
-                // linear parametric backtracking to find old pos
-                x -= dt * cur_u;
-                y -= dt * cur_v;
+int Fluid::getNumThreads(){
+    return this->getThreadPool()->size();
+}
 
-                cur_u = this->interpolateComponent(x,y,"u");
+void Fluid::setTemporalBlocking(int depth){
+    this->temporalBlocking = std::max(depth, 0);
+}
 
-                u_new[i * stride + j] = cur_u;
+int Fluid::getTemporalBlocking() const {
+    return this->temporalBlocking;
+}
 
-                
-            }
-            // v 
-            //if left and right are boundary, don't advect
-            if(this->s[i * stride + j] != 0 && this->s[i * stride + (j-1)] != 0){
+void Fluid::setSolverTolerance(float tolerance, int maxIter){
+    this->pcgTolerance = tolerance;
+    this->pcgMaxIter = maxIter;
+}
 
-                // universal loc of the v vector given (i,j)
-                float x = i * this->h + half_cell;
-                float y = j * this->h;
+const FluidStats& Fluid::getStats() const {
+    return this->stats;
+}
 
-                float cur_v = this->v[i * stride + j];
+bool Fluid::setSimdLevel(SimdLevel level){
+    if(level > detectSimdLevel()){
+        return false;
+    }
+    this->simdLevel = level;
+    return true;
+}
 
-                // get interpolated velocity surrounding the v vector
-                float cur_u = (this->u[i*stride + j-1] + this->u[i*stride+j] + this->u[(i+1)*stride+j-1] + this->u[(i+1)*stride+j])/4;
+SimdLevel Fluid::getSimdLevel() const {
+    return this->simdLevel;
+}
 
-                // linear parametric backtracking to find old pos
-                x -= dt * cur_u;
-                y -= dt * cur_v;
+void Fluid::setTileTracking(int tileSize, float threshold){
+    delete[] this->tile_flow;
+    delete[] this->tile_smoke;
+    delete[] this->tile_scratch;
+    this->tile_flow = nullptr;
+    this->tile_smoke = nullptr;
+    this->tile_scratch = nullptr;
+
+    this->tileSize = tileSize <= 0 ? 0 : std::max(tileSize, 8);
+    this->tileThreshold = threshold;
+    this->stats.activeTileFraction = 1.0f;
+    this->stats.smokeTileFraction = 1.0f;
+
+    if(this->tileSize == 0){
+        this->tilesX = 0;
+        this->tilesY = 0;
+        return;
+    }
 
-                cur_v = this->interpolateComponent(x,y,"v");
+    this->tilesX = (this->width - 2 + this->tileSize - 1) / this->tileSize;
+    this->tilesY = (this->height - 2 + this->tileSize - 1) / this->tileSize;
+    int tiles = this->tilesX * this->tilesY;
+    this->tile_flow = new unsigned char[tiles];
+    this->tile_smoke = new unsigned char[tiles];
+    this->tile_scratch = new unsigned char[tiles];
 
-                v_new[i * stride + j] = cur_v;
+    // everything runs until the first updateActiveTiles()
+    std::fill(this->tile_flow, this->tile_flow + tiles, 1);
+    std::fill(this->tile_smoke, this->tile_smoke + tiles, 1);
+}
 
-                
-            }
+int Fluid::getTileSize() const {
+    return this->tileSize;
+}
 
+template <typename Magnitude>
+void Fluid::markTiles(unsigned char* flags, Magnitude magnitude) const {
+    int stride = this->stride;
 
+    for(int tx = 0; tx < this->tilesX; tx++){
+        int i_begin, i_end;
+        this->tileColumnRange(tx, i_begin, i_end);
 
-                
+        for(int ty = 0; ty < this->tilesY; ty++){
+            int j_begin = 1 + ty * this->tileSize;
+            int j_end = std::min(j_begin + this->tileSize, this->height - 1);
 
+            float largest = 0.0f;
+            for(int i = i_begin; i < i_end; i++){
+                for(int j = j_begin; j < j_end; j++){
+                    largest = std::max(largest, magnitude(i * stride + j));
+                }
+            }
+            flags[tx * this->tilesY + ty] = largest > this->tileThreshold ? 1 : 0;
         }
     }
+}
+
+void Fluid::updateActiveTiles(){
+    if(this->tileSize == 0){
+        return;
+    }
 
-    std::copy(u_new, u_new + this->totCells, this->u);
-    std::copy(v_new, v_new + this->totCells, this->v);
+    // a tile next to a moving one picks up pressure and inflow this step, so it runs too
+    const float* u = this->u;
+    const float* v = this->v;
+    this->markTiles(this->tile_flow, [u, v](int c){
+        return std::max(std::fabs(u[c]), std::fabs(v[c]));
+    });
+    this->stats.activeTileFraction = this->dilateTiles(this->tile_flow, 1);
 }
 
-void Fluid::advectSmoke(float dt) {
-    float* m_new = this->temp_m;
-    
-    std::copy(this->m, this->m + this->totCells, m_new);
-    
-    int stride = this->height;
-    float h2 = 0.5f * this->h;
-    
-    for (int i = 1; i < this->width - 1; i++) {
-        for (int j = 1; j < this->height - 1; j++) {
-            if (this->s[i * stride + j] != 0) {
-                // Get velocity at cell center by averaging neighboring velocity components
-                //u stored at left of cell, v stored at bottom of cell
-                float u = (this->u[i * stride + j] + this->u[(i+1) * stride + j]) * 0.5f;
-                float v = (this->v[i * stride + j] + this->v[i * stride + j+1]) * 0.5f;
-                
-                // Calculate position to sample from (backtracking)
-                float x = i * this->h + h2 - dt * u;
-                float y = j * this->h + h2 - dt * v;
-                
-                // Sample smoke field at the backtracked position using interpolateComponent
-                m_new[i * stride + j] = this->interpolateComponent(x, y, "s");
+float Fluid::dilateTiles(unsigned char* flags, int radius){
+    int tiles = this->tilesX * this->tilesY;
+    std::copy(flags, flags + tiles, this->tile_scratch);
+
+    int active = 0;
+    for(int tx = 0; tx < this->tilesX; tx++){
+        for(int ty = 0; ty < this->tilesY; ty++){
+            unsigned char flag = 0;
+            int nx_end = std::min(tx + radius, this->tilesX - 1);
+            int ny_end = std::min(ty + radius, this->tilesY - 1);
+            for(int nx = std::max(tx - radius, 0); nx <= nx_end && !flag; nx++){
+                for(int ny = std::max(ty - radius, 0); ny <= ny_end; ny++){
+                    if(this->tile_scratch[nx * this->tilesY + ny]){
+                        flag = 1;
+                        break;
+                    }
+                }
             }
+            flags[tx * this->tilesY + ty] = flag;
+            active += flag;
         }
     }
-    
-    std::copy(m_new, m_new + this->totCells, this->m);
-}
-
-void Fluid::simulate(float dt,int tot_iter,float g){
-
-    this->propagateGravity(dt,g);
-    this->resetPressure();
-    this->applyIncompressibility(dt,tot_iter);
-    this->extrapolate();
-    this->advect(dt);
-    this->advectSmoke(dt);
 
+    return static_cast<float>(active) / tiles;
 }
 
-float* Fluid::getPressureField(){
-    return this->p;
+int Fluid::tileColumns() const {
+    return this->tileSize == 0 ? 1 : this->tilesX;
 }
 
-void Fluid::setFluid(int i, int j, int value){
-    this->s[i * this->height + j] = value;
-    
-    // If setting as solid boundary, also set velocity to zero
-    if (value == 0) {
-        int stride = this->height;
-        // Set u velocity to zero (stored at left edge of cell)
-        this->u[i * stride + j] = 0.0f;
-        // Set v velocity to zero (stored at bottom edge of cell)
-        this->v[i * stride + j] = 0.0f;
-        // Also set smoke to zero at solid boundaries
-        this->m[i * stride + j] = 0.0f;
+void Fluid::tileColumnRange(int tx, int& i_begin, int& i_end) const {
+    if(this->tileSize == 0){
+        i_begin = 1;
+        i_end = this->width - 1;
+        return;
     }
+    i_begin = 1 + tx * this->tileSize;
+    i_end = std::min(i_begin + this->tileSize, this->width - 1);
 }
 
-void Fluid::activateFluid(){
-    for(int i = 0; i < this->width; i++){
-        for(int j = 0; j < this->height; j++){
-            this->s[i * this->height + j] = 1;
-        }
+int Fluid::tileColumn(int i) const {
+    if(this->tileSize == 0){
+        return 0;
     }
-
+    return std::min(std::max((i - 1) / this->tileSize, 0), this->tilesX - 1);
 }
 
-void Fluid::resetPressure(){
-    for(int i = 0; i < this->width; i++){
-        for(int j = 0; j < this->height; j++){
-            this->p[i * this->height + j] = 0;
+void Fluid::forEachActiveRun(const unsigned char* flags, int tx, const std::function<void(int, int)>& fn) const {
+    if(this->tileSize == 0 || flags == nullptr){
+        fn(1, this->height - 1);
+        return;
+    }
+
+    // neighbouring active tiles are merged so the vector kernels get long columns
+    const unsigned char* column = flags + tx * this->tilesY;
+    int ty = 0;
+    while(ty < this->tilesY){
+        if(!column[ty]){
+            ty++;
+            continue;
         }
+        int ty_end = ty + 1;
+        while(ty_end < this->tilesY && column[ty_end]){
+            ty_end++;
+        }
+        fn(1 + ty * this->tileSize, std::min(1 + ty_end * this->tileSize, this->height - 1));
+        ty = ty_end;
     }
 }
 
-float* Fluid::getSmokeField(){
-    return this->m;
+float Fluid::maxVelocity() const {
+    // one pass over both fields. With the sign bit cleared, floats order like their bits, so
+    // the max runs on integers, which vectorizes without fast-math
+    std::int32_t largest = 0;
+    for(int c = 0; c < this->totCells; c++){
+        std::int32_t bits_u, bits_v;
+        std::memcpy(&bits_u, this->u + c, sizeof(bits_u));
+        std::memcpy(&bits_v, this->v + c, sizeof(bits_v));
+        largest = std::max(largest, std::max(bits_u & 0x7fffffff, bits_v & 0x7fffffff));
+    }
+    float result;
+    std::memcpy(&result, &largest, sizeof(result));
+    return result;
 }
 
-void Fluid::setSmoke(int i, int j, float value){
-    this->m[i * this->height + j] = value;
+const SimdKernels* Fluid::getKernels() const {
+    // the kernels work on whole 8-cell blocks of a column
+    if(this->height - 2 < 8){
+        return nullptr;
+    }
+    return getSimdKernels(this->simdLevel);
 }
 
-void Fluid::setU(int i, int j, float value){
-    this->u[i * this->height + j] = value;
+void Fluid::extrapolate() {
+    int stride = this->stride;
+    
+    // Extrapolate u field
+    for (int i = 0; i < this->width; i++) {
+        this->u[i * stride + 0] = this->u[i * stride + 1];
+        this->u[i * stride + this->height - 1] = this->u[i * stride + this->height - 2];
+    }
+    
+    // Extrapolate v field
+    for (int j = 0; j < this->height; j++) {
+        this->v[0 * stride + j] = this->v[1 * stride + j];
+        this->v[(this->width - 1) * stride + j] = this->v[(this->width - 2) * stride + j];
+    }
 }
 
-void Fluid::setV(int i, int j, float value){
-    this->v[i * this->height + j] = value;
-}
\ No newline at end of file
+template <typename Fetch>
+float Fluid::sampleWith(Fetch fetch, float x, float y, float dx, float dy, float* lo, float* hi) const {
+    int stride = this->stride;
+    int off = this->columnOffset;
+
+    // bounding with ghost cells
+    x = std::max(std::min(x, (off + this->width) * this->h), (off + 1) * this->h);
+    y = std::max(std::min(y, this->height * this->h), this->h);
+
+    // create bounding box for interpolation
+    int x0 = std::min(static_cast<int>(std::floor((x - dx)/this->h)), off + this->width-1);
+    int x1 = std::min(x0 + 1, off + this->width-1);
+
+    int y0 = std::min(static_cast<int>(std::floor((y - dy)/this->h)), this->height-1); 
+    int y1 = std::min(y0 + 1, this->height-1);
+
+    float w_right = ((x - dx) - x0*this->h)/this->h;
+    float w_up = ((y - dy) - y0*this->h)/this->h;
+
+    float w_left = 1-w_right;
+    float w_down = 1-w_up;
+
+    // back to the columns of this grid
+    x0 -= off;
+    x1 -= off;
+
+    float f00 = fetch(x0 * stride + y0);
+    float f10 = fetch(x1 * stride + y0);
+    float f11 = fetch(x1 * stride + y1);
+    float f01 = fetch(x0 * stride + y1);
+    float interpolated_value = w_left * w_down * f00 + w_right * w_down * f10 + w_right * w_up * f11 + w_left * w_up * f01;
+
+    if(lo != nullptr){
+        *lo = std::min(std::min(f00, f10), std::min(f11, f01));
+        *hi = std::max(std::max(f00, f10), std::max(f11, f01));
+    }
+
+    return interpolated_value;
+}
+
+float Fluid::sampleField(const float* f, float x, float y, float dx, float dy) const {
+    return this->sampleWith([f](int c){ return f[c]; }, x, y, dx, dy);
+}
+
+float Fluid::interpolateComponent(float x, float y, FieldType field) const {
+    float half_cell = this->h/2;
+
+    // sample the live arrays directly; advection writes into the temp arrays so nothing
+    // here changes while a step is in flight
+    switch(field){
+        case FieldType::U:
+            return this->sampleField(this->u, x, y, 0.0f, half_cell);
+        case FieldType::V:
+            return this->sampleField(this->v, x, y, half_cell, 0.0f);
+        case FieldType::Smoke:
+            if(this->smokeStorage == SmokeStorage::Float32){
+                return this->sampleField(reinterpret_cast<const float*>(this->m), x, y, half_cell, half_cell);
+            }
+            return this->sampleWith([this](int c){ return decodeSmoke(this->m, c, this->smokeStorage); },
+                                    x, y, half_cell, half_cell);
+    }
+
+    return 0.0f;
+}
+
+
+
+void Fluid::setColumnOffset(int offset) {
+    this->columnOffset = offset;
+}
+
+void Fluid::setAdvectionScheme(AdvectionScheme scheme) {
+    this->advectionScheme = scheme;
+}
+
+AdvectionScheme Fluid::getAdvectionScheme() const {
+    return this->advectionScheme;
+}
+
+void Fluid::setFlip(int particlesPerCell, float flipRatio, int sortInterval) {
+    delete this->flip;
+    this->flip = nullptr;
+    if (particlesPerCell <= 0) {
+        return;
+    }
+    this->flip = new FlipSolver(this->width, this->height, this->stride, this->h, particlesPerCell, flipRatio, sortInterval);
+    this->flip->seed(this->s, this->u, this->v);
+}
+
+int Fluid::getParticlesPerCell() const {
+    return this->flip != nullptr ? this->flip->getParticlesPerCell() : 0;
+}
+
+float Fluid::getFlipRatio() const {
+    return this->flip != nullptr ? this->flip->getFlipRatio() : 0.0f;
+}
+
+int Fluid::getParticleCount() const {
+    return this->flip != nullptr ? this->flip->getParticles().size() : 0;
+}
+
+const FlipParticles* Fluid::getParticles() const {
+    return this->flip != nullptr ? &this->flip->getParticles() : nullptr;
+}
+
+float* Fluid::advectScratch(int k) {
+    // two passes, plus the decoded smoke and its result for compact storage
+    size_t slot = FieldArena::slotSize(static_cast<size_t>(this->totCells) * sizeof(float));
+    if (this->advect_arena.size() != 4 * slot) {
+        this->advect_arena = FieldArena(4 * slot, false);
+    }
+    return reinterpret_cast<float*>(this->advect_arena.get() + k * slot);
+}
+
+bool Fluid::advectsSample(FieldType field, int c) const {
+    switch (field) {
+        case FieldType::U:
+            return this->s[c] != 0 && this->s[c - this->stride] != 0;
+        case FieldType::V:
+            return this->s[c] != 0 && this->s[c - 1] != 0;
+        case FieldType::Smoke:
+            return this->s[c] != 0;
+    }
+    return false;
+}
+
+void Fluid::backtrace(FieldType field, int i, int j, float dt, float& x, float& y) const {
+    // the velocity at the sample, as the semi-Lagrangian loops average it
+    int stride = this->stride;
+    int c = i * stride + j;
+    float half_cell = this->h/2;
+    float cur_u, cur_v;
+    switch (field) {
+        case FieldType::U:
+            x = (i + this->columnOffset) * this->h;
+            y = j * this->h + half_cell;
+            cur_u = this->u[c];
+            cur_v = (this->v[c] + this->v[c - stride] + this->v[c + 1] + this->v[c - stride + 1]) / 4;
+            break;
+        case FieldType::V:
+            x = (i + this->columnOffset) * this->h + half_cell;
+            y = j * this->h;
+            cur_u = (this->u[c - 1] + this->u[c] + this->u[c + stride - 1] + this->u[c + stride]) / 4;
+            cur_v = this->v[c];
+            break;
+        default:
+            x = (i + this->columnOffset) * this->h + half_cell;
+            y = j * this->h + half_cell;
+            cur_u = (this->u[c] + this->u[c + stride]) * 0.5f;
+            cur_v = (this->v[c] + this->v[c + 1]) * 0.5f;
+            break;
+    }
+    x -= dt * cur_u;
+    y -= dt * cur_v;
+}
+
+void Fluid::advectCorrected(FieldType field, const float* f, float* out, float dt, const unsigned char* flags) {
+    int stride = this->stride;
+    float half_cell = this->h/2;
+    float dx = field == FieldType::U ? 0.0f : half_cell;
+    float dy = field == FieldType::V ? 0.0f : half_cell;
+    float* forward = this->advectScratch(0);
+    float* back = this->advectScratch(1);
+
+    // one semi-Lagrangian pass of src over step_dt into dst
+    auto pass = [&](const float* src, float* dst, float step_dt) {
+        this->copyUnvisited(src, dst, sizeof(float), flags);
+        for (int i = 1; i < this->width - 1; i++) {
+            this->forEachActiveRun(flags, this->tileColumn(i), [&](int j_begin, int j_end) {
+                for (int j = j_begin; j < j_end; j++) {
+                    int c = i * stride + j;
+                    if (!this->advectsSample(field, c)) {
+                        dst[c] = src[c];
+                        continue;
+                    }
+                    float x, y;
+                    this->backtrace(field, i, j, step_dt, x, y);
+                    dst[c] = this->sampleField(src, x, y, dx, dy);
+                }
+            });
+        }
+    };
+
+    // forward is the plain result; tracing it back again would give f if advection lost
+    // nothing, so f - back is twice the error of a pass
+    pass(f, forward, dt);
+    pass(forward, back, -dt);
+
+    if (this->advectionScheme == AdvectionScheme::Bfecc) {
+        // back becomes f with the error taken out ahead of the final pass
+        for (int i = 0; i < this->width; i++) {
+            for (int j = 0; j < this->height; j++) {
+                int c = i * stride + j;
+                back[c] = f[c] + 0.5f * (f[c] - back[c]);
+            }
+        }
+    }
+
+    this->copyUnvisited(f, out, sizeof(float), flags);
+    for (int i = 1; i < this->width - 1; i++) {
+        this->forEachActiveRun(flags, this->tileColumn(i), [&](int j_begin, int j_end) {
+            for (int j = j_begin; j < j_end; j++) {
+                int c = i * stride + j;
+                if (!this->advectsSample(field, c)) {
+                    out[c] = f[c];
+                    continue;
+                }
+                float x, y;
+                this->backtrace(field, i, j, dt, x, y);
+                float lo, hi;
+                this->sampleWith([f](int k){ return f[k]; }, x, y, dx, dy, &lo, &hi);
+                float value;
+                if (this->advectionScheme == AdvectionScheme::MacCormack) {
+                    value = forward[c] + 0.5f * (f[c] - back[c]);
+                } else {
+                    value = this->sampleField(back, x, y, dx, dy);
+                }
+                // the limiter: the correction may not leave the range of the values the
+                // backtrace landed between, so it adds no new extrema
+                out[c] = std::max(lo, std::min(value, hi));
+            }
+        });
+    }
+}
+
+void Fluid::advect(float dt){
+    // use semi-lagrangian advection
+    
+    float* u_new = this->temp_u;
+    float* v_new = this->temp_v;
+
+    if(this->advectionScheme != AdvectionScheme::SemiLagrangian){
+        // u and v only change with the swap, both components trace through the old ones
+        this->advectCorrected(FieldType::U, this->u, u_new, dt, this->tile_flow);
+        this->advectCorrected(FieldType::V, this->v, v_new, dt, this->tile_flow);
+        std::swap(this->u, this->temp_u);
+        std::swap(this->v, this->temp_v);
+        return;
+    }
+    
+    this->copyUnvisited(this->u, u_new, sizeof(float), this->tile_flow);
+    this->copyUnvisited(this->v, v_new, sizeof(float), this->tile_flow);
+
+    const SimdKernels* kernels = this->getKernels();
+    if(kernels != nullptr){
+        for(int tx = 0; tx < this->tileColumns(); tx++){
+            int i_begin, i_end;
+            this->tileColumnRange(tx, i_begin, i_end);
+            this->forEachActiveRun(this->tile_flow, tx, [&](int j_begin, int j_end){
+                kernels->advectVelocity(this->u, this->v, this->s, u_new, v_new, i_begin, i_end, j_begin, j_end,
+                                        this->columnOffset, this->width, this->height, this->stride, this->h, dt);
+            });
+        }
+        std::swap(this->u, this->temp_u);
+        std::swap(this->v, this->temp_v);
+        return;
+    }
+
+    int stride = this->stride;
+    float half_cell = this->h/2;
+
+    for(int i = 1; i < this->width - 1; i++){
+        this->forEachActiveRun(this->tile_flow, this->tileColumn(i), [&](int j_begin, int j_end){
+            for(int j = j_begin; j < j_end; j++){
+
+                // u 
+
+                //if above and below are boundary, don't advect
+                if(this->s[i * stride + j] != 0 && this->s[(i-1) * stride + j] != 0){
+
+                    // universal loc of the u vector given (i,j)
+                    float x = (i + this->columnOffset) * this->h;
+                    float y = j * this->h + half_cell;
+
+                    float cur_u = this->u[i * stride + j];
+
+                    // get interpolated velocity surrounding the u vector
+                    float cur_v = (this->v[i * stride + j] + this->v[(i-1) * stride + j]+this->v[i * stride + (j+1)] + this->v[(i-1) * stride + (j+1)]) / 4;
+
+                    // linear parametric backtracking to find old pos
+                    x -= dt * cur_u;
+                    y -= dt * cur_v;
+
+                    cur_u = this->interpolateComponent(x,y,FieldType::U);
+
+                    u_new[i * stride + j] = cur_u;
+
+                
+                } else {
+                    u_new[i * stride + j] = this->u[i * stride + j];
+                }
+                // v 
+                //if left and right are boundary, don't advect
+                if(this->s[i * stride + j] != 0 && this->s[i * stride + (j-1)] != 0){
+
+                    // universal loc of the v vector given (i,j)
+                    float x = (i + this->columnOffset) * this->h + half_cell;
+                    float y = j * this->h;
+
+                    float cur_v = this->v[i * stride + j];
+
+                    // get interpolated velocity surrounding the v vector
+                    float cur_u = (this->u[i*stride + j-1] + this->u[i*stride+j] + this->u[(i+1)*stride+j-1] + this->u[(i+1)*stride+j])/4;
+
+                    // linear parametric backtracking to find old pos
+                    x -= dt * cur_u;
+                    y -= dt * cur_v;
+
+                    cur_v = this->interpolateComponent(x,y,FieldType::V);
+
+                    v_new[i * stride + j] = cur_v;
+
+                
+                } else {
+                    v_new[i * stride + j] = this->v[i * stride + j];
+                }
+
+
+
+                
+
+            }
+        });
+    }
+
+    // the back buffers now hold the new velocities
+    std::swap(this->u, this->temp_u);
+    std::swap(this->v, this->temp_v);
+}
+
+void Fluid::advectSmoke(float dt) {
+    unsigned char* m_new = this->temp_m;
+    SmokeStorage storage = this->smokeStorage;
+    int smoke_bytes = smokeStorageBytes(storage);
+
+    const unsigned char* flags = nullptr;
+    if (this->tileSize > 0) {
+        // smoke moves at most max|velocity| * dt in a step, every tile it can reach is visited
+        const unsigned char* m = this->m;
+        if (storage == SmokeStorage::Float32) {
+            const float* f = reinterpret_cast<const float*>(m);
+            this->markTiles(this->tile_smoke, [f](int c) { return std::fabs(f[c]); });
+        } else {
+            this->markTiles(this->tile_smoke, [m, storage](int c) { return std::fabs(decodeSmoke(m, c, storage)); });
+        }
+        int radius = 1 + static_cast<int>(this->maxVelocity() * dt / (this->tileSize * this->h));
+        this->stats.smokeTileFraction = this->dilateTiles(this->tile_smoke, radius);
+        flags = this->tile_smoke;
+    }
+
+    if (this->smokeFactor > 1) {
+        this->advectFineSmoke(dt, flags);
+        this->downsampleFineSmoke();
+        return;
+    }
+
+    if (this->advectionScheme != AdvectionScheme::SemiLagrangian) {
+        if (storage == SmokeStorage::Float32) {
+            this->advectCorrected(FieldType::Smoke, reinterpret_cast<const float*>(this->m),
+                                  reinterpret_cast<float*>(m_new), dt, flags);
+        } else {
+            // the passes work in floats, compact smoke is decoded once and encoded once
+            float* f = this->advectScratch(2);
+            float* out = this->advectScratch(3);
+            int stride = this->stride;
+            for (int i = 0; i < this->width; i++) {
+                for (int j = 0; j < this->height; j++) {
+                    f[i * stride + j] = decodeSmoke(this->m, i * stride + j, storage);
+                }
+            }
+            this->advectCorrected(FieldType::Smoke, f, out, dt, flags);
+            this->copyUnvisited(this->m, m_new, smoke_bytes, flags);
+            for (int i = 1; i < this->width - 1; i++) {
+                this->forEachActiveRun(flags, this->tileColumn(i), [&](int j_begin, int j_end) {
+                    for (int j = j_begin; j < j_end; j++) {
+                        encodeSmoke(m_new, i * stride + j, storage, out[i * stride + j]);
+                    }
+                });
+            }
+        }
+        std::swap(this->m, this->temp_m);
+        return;
+    }
+
+    this->copyUnvisited(this->m, m_new, smoke_bytes, flags);
+
+    const SimdKernels* kernels = this->getKernels();
+    if (kernels != nullptr) {
+        for (int tx = 0; tx < this->tileColumns(); tx++) {
+            int i_begin, i_end;
+            this->tileColumnRange(tx, i_begin, i_end);
+            this->forEachActiveRun(flags, tx, [&](int j_begin, int j_end) {
+                kernels->advectSmoke(this->u, this->v, this->s, this->m, m_new, storage, i_begin, i_end, j_begin, j_end,
+                                     this->columnOffset, this->width, this->height, this->stride, this->h, dt);
+            });
+        }
+        std::swap(this->m, this->temp_m);
+        return;
+    }
+    
+    int stride = this->stride;
+    float h2 = 0.5f * this->h;
+    
+    for (int i = 1; i < this->width - 1; i++) {
+        this->forEachActiveRun(flags, this->tileColumn(i), [&](int j_begin, int j_end) {
+            for (int j = j_begin; j < j_end; j++) {
+                if (this->s[i * stride + j] != 0) {
+                    // Get velocity at cell center by averaging neighboring velocity components
+                    //u stored at left of cell, v stored at bottom of cell
+                    float u = (this->u[i * stride + j] + this->u[(i+1) * stride + j]) * 0.5f;
+                    float v = (this->v[i * stride + j] + this->v[i * stride + j+1]) * 0.5f;
+                    
+                    // Calculate position to sample from (backtracking)
+                    float x = (i + this->columnOffset) * this->h + h2 - dt * u;
+                    float y = j * this->h + h2 - dt * v;
+                    
+                    // Sample smoke field at the backtracked position using interpolateComponent
+                    encodeSmoke(m_new, i * stride + j, storage, this->interpolateComponent(x, y, FieldType::Smoke));
+                } else {
+                    int c = i * stride + j;
+                    std::memcpy(m_new + c * smoke_bytes, this->m + c * smoke_bytes, smoke_bytes);
+                }
+            }
+        });
+    }
+    
+    std::swap(this->m, this->temp_m);
+}
+
+void Fluid::fineRange(int i0, int i1, int n, int fine_n, int& begin, int& end) const {
+    int f = this->smokeFactor;
+    begin = i0 <= 0 ? 0 : (i0 - 1) * f + 1;
+    end = i1 >= n ? fine_n : (i1 - 1) * f + 1;
+}
+
+float Fluid::sampleFine(const float* f, float x, float y) const {
+    float h = this->h;
+    float hf = h / this->smokeFactor;
+    int fine_stride = this->fineStride;
+
+    // inside the walls; the ghost ring holds the boundary values like the coarse one
+    x = std::max(std::min(x, (this->width - 1) * h), h);
+    y = std::max(std::min(y, (this->height - 1) * h), h);
+
+    // fine cell fi is centred at h + (fi - 0.5) * hf
+    float X = (x - h) / hf + 0.5f;
+    float Y = (y - h) / hf + 0.5f;
+    // X, Y >= 0.5 after the clamps, the cast floors
+    int x0 = std::min(static_cast<int>(X), this->fineWidth - 2);
+    int y0 = std::min(static_cast<int>(Y), this->fineHeight - 2);
+    float w_right = X - x0;
+    float w_up = Y - y0;
+
+    const float* column = f + x0 * fine_stride + y0;
+    float f00 = column[0];
+    float f01 = column[1];
+    float f10 = column[fine_stride];
+    float f11 = column[fine_stride + 1];
+    return (1 - w_right) * ((1 - w_up) * f00 + w_up * f01) + w_right * ((1 - w_up) * f10 + w_up * f11);
+}
+
+void Fluid::advectFineSmoke(float dt, const unsigned char* flags) {
+    const float* f = this->fine_m;
+    float* f_new = this->temp_fine_m;
+    int fine_stride = this->fineStride;
+    // solid, ghost and unvisited cells keep their smoke
+    std::copy(f, f + static_cast<size_t>(this->fineWidth) * fine_stride, f_new);
+
+    int stride = this->stride;
+    float h = this->h;
+    float h2 = 0.5f * h;
+    float hf = h / this->smokeFactor;
+
+    // fine cell centres lie inside the walls, so the velocity samples never hit the clamps
+    // of sampleField and their weights only depend on the fine column or row: u is sampled
+    // at x / h, (y - h / 2) / h and v at (x - h / 2) / h, y / h in cells. Both are positive,
+    // the cast floors (std::floor is a libm call without SSE4.1)
+    auto weight = [h](float x, float offset, int& k) {
+        float X = (x - offset) / h;
+        k = static_cast<int>(X);
+        return X - k;
+    };
+
+    for (int i = 1; i < this->width - 1; i++) {
+        int fi_begin, fi_end;
+        this->fineRange(i, i + 1, this->width - 1, this->fineWidth - 1, fi_begin, fi_end);
+        this->forEachActiveRun(flags, this->tileColumn(i), [&](int j_begin, int j_end) {
+            for (int fi = fi_begin; fi < fi_end; fi++) {
+                float x = h + (fi - 0.5f) * hf;
+                int ui, vi;
+                float uwx = weight(x, 0.0f, ui);
+                float vwx = weight(x, h2, vi);
+                const float* u0 = this->u + ui * stride;
+                const float* v0 = this->v + vi * stride;
+                float* column = f_new + fi * fine_stride;
+
+                for (int j = j_begin; j < j_end; j++) {
+                    if (this->s[i * stride + j] == 0) {
+                        continue;
+                    }
+                    int fj_begin = (j - 1) * this->smokeFactor + 1;
+                    for (int fj = fj_begin; fj < fj_begin + this->smokeFactor; fj++) {
+                        float y = h + (fj - 0.5f) * hf;
+                        int uj, vj;
+                        float uwy = weight(y, h2, uj);
+                        float vwy = weight(y, 0.0f, vj);
+                        // the staggered velocities at the fine cell centre, not the cell's average
+                        float u = (1 - uwx) * ((1 - uwy) * u0[uj] + uwy * u0[uj + 1])
+                                + uwx * ((1 - uwy) * u0[stride + uj] + uwy * u0[stride + uj + 1]);
+                        float v = (1 - vwx) * ((1 - vwy) * v0[vj] + vwy * v0[vj + 1])
+                                + vwx * ((1 - vwy) * v0[stride + vj] + vwy * v0[stride + vj + 1]);
+                        column[fj] = this->sampleFine(f, x - dt * u, y - dt * v);
+                    }
+                }
+            }
+        });
+    }
+
+    std::swap(this->fine_m, this->temp_fine_m);
+}
+
+void Fluid::downsampleFineSmoke() {
+    int f = this->smokeFactor;
+    int stride = this->stride;
+    int fine_stride = this->fineStride;
+    float scale = 1.0f / (f * f);
+
+    for (int i = 1; i < this->width - 1; i++) {
+        const float* column = this->fine_m + ((i - 1) * f + 1) * fine_stride;
+        for (int j = 1; j < this->height - 1; j++) {
+            const float* block = column + (j - 1) * f + 1;
+            float sum = 0.0f;
+            for (int a = 0; a < f; a++) {
+                for (int b = 0; b < f; b++) {
+                    sum += block[a * fine_stride + b];
+                }
+            }
+            encodeSmoke(this->m, i * stride + j, this->smokeStorage, sum * scale);
+        }
+    }
+}
+
+void Fluid::fillFineSmoke(int i0, int j0, int i1, int j1, float value) {
+    if (this->smokeFactor == 1) {
+        return;
+    }
+    int fi_begin, fi_end, fj_begin, fj_end;
+    this->fineRange(i0, i1, this->width, this->fineWidth, fi_begin, fi_end);
+    this->fineRange(j0, j1, this->height, this->fineHeight, fj_begin, fj_end);
+    for (int fi = fi_begin; fi < fi_end; fi++) {
+        float* column = this->fine_m + fi * this->fineStride;
+        std::fill(column + fj_begin, column + fj_end, value);
+    }
+}
+
+void Fluid::setSmokeResolution(int factor) {
+    factor = std::max(factor, 1);
+    if (factor == this->smokeFactor) {
+        return;
+    }
+
+    this->smokeFactor = factor;
+    this->fine_arena = FieldArena();
+    this->fine_m = nullptr;
+    this->temp_fine_m = nullptr;
+    if (factor == 1) {
+        this->fineWidth = 0;
+        this->fineHeight = 0;
+        this->fineStride = 0;
+        return;
+    }
+
+    this->fineWidth = (this->width - 2) * factor + 2;
+    this->fineHeight = (this->height - 2) * factor + 2;
+    // whole cache lines per column, like the coarse fields
+    this->fineStride = static_cast<int>(FieldArena::slotSize(static_cast<size_t>(this->fineHeight) * sizeof(float)) / sizeof(float));
+    size_t slot = FieldArena::slotSize(static_cast<size_t>(this->fineWidth) * this->fineStride * sizeof(float));
+    this->fine_arena = FieldArena(2 * slot, false);
+    this->fine_m = reinterpret_cast<float*>(this->fine_arena.get());
+    this->temp_fine_m = reinterpret_cast<float*>(this->fine_arena.get() + slot);
+
+    // every fine cell starts with the smoke of its cell
+    for (int i = 0; i < this->width; i++) {
+        for (int j = 0; j < this->height; j++) {
+            this->fillFineSmoke(i, j, i + 1, j + 1, decodeSmoke(this->m, i * this->stride + j, this->smokeStorage));
+        }
+    }
+}
+
+int Fluid::getSmokeResolution() const {
+    return this->smokeFactor;
+}
+
+void Fluid::advectScalars(float dt) {
+    int count = this->getScalarCount();
+    if (count == 0) {
+        return;
+    }
+
+    float* f = this->scalars;
+    float* f_new = this->temp_scalars;
+    // a cell of the interleaved block is one element of count floats
+    this->copyUnvisited(f, f_new, count * static_cast<int>(sizeof(float)), nullptr);
+
+    int stride = this->stride;
+    int off = this->columnOffset;
+    float h2 = 0.5f * this->h;
+    float half_cell = this->h/2;
+
+    for (int i = 1; i < this->width - 1; i++) {
+        for (int j = 1; j < this->height - 1; j++) {
+            int c = i * stride + j;
+            if (this->s[c] == 0) {
+                std::copy(f + c * count, f + (c + 1) * count, f_new + c * count);
+                continue;
+            }
+
+            // same backtrace and weights as advectSmoke, once for all the scalars
+            float u = (this->u[c] + this->u[c + stride]) * 0.5f;
+            float v = (this->v[c] + this->v[c + 1]) * 0.5f;
+            float x = (i + this->columnOffset) * this->h + h2 - dt * u;
+            float y = j * this->h + h2 - dt * v;
+
+            x = std::max(std::min(x, (off + this->width) * this->h), (off + 1) * this->h);
+            y = std::max(std::min(y, this->height * this->h), this->h);
+
+            int x0 = std::min(static_cast<int>(std::floor((x - half_cell)/this->h)), off + this->width-1);
+            int x1 = std::min(x0 + 1, off + this->width-1);
+            int y0 = std::min(static_cast<int>(std::floor((y - half_cell)/this->h)), this->height-1);
+            int y1 = std::min(y0 + 1, this->height-1);
+
+            float w_right = ((x - half_cell) - x0*this->h)/this->h;
+            float w_up = ((y - half_cell) - y0*this->h)/this->h;
+            float w_left = 1-w_right;
+            float w_down = 1-w_up;
+
+            float w00 = w_left * w_down;
+            float w10 = w_right * w_down;
+            float w11 = w_right * w_up;
+            float w01 = w_left * w_up;
+            x0 -= off;
+            x1 -= off;
+            const float* f00 = f + (x0 * stride + y0) * count;
+            const float* f10 = f + (x1 * stride + y0) * count;
+            const float* f11 = f + (x1 * stride + y1) * count;
+            const float* f01 = f + (x0 * stride + y1) * count;
+            float* out = f_new + c * count;
+            for (int k = 0; k < count; k++) {
+                out[k] = w00 * f00[k] + w10 * f10[k] + w11 * f11[k] + w01 * f01[k];
+            }
+        }
+    }
+
+    std::swap(this->scalars, this->temp_scalars);
+}
+
+void Fluid::copyUnvisited(const void* src, void* dst, int bytes, const unsigned char* flags) const {
+    // everything in bytes, so the same code copies float and compact smoke fields
+    const char* from = static_cast<const char*>(src);
+    char* to = static_cast<char*>(dst);
+    size_t stride = static_cast<size_t>(this->stride) * bytes;
+    size_t column = static_cast<size_t>(this->height) * bytes;
+
+    // ghost columns
+    std::copy(from, from + column, to);
+    size_t last = (this->width - 1) * stride;
+    std::copy(from + last, from + last + column, to + last);
+
+    // ghost rows and the gaps between active runs of the interior columns
+    for (int i = 1; i < this->width - 1; i++) {
+        const char* src_column = from + i * stride;
+        char* dst_column = to + i * stride;
+        size_t j_done = 0;
+        this->forEachActiveRun(flags, this->tileColumn(i), [&](int j_begin, int j_end) {
+            std::copy(src_column + j_done, src_column + j_begin * bytes, dst_column + j_done);
+            j_done = static_cast<size_t>(j_end) * bytes;
+        });
+        std::copy(src_column + j_done, src_column + column, dst_column + j_done);
+    }
+}
+
+void Fluid::simulate(float dt,int tot_iter,float g){
+    this->simulate(dt,tot_iter,g,this->pressureSolver);
+}
+
+void Fluid::simulate(float dt,int tot_iter,float g,PressureSolver solver){
+    if(this->cflNumber <= 0.0f){
+        this->step(dt,tot_iter,g,solver);
+        this->stats.substeps = 1;
+        this->stats.substepDt = dt;
+        this->stats.maxCfl = 0.0f;
+        return;
+    }
+
+    // a face can still pick up about sqrt(5 h |g|) from gravity during the substep
+    // (Bridson), so calm scenes do not get a step gravity would push past the limit
+    float gravity_speed = std::sqrt(5.0f * this->h * std::fabs(g));
+    float remaining = dt;
+    int substeps = 0;
+    int iterations = 0;
+    float smallest = dt;
+    float largest_cfl = 0.0f;
+    while(remaining > 0.0f){
+        float speed = this->maxVelocity();
+        float sub_dt = remaining;
+        if(substeps + 1 < this->maxSubsteps && (speed + gravity_speed) * remaining > this->cflNumber * this->h){
+            sub_dt = this->cflNumber * this->h / (speed + gravity_speed);
+            // two equal halves rather than a full step and a sliver
+            if(2.0f * sub_dt > remaining){
+                sub_dt = 0.5f * remaining;
+            }
+        }
+
+        this->step(sub_dt,tot_iter,g,solver);
+        iterations += this->stats.pressureIterations;
+        substeps++;
+        smallest = std::min(smallest, sub_dt);
+        largest_cfl = std::max(largest_cfl, speed * sub_dt / this->h);
+        remaining = sub_dt < remaining ? remaining - sub_dt : 0.0f;
+    }
+
+    this->stats.pressureIterations = iterations;
+    this->stats.substeps = substeps;
+    this->stats.substepDt = smallest;
+    this->stats.maxCfl = largest_cfl;
+}
+
+void Fluid::setAdaptiveStep(float cfl, int maxSubsteps){
+    this->cflNumber = std::max(cfl, 0.0f);
+    this->maxSubsteps = std::max(maxSubsteps, 1);
+}
+
+float Fluid::getCflNumber() const {
+    return this->cflNumber;
+}
+
+int Fluid::getMaxSubsteps() const {
+    return this->maxSubsteps;
+}
+
+void Fluid::step(float dt,int tot_iter,float g,PressureSolver solver){
+    if(this->profiler != nullptr){
+        this->profiler->beginStep();
+    }
+
+    // before the emitters, so the particles pick up what they set through the FLIP update
+    if(this->flip != nullptr){
+        StageTimer timer(this, StepStage::ParticleToGrid, solver);
+        this->flip->particleToGrid(this->u, this->v, this->temp_u, this->temp_v, this->advectScratch(0),
+                                   this->advectScratch(1), this->s, this->getThreadPool());
+    }
+    if(!this->emitters.empty()){
+        StageTimer timer(this, StepStage::Emitters, solver);
+        this->applyEmitters();
+    }
+    if(this->tileSize > 0){
+        StageTimer timer(this, StepStage::Tiles, solver);
+        this->updateActiveTiles();
+    }
+    // with temporal blocking the cheap stages ride along with the SOR passes, and their
+    // time is part of the pressure stage
+    bool fused = solver == PressureSolver::GaussSeidel && this->temporalBlocking > 1;
+    if(fused){
+        StageTimer timer(this, StepStage::Pressure, solver);
+        this->stepFused(dt,tot_iter,g);
+    } else {
+        {
+            StageTimer timer(this, StepStage::Gravity, solver);
+            this->propagateGravity(dt,g);
+        }
+        // CG warm-starts from the previous frame's pressure instead of zero
+        if(solver != PressureSolver::ConjugateGradient){
+            StageTimer timer(this, StepStage::ResetPressure, solver);
+            this->resetPressure();
+        }
+        {
+            StageTimer timer(this, StepStage::Pressure, solver);
+            this->applyIncompressibility(dt,tot_iter,solver);
+        }
+    }
+    if(this->profiler != nullptr){
+        this->profiler->setDivergence(this->maxDivergence());
+    }
+    if(!fused){
+        StageTimer timer(this, StepStage::Extrapolate, solver);
+        this->extrapolate();
+    }
+    {
+        StageTimer timer(this, StepStage::Advect, solver);
+        if(this->flip != nullptr){
+            // temp_u / temp_v still hold the faces as the particles left them
+            this->flip->gridToParticle(this->u, this->v, this->temp_u, this->temp_v, this->s, dt, this->getThreadPool());
+        } else {
+            this->advect(dt);
+        }
+    }
+    {
+        StageTimer timer(this, StepStage::AdvectSmoke, solver);
+        this->advectSmoke(dt);
+    }
+    if(this->getScalarCount() > 0){
+        StageTimer timer(this, StepStage::AdvectScalars, solver);
+        this->advectScalars(dt);
+    }
+}
+
+Fluid::StageTimer::StageTimer(Fluid* fluid, StepStage stage, PressureSolver solver) {
+    this->fluid = fluid->profiler != nullptr ? fluid : nullptr;
+    this->stage = stage;
+    this->solver = solver;
+    if(this->fluid != nullptr){
+        this->start = StepProfiler::Clock::now();
+    }
+}
+
+Fluid::StageTimer::~StageTimer() {
+    if(this->fluid == nullptr){
+        return;
+    }
+    StepProfiler::Clock::time_point end = StepProfiler::Clock::now();
+    long long cells, bytes;
+    this->fluid->stageWork(this->stage, this->solver, cells, bytes);
+    this->fluid->profiler->record(this->stage, this->start, end, cells, bytes);
+}
+
+void Fluid::stageWork(StepStage stage, PressureSolver solver, long long& cells, long long& bytes) const {
+    long long interior = static_cast<long long>(this->width - 2) * (this->height - 2);
+    long long active = static_cast<long long>(interior * this->stats.activeTileFraction);
+    int smoke_bytes = smokeStorageBytes(this->smokeStorage);
+    switch(stage){
+        case StepStage::ParticleToGrid:
+            // binning reads x and writes the key and the order, the splat reads x, y, u, v
+            // through the order; four grid fields cleared, then normalized into u, v and
+            // their copies (sorting every few steps not counted)
+            cells = this->getParticleCount();
+            bytes = cells * (4 + 8 + 4 + 16) + static_cast<long long>(this->totCells) * (16 + 33);
+            break;
+        case StepStage::Emitters:
+            // a velocity component and the smoke per cell, at most
+            cells = 0;
+            for(const Emitter& emitter : this->emitters){
+                int i0 = emitter.i0, j0 = emitter.j0, i1 = emitter.i1, j1 = emitter.j1;
+                if(emitter.active && this->clipRect(i0, j0, i1, j1)){
+                    cells += static_cast<long long>(i1 - i0) * (j1 - j0);
+                }
+            }
+            bytes = cells * (4 + smoke_bytes);
+            break;
+        case StepStage::Tiles:
+            // reads u and v
+            cells = interior;
+            bytes = cells * 8;
+            break;
+        case StepStage::Gravity:
+            // v read and written, s of the cell and the one below
+            cells = active;
+            bytes = cells * 10;
+            break;
+        case StepStage::ResetPressure:
+            cells = this->totCells;
+            bytes = cells * 4;
+            break;
+        case StepStage::Pressure:
+            cells = active * this->stats.pressureIterations;
+            if(solver == PressureSolver::ConjugateGradient){
+                // matrix-vector product, two dot products and three vector updates
+                bytes = cells * 36;
+            } else if(solver == PressureSolver::GaussSeidel && this->temporalBlocking > 1){
+                // the fields stream in once per wavefront pass, gravity and the reset with
+                // the first one
+                int passes = (this->stats.pressureIterations + this->temporalBlocking - 1) / this->temporalBlocking;
+                bytes = active * (25 * passes + 6) + static_cast<long long>(this->totCells) * 4;
+            } else {
+                // u, v and p read and written, s
+                bytes = cells * 25;
+            }
+            break;
+        case StepStage::Extrapolate:
+            cells = 2 * (this->width + this->height);
+            bytes = cells * 8;
+            break;
+        case StepStage::Advect:
+            // u, v and s read, both new components written
+            cells = active;
+            bytes = cells * 17;
+            if(this->flip != nullptr){
+                // every particle read and written; the grid stays in cache
+                cells = this->getParticleCount();
+                bytes = cells * 32 + static_cast<long long>(this->totCells) * 16;
+            } else if(this->advectionScheme != AdvectionScheme::SemiLagrangian){
+                // three passes, the last also reads the forward and backward fields
+                bytes = cells * (3 * 17 + 16);
+            }
+            break;
+        case StepStage::AdvectSmoke:
+            cells = static_cast<long long>(interior * this->stats.smokeTileFraction);
+            bytes = cells * (9 + 2 * smoke_bytes);
+            if(this->smokeFactor > 1){
+                // per fine cell u and v around it, the fine smoke read and written (plus the
+                // front to back copy), then the box filter back into m
+                long long fine = cells * this->smokeFactor * this->smokeFactor;
+                bytes = fine * (8 + 16) + cells * (1 + smoke_bytes);
+                cells = fine;
+            } else if(this->advectionScheme != AdvectionScheme::SemiLagrangian){
+                bytes = cells * (3 * 9 + 16 + 2 * smoke_bytes);
+            }
+            break;
+        case StepStage::AdvectScalars:
+            cells = interior;
+            bytes = cells * (9 + 8 * this->getScalarCount());
+            break;
+        default:
+            cells = 0;
+            bytes = 0;
+            break;
+    }
+}
+
+float Fluid::maxDivergence() const {
+    int stride = this->stride;
+    float largest = 0.0f;
+    for(int i = 1; i < this->width - 1; i++){
+        for(int j = 1; j < this->height - 1; j++){
+            int c = i * stride + j;
+            if(this->s[c] == 0){
+                continue;
+            }
+            float d = this->u[c + stride] - this->u[c] + this->v[c + 1] - this->v[c];
+            largest = std::max(largest, std::fabs(d));
+        }
+    }
+    return largest;
+}
+
+void Fluid::setProfiling(bool enabled, int window, bool trace){
+    delete this->profiler;
+    this->profiler = enabled ? new StepProfiler(window, trace) : nullptr;
+}
+
+bool Fluid::isProfiling() const {
+    return this->profiler != nullptr;
+}
+
+bool Fluid::getProfile(FluidProfile& profile) const {
+    if(this->profiler == nullptr){
+        return false;
+    }
+    this->profiler->summarize(profile);
+    return true;
+}
+
+bool Fluid::writeChromeTrace(const std::string& path) const {
+    if(this->profiler == nullptr || !this->profiler->isTracing()){
+        return false;
+    }
+    return this->profiler->writeChromeTrace(path);
+}
+
+float* Fluid::getPressureField(){
+    return this->p;
+}
+
+void Fluid::setFluid(int i, int j, int value){
+    this->s[i * this->stride + j] = value != 0 ? 1 : 0;
+    // set explicitly, the cell is no longer the obstacles' to hand back
+    if (this->obstacle_cells != nullptr) {
+        this->obstacle_cells[i * this->stride + j] = 0;
+    }
+    
+    // If setting as solid boundary, also set velocity to zero
+    if (value == 0) {
+        int stride = this->stride;
+        // Set u velocity to zero (stored at left edge of cell)
+        this->u[i * stride + j] = 0.0f;
+        // Set v velocity to zero (stored at bottom edge of cell)
+        this->v[i * stride + j] = 0.0f;
+        // Also set smoke to zero at solid boundaries
+        encodeSmoke(this->m, i * stride + j, this->smokeStorage, 0.0f);
+        this->fillFineSmoke(i, j, i + 1, j + 1, 0.0f);
+        int count = this->getScalarCount();
+        if (count > 0) {
+            std::fill(this->scalars + (i * stride + j) * count, this->scalars + (i * stride + j + 1) * count, 0.0f);
+        }
+    }
+}
+
+bool Fluid::clipRect(int& i0, int& j0, int& i1, int& j1) const {
+    i0 = std::max(i0, 0);
+    j0 = std::max(j0, 0);
+    i1 = std::min(i1, this->width);
+    j1 = std::min(j1, this->height);
+    return i0 < i1 && j0 < j1;
+}
+
+void Fluid::setFluidRect(int i0, int j0, int i1, int j1, int value){
+    if(!this->clipRect(i0, j0, i1, j1)){
+        return;
+    }
+    int stride = this->stride;
+    int rows = j1 - j0;
+    int count = this->getScalarCount();
+    int smoke_bytes = smokeStorageBytes(this->smokeStorage);
+    unsigned char flag = value != 0 ? 1 : 0;
+
+    // setFluid a column run at a time
+    for(int i = i0; i < i1; i++){
+        int c = i * stride + j0;
+        std::fill(this->s + c, this->s + c + rows, flag);
+        if(this->obstacle_cells != nullptr){
+            std::fill(this->obstacle_cells + c, this->obstacle_cells + c + rows, 0);
+        }
+        if(flag != 0){
+            continue;
+        }
+        std::fill(this->u + c, this->u + c + rows, 0.0f);
+        std::fill(this->v + c, this->v + c + rows, 0.0f);
+        // zero bits are 0.0 in every smoke storage
+        std::memset(this->m + c * smoke_bytes, 0, rows * smoke_bytes);
+        if(count > 0){
+            std::fill(this->scalars + c * count, this->scalars + (c + rows) * count, 0.0f);
+        }
+    }
+    if(flag == 0){
+        this->fillFineSmoke(i0, j0, i1, j1, 0.0f);
+    }
+}
+
+void Fluid::setFluidMask(FieldView<const unsigned char> mask, int value){
+    int columns = std::min(mask.columns, this->width);
+    int rows = std::min(mask.rows, this->height);
+    for(int i = 0; i < columns; i++){
+        const unsigned char* column = mask.column(i);
+        for(int j = 0; j < rows; j++){
+            if(column[j] != 0){
+                this->setFluid(i, j, value);
+            }
+        }
+    }
+}
+
+void Fluid::fillRect(FieldType field, int i0, int j0, int i1, int j1, float value){
+    if(!this->clipRect(i0, j0, i1, j1)){
+        return;
+    }
+    for(int i = i0; i < i1; i++){
+        int c = i * this->stride + j0;
+        int rows = j1 - j0;
+        switch(field){
+            case FieldType::U:
+                std::fill(this->u + c, this->u + c + rows, value);
+                break;
+            case FieldType::V:
+                std::fill(this->v + c, this->v + c + rows, value);
+                break;
+            case FieldType::Smoke:
+                this->fillSmoke(c, rows, value);
+                break;
+        }
+    }
+}
+
+void Fluid::fillMask(FieldType field, FieldView<const unsigned char> mask, float value){
+    int columns = std::min(mask.columns, this->width);
+    int rows = std::min(mask.rows, this->height);
+    for(int i = 0; i < columns; i++){
+        const unsigned char* column = mask.column(i);
+        int c0 = i * this->stride;
+        for(int j = 0; j < rows; j++){
+            if(column[j] == 0){
+                continue;
+            }
+            switch(field){
+                case FieldType::U:
+                    this->u[c0 + j] = value;
+                    break;
+                case FieldType::V:
+                    this->v[c0 + j] = value;
+                    break;
+                case FieldType::Smoke:
+                    encodeSmoke(this->m, c0 + j, this->smokeStorage, value);
+                    this->fillFineSmoke(i, j, i + 1, j + 1, value);
+                    break;
+            }
+        }
+    }
+}
+
+void Fluid::fillSmoke(int c, int count, float value){
+    // count cells down one column
+    this->fillFineSmoke(c / this->stride, c % this->stride, c / this->stride + 1, c % this->stride + count, value);
+    if(this->smokeStorage == SmokeStorage::Float32){
+        float* m = reinterpret_cast<float*>(this->m);
+        std::fill(m + c, m + c + count, value);
+        return;
+    }
+    for(int k = c; k < c + count; k++){
+        encodeSmoke(this->m, k, this->smokeStorage, value);
+    }
+}
+
+bool Fluid::isFluid(int i, int j) const {
+    return this->s[i * this->stride + j] != 0;
+}
+
+void Fluid::activateFluid(){
+    for(int i = 0; i < this->width; i++){
+        for(int j = 0; j < this->height; j++){
+            this->s[i * this->stride + j] = 1;
+        }
+    }
+
+}
+
+void Fluid::resetPressure(){
+    for(int i = 0; i < this->width; i++){
+        for(int j = 0; j < this->height; j++){
+            this->p[i * this->stride + j] = 0;
+        }
+    }
+}
+
+const float* Fluid::getSmokeField(){
+    if(this->smokeStorage == SmokeStorage::Float32){
+        return reinterpret_cast<const float*>(this->m);
+    }
+    if(this->smoke_view == nullptr){
+        this->smoke_view = new float[this->totCells];
+    }
+    for(int c = 0; c < this->totCells; c++){
+        this->smoke_view[c] = decodeSmoke(this->m, c, this->smokeStorage);
+    }
+    return this->smoke_view;
+}
+
+const float* Fluid::getFineSmokeField(){
+    if(this->smokeFactor == 1){
+        return this->getSmokeField();
+    }
+    return this->fine_m;
+}
+
+int Fluid::getFineSmokeStride() const {
+    return this->smokeFactor == 1 ? this->stride : this->fineStride;
+}
+
+int Fluid::getFineSmokeSize() const {
+    return this->smokeFactor == 1 ? this->totCells : this->fineWidth * this->fineStride;
+}
+
+FieldView<const float> Fluid::viewFineSmoke(){
+    if(this->smokeFactor == 1){
+        return this->viewSmokeValues();
+    }
+    return FieldView<const float>(this->fine_m, this->fineStride, this->fineWidth, this->fineHeight);
+}
+
+float* Fluid::getUField(){
+    return this->u;
+}
+
+float* Fluid::getVField(){
+    return this->v;
+}
+
+FieldView<float> Fluid::viewU(){
+    return FieldView<float>(this->u, this->stride, this->width, this->height);
+}
+
+FieldView<float> Fluid::viewV(){
+    return FieldView<float>(this->v, this->stride, this->width, this->height);
+}
+
+FieldView<float> Fluid::viewPressure(){
+    return FieldView<float>(this->p, this->stride, this->width, this->height);
+}
+
+FieldView<float> Fluid::viewSmoke(){
+    if(this->smokeStorage != SmokeStorage::Float32){
+        return FieldView<float>();
+    }
+    return FieldView<float>(reinterpret_cast<float*>(this->m), this->stride, this->width, this->height);
+}
+
+FieldView<const float> Fluid::viewU() const {
+    return FieldView<const float>(this->u, this->stride, this->width, this->height);
+}
+
+FieldView<const float> Fluid::viewV() const {
+    return FieldView<const float>(this->v, this->stride, this->width, this->height);
+}
+
+FieldView<const float> Fluid::viewPressure() const {
+    return FieldView<const float>(this->p, this->stride, this->width, this->height);
+}
+
+FieldView<const float> Fluid::viewSmokeValues(){
+    return FieldView<const float>(this->getSmokeField(), this->stride, this->width, this->height);
+}
+
+FieldView<const unsigned char> Fluid::viewSolid() const {
+    return FieldView<const unsigned char>(this->s, this->stride, this->width, this->height);
+}
+
+int Fluid::getStride() const {
+    return this->stride;
+}
+
+int Fluid::getWidth() const {
+    return this->width - 2;
+}
+
+int Fluid::getHeight() const {
+    return this->height - 2;
+}
+
+int Fluid::getFieldSize() const {
+    return this->totCells;
+}
+
+bool Fluid::usesHugePages() const {
+    return this->arena.usesHugePages();
+}
+
+size_t Fluid::getFieldBytes() const {
+    return this->arena.size() + this->scalar_arena.size();
+}
+
+int Fluid::addScalar(const std::string& name){
+    int existing = this->findScalar(name);
+    if (existing >= 0) {
+        return existing;
+    }
+
+    // re-interleave into a block one float wider per cell, the new scalar starts at 0
+    int count = this->getScalarCount();
+    int new_count = count + 1;
+    size_t slot = FieldArena::slotSize(static_cast<size_t>(this->totCells) * new_count * sizeof(float));
+    FieldArena new_arena(2 * slot, false);
+    float* new_scalars = reinterpret_cast<float*>(new_arena.get());
+    for (int c = 0; c < this->totCells; c++) {
+        for (int k = 0; k < count; k++) {
+            new_scalars[c * new_count + k] = this->scalars[c * count + k];
+        }
+    }
+
+    this->scalar_arena = std::move(new_arena);
+    this->scalars = new_scalars;
+    this->temp_scalars = reinterpret_cast<float*>(this->scalar_arena.get() + slot);
+    this->scalar_names.push_back(name);
+    return count;
+}
+
+int Fluid::findScalar(const std::string& name) const {
+    for (size_t k = 0; k < this->scalar_names.size(); k++) {
+        if (this->scalar_names[k] == name) {
+            return static_cast<int>(k);
+        }
+    }
+    return -1;
+}
+
+int Fluid::getScalarCount() const {
+    return static_cast<int>(this->scalar_names.size());
+}
+
+const std::string& Fluid::getScalarName(int k) const {
+    return this->scalar_names[k];
+}
+
+void Fluid::setScalar(int k, int i, int j, float value){
+    this->scalars[(i * this->stride + j) * this->getScalarCount() + k] = value;
+}
+
+float Fluid::getScalar(int k, int i, int j) const {
+    return this->scalars[(i * this->stride + j) * this->getScalarCount() + k];
+}
+
+void Fluid::copyScalarField(int k, float* out) const {
+    int count = this->getScalarCount();
+    for (int c = 0; c < this->totCells; c++) {
+        out[c] = this->scalars[c * count + k];
+    }
+}
+
+float* Fluid::getScalarData(){
+    return this->scalars;
+}
+
+void Fluid::setSmoke(int i, int j, float value){
+    encodeSmoke(this->m, i * this->stride + j, this->smokeStorage, value);
+    this->fillFineSmoke(i, j, i + 1, j + 1, value);
+}
+
+void Fluid::setU(int i, int j, float value){
+    this->u[i * this->stride + j] = value;
+}
+
+void Fluid::setV(int i, int j, float value){
+    this->v[i * this->stride + j] = value;
+}
+
+bool Fluid::obstacleContains(const Obstacle& obstacle, int i, int j) const {
+    float dx = (i - 0.5f) - obstacle.x;
+    float dy = (j - 0.5f) - obstacle.y;
+
+    if (obstacle.shape == ObstacleShape::Circle) {
+        return dx*dx + dy*dy <= obstacle.radius * obstacle.radius;
+    }
+    return std::fabs(dx) <= obstacle.halfWidth && std::fabs(dy) <= obstacle.halfHeight;
+}
+
+void Fluid::obstacleBounds(const Obstacle& obstacle, int& i0, int& i1, int& j0, int& j1) const {
+    float ex = obstacle.shape == ObstacleShape::Circle ? obstacle.radius : obstacle.halfWidth;
+    float ey = obstacle.shape == ObstacleShape::Circle ? obstacle.radius : obstacle.halfHeight;
+
+    // cell centres sit at i - 0.5
+    i0 = std::max(1, static_cast<int>(std::floor(obstacle.x - ex + 0.5f)));
+    i1 = std::min(this->width - 2, static_cast<int>(std::ceil(obstacle.x + ex + 0.5f)));
+    j0 = std::max(1, static_cast<int>(std::floor(obstacle.y - ey + 0.5f)));
+    j1 = std::min(this->height - 2, static_cast<int>(std::ceil(obstacle.y + ey + 0.5f)));
+}
+
+void Fluid::rasterizeObstacles(int i0, int i1, int j0, int j1) {
+    int stride = this->stride;
+
+    for (int i = i0; i <= i1; i++) {
+        for (int j = j0; j <= j1; j++) {
+            int c = i * stride + j;
+
+            const Obstacle* cover = nullptr;
+            for (const Obstacle& obstacle : this->obstacles) {
+                if (obstacle.active && this->obstacleContains(obstacle, i, j)) {
+                    cover = &obstacle;
+                    break;
+                }
+            }
+
+            // a cell that was solid before the obstacle came is a wall, the obstacle leaves it
+            // alone and never hands it back
+            if (cover != nullptr && (this->s[c] != 0 || this->obstacle_cells[c] != 0)) {
+                this->s[c] = 0;
+                this->obstacle_cells[c] = 1;
+                // moving boundary: the solver sees the obstacle velocity on every face of the cell
+                this->u[c] = cover->vx;
+                this->u[c + stride] = cover->vx;
+                this->v[c] = cover->vy;
+                this->v[c + 1] = cover->vy;
+                encodeSmoke(this->m, c, this->smokeStorage, 0.0f);
+                this->fillFineSmoke(i, j, i + 1, j + 1, 0.0f);
+                int count = this->getScalarCount();
+                std::fill(this->scalars + c * count, this->scalars + (c + 1) * count, 0.0f);
+            } else if (cover == nullptr && this->obstacle_cells[c] != 0) {
+                // uncovered, hand the cell back to the fluid; walls set with setFluid stay put
+                this->s[c] = 1;
+                this->obstacle_cells[c] = 0;
+            }
+        }
+    }
+}
+
+int Fluid::addCircleObstacle(float x, float y, float radius) {
+    Obstacle obstacle;
+    obstacle.shape = ObstacleShape::Circle;
+    obstacle.x = x;
+    obstacle.y = y;
+    obstacle.radius = radius;
+    obstacle.active = true;
+
+    if (this->obstacle_cells == nullptr) {
+        this->obstacle_cells = new unsigned char[this->totCells]();
+    }
+
+    this->obstacles.push_back(obstacle);
+    int i0, i1, j0, j1;
+    this->obstacleBounds(obstacle, i0, i1, j0, j1);
+    this->rasterizeObstacles(i0, i1, j0, j1);
+
+    return static_cast<int>(this->obstacles.size()) - 1;
+}
+
+int Fluid::addBoxObstacle(float x, float y, float halfWidth, float halfHeight) {
+    Obstacle obstacle;
+    obstacle.shape = ObstacleShape::Box;
+    obstacle.x = x;
+    obstacle.y = y;
+    obstacle.halfWidth = halfWidth;
+    obstacle.halfHeight = halfHeight;
+    obstacle.active = true;
+
+    if (this->obstacle_cells == nullptr) {
+        this->obstacle_cells = new unsigned char[this->totCells]();
+    }
+
+    this->obstacles.push_back(obstacle);
+    int i0, i1, j0, j1;
+    this->obstacleBounds(obstacle, i0, i1, j0, j1);
+    this->rasterizeObstacles(i0, i1, j0, j1);
+
+    return static_cast<int>(this->obstacles.size()) - 1;
+}
+
+void Fluid::moveObstacle(int id, float x, float y, float dt) {
+    Obstacle& obstacle = this->obstacles[id];
+
+    float vx = dt > 0.0f ? (x - obstacle.x) / dt : 0.0f;
+    float vy = dt > 0.0f ? (y - obstacle.y) / dt : 0.0f;
+
+    // resting obstacle that stays put: nothing to update
+    if (x == obstacle.x && y == obstacle.y && vx == obstacle.vx && vy == obstacle.vy) {
+        return;
+    }
+
+    int oi0, oi1, oj0, oj1;
+    this->obstacleBounds(obstacle, oi0, oi1, oj0, oj1);
+
+    obstacle.x = x;
+    obstacle.y = y;
+    obstacle.vx = vx;
+    obstacle.vy = vy;
+
+    int ni0, ni1, nj0, nj1;
+    this->obstacleBounds(obstacle, ni0, ni1, nj0, nj1);
+
+    // old box releases the cells left behind, new box claims the covered ones
+    this->rasterizeObstacles(oi0, oi1, oj0, oj1);
+    this->rasterizeObstacles(ni0, ni1, nj0, nj1);
+}
+
+void Fluid::removeObstacle(int id) {
+    Obstacle& obstacle = this->obstacles[id];
+    if (!obstacle.active) {
+        return;
+    }
+    obstacle.active = false;
+
+    int i0, i1, j0, j1;
+    this->obstacleBounds(obstacle, i0, i1, j0, j1);
+    this->rasterizeObstacles(i0, i1, j0, j1);
+}
+
+const Obstacle& Fluid::getObstacle(int id) const {
+    return this->obstacles[id];
+}
+
+int Fluid::addInflow(int i0, int j0, int i1, int j1, float u, float smoke) {
+    Emitter emitter;
+    emitter.type = EmitterType::Inflow;
+    emitter.i0 = i0;
+    emitter.j0 = j0;
+    emitter.i1 = i1;
+    emitter.j1 = j1;
+    emitter.setsU = true;
+    emitter.u = u;
+    emitter.smoke = smoke;
+    return this->addEmitter(emitter);
+}
+
+int Fluid::addOutflow(int i0, int j0, int i1, int j1) {
+    Emitter emitter;
+    emitter.type = EmitterType::Outflow;
+    emitter.i0 = i0;
+    emitter.j0 = j0;
+    emitter.i1 = i1;
+    emitter.j1 = j1;
+    return this->addEmitter(emitter);
+}
+
+int Fluid::addEmitter(const Emitter& emitter) {
+    this->emitters.push_back(emitter);
+    this->emitters.back().active = true;
+    return static_cast<int>(this->emitters.size()) - 1;
+}
+
+void Fluid::removeEmitter(int id) {
+    this->emitters[id].active = false;
+}
+
+const Emitter& Fluid::getEmitter(int id) const {
+    return this->emitters[id];
+}
+
+int Fluid::getEmitterCount() const {
+    return static_cast<int>(this->emitters.size());
+}
+
+void Fluid::applyEmitters() {
+    int stride = this->stride;
+    int count = this->getScalarCount();
+    int smoke_bytes = smokeStorageBytes(this->smokeStorage);
+
+    for (const Emitter& emitter : this->emitters) {
+        int i0 = emitter.i0, j0 = emitter.j0, i1 = emitter.i1, j1 = emitter.j1;
+        if (!emitter.active || !this->clipRect(i0, j0, i1, j1)) {
+            continue;
+        }
+        int rows = j1 - j0;
+        for (int i = i0; i < i1; i++) {
+            int c = i * stride + j0;
+            if (emitter.type == EmitterType::Outflow) {
+                // zero bits are 0.0 in every smoke storage
+                std::memset(this->m + c * smoke_bytes, 0, rows * smoke_bytes);
+                this->fillFineSmoke(i, j0, i + 1, j1, 0.0f);
+                if (count > 0) {
+                    std::fill(this->scalars + c * count, this->scalars + (c + rows) * count, 0.0f);
+                }
+                continue;
+            }
+            if (emitter.setsU) {
+                std::fill(this->u + c, this->u + c + rows, emitter.u);
+            }
+            if (emitter.setsV) {
+                std::fill(this->v + c, this->v + c + rows, emitter.v);
+            }
+            if (emitter.smoke >= 0.0f) {
+                this->fillSmoke(c, rows, emitter.smoke);
+            }
+        }
+    }
+}
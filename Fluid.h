@@ -1,51 +1,504 @@
 #ifndef FLUID_H
 #define FLUID_H
 
+#include <functional>
 #include <string>
+#include <vector>
+#include "FieldArena.h"
+#include "FieldView.h"
+#include "SimdKernels.h"
+#include "StepProfiler.h"
+
+// fields that can be bilinearly sampled on the staggered grid
+enum class FieldType {
+    U,      // horizontal velocity, stored at the left face of a cell
+    V,      // vertical velocity, stored at the bottom face of a cell
+    Smoke   // smoke density, stored at the cell centre
+};
+
+// how applyIncompressibility orders its SOR updates
+enum class PressureSolver {
+    GaussSeidel,  // serial lexicographic sweep
+    RedBlack,     // checkerboard sweep, each colour split across the thread pool
+    ConjugateGradient  // MIC(0) preconditioned CG to a residual tolerance, warm-started from p
+};
+
+// how advect and advectSmoke move their fields
+enum class AdvectionScheme {
+    SemiLagrangian,  // one bilinear backtrace, first order
+    MacCormack,      // backtrace, retrace forward and correct by half the round trip error
+    Bfecc            // corrects the field by half the round trip error, then backtraces it
+};
+
+// per-step solver statistics, refreshed by simulate()
+struct FluidStats {
+    int pressureIterations = 0;    // iterations run by the pressure solves of the last simulate()
+    float pressureResidual = 0.0f; // max cell divergence left by the last CG solve
+    float activeTileFraction = 1.0f;  // tiles stepped by gravity, projection and advection
+    float smokeTileFraction = 1.0f;   // tiles the last advectSmoke visited
+    int substeps = 1;              // steps the last simulate() was split into
+    float substepDt = 0.0f;        // smallest of them
+    float maxCfl = 0.0f;           // largest max|velocity| * dt / h over them, adaptive stepping only
+};
+
+enum class ObstacleShape {
+    Circle,
+    Box
+};
+
+// moving solid registered with Fluid::addCircleObstacle / addBoxObstacle. Positions are in
+// grid units with interior cell (i, j) centred at (i - 0.5, j - 0.5), same as main.cpp.
+struct Obstacle {
+    ObstacleShape shape = ObstacleShape::Circle;
+    float x = 0.0f;           // centre
+    float y = 0.0f;
+    float radius = 0.0f;      // circle
+    float halfWidth = 0.0f;   // box
+    float halfHeight = 0.0f;
+    float vx = 0.0f;          // velocity imposed on the faces of covered cells
+    float vy = 0.0f;
+    bool active = false;
+};
+
+enum class EmitterType {
+    Inflow,   // imposes velocity and smoke on its cells
+    Outflow   // removes the smoke and scalars that reach its cells
+};
+
+// persistent forcing registered with Fluid::addInflow / addOutflow / addEmitter, applied by
+// simulate() at the start of every step (every substep with adaptive stepping). Covers the
+// cells [i0, i1) x [j0, j1) of the padded grid, like setU(i, j).
+struct Emitter {
+    EmitterType type = EmitterType::Inflow;
+    int i0 = 0;
+    int j0 = 0;
+    int i1 = 0;
+    int j1 = 0;
+    bool setsU = false;   // inflow: u on the left faces of the cells
+    bool setsV = false;   // inflow: v on the bottom faces
+    float u = 0.0f;
+    float v = 0.0f;
+    float smoke = -1.0f;  // inflow: smoke of the cells, negative leaves it alone
+    bool active = false;
+};
+
+class ThreadPool;
+class PcgSolver;
+class FlipSolver;
+struct FlipParticles;
 
 class Fluid {
 private:
     int width;
     int height;
-    int totCells;
+    int stride;    // column stride, height padded to whole cache lines
+    int totCells;  // width * stride, the length of every field
     float gravity;
     float density;
     float overrelax;
     float h;
     
+    // every field below is a slot of this arena, in this order
+    static const int FIELD_COUNT = 9;
+    FieldArena arena;
+
     float* u;
     float* v;
-    int* s;
+    unsigned char* s;  // 1 for fluid, 0 for solid
     float* p;
-    float* m;  // Smoke field
+    unsigned char* m;  // Smoke field, smokeStorage values
     
-    // Temporary arrays to avoid allocation in hot loops
+    // back buffers: advection writes the new field here and swaps it with the front one
     float* temp_u;
     float* temp_v;
-    float* temp_f;
-    float* temp_m;  // Temporary smoke field for advection
+    unsigned char* temp_m;  // Temporary smoke field for advection
+
+    SmokeStorage smokeStorage;
+    float* smoke_view;  // decoded smoke handed out by getSmokeField for compact storage
+
+    // smoke detail: with smokeFactor > 1 the smoke lives on a grid of smokeFactor x
+    // smokeFactor float cells per cell (plus a one cell ghost ring), advected through the
+    // coarse velocities. m then holds its box filtered copy. Both buffers are slots of
+    // fine_arena, empty while smokeFactor is 1
+    int smokeFactor;
+    int fineWidth;   // padded, (width - 2) * smokeFactor + 2
+    int fineHeight;
+    int fineStride;
+    FieldArena fine_arena;
+    float* fine_m;
+    float* temp_fine_m;
+    // fine columns (or rows) [begin, end) of coarse columns [i0, i1); the ghost cells map
+    // to the fine ghost cells
+    void fineRange(int i0, int i1, int n, int fine_n, int& begin, int& end) const;
+    // sets the fine cells of the coarse cells [i0, i1) x [j0, j1), no-op without detail
+    void fillFineSmoke(int i0, int j0, int i1, int j1, float value);
+    // bilinear sample of the fine smoke at (x, y) in coarse grid coordinates
+    float sampleFine(const float* f, float x, float y) const;
+    void advectFineSmoke(float dt, const unsigned char* flags);
+    // m = the average of every cell's fine cells
+    void downsampleFineSmoke();
+
+    // passive scalars (temperature, dye, ...) interleaved per cell: scalar k of cell c sits
+    // at scalars[c * scalar_names.size() + k], so one backtrace serves all of them. Both
+    // buffers are slots of scalar_arena, empty while no scalar is registered
+    std::vector<std::string> scalar_names;
+    FieldArena scalar_arena;
+    float* scalars;
+    float* temp_scalars;
+
+    // byte offset of arena slot `slot` (FIELD_COUNT gives the arena size); slots are
+    // cache line aligned and sized by their element type
+    static size_t slotOffset(int slot, int totCells, SmokeStorage storage);
+    // points the fields at their slots in an arena starting at base
+    void assignFields(char* base);
+
+    PressureSolver pressureSolver;
+    int numThreads;
+    ThreadPool* pool;  // created on first parallel solve
+
+    PcgSolver* pcg;    // created on first CG solve
+    FlipSolver* flip;  // the particles while velocity transport is FLIP / PIC
+    float pcgTolerance;
+    int pcgMaxIter;
+
+    FluidStats stats;
+
+    SimdLevel simdLevel;
+    float* s_mask;  // s as float for the vector SOR kernel, rebuilt every projection
+
+    // advection only visits the interior (and only active tiles), the rest of the back
+    // buffer is copied from the front one before the swap. bytes is the element size
+    void copyUnvisited(const void* src, void* dst, int bytes, const unsigned char* flags) const;
+
+    // rule of five helpers: scalar state, freeing owned memory and taking over another's
+    void copySettings(const Fluid& other);
+    void release();
+    void steal(Fluid& other);
+
+    // vector kernels for the current level, nullptr when the scalar loops should run
+    const SimdKernels* getKernels() const;
+
+    std::vector<Obstacle> obstacles;
+    std::vector<Emitter> emitters;
+    void applyEmitters();
+    // sets count smoke cells from index c on, in the current storage
+    void fillSmoke(int c, int count, float value);
+    // clips [i0, i1) x [j0, j1) to the padded grid, false if nothing is left
+    bool clipRect(int& i0, int& j0, int& i1, int& j1) const;
+    unsigned char* obstacle_cells;  // 1 where a cell is solid because of an obstacle
+
+    bool obstacleContains(const Obstacle& obstacle, int i, int j) const;
+    // cell range [i0, i1] x [j0, j1] an obstacle can cover, clamped to the interior
+    void obstacleBounds(const Obstacle& obstacle, int& i0, int& i1, int& j0, int& j1) const;
+    // re-evaluates the obstacle cells inside a cell range
+    void rasterizeObstacles(int i0, int i1, int j0, int j1);
+
+    // sparse stepping, off while tileSize is 0. a tile is active when one of its cells has a
+    // value above tileThreshold, or when it sits next to an active tile; the rest are skipped
+    // global column of column 0, when this grid is one strip of a larger one
+    int columnOffset;
+
+    int tileSize;
+    int tilesX;
+    int tilesY;
+    float tileThreshold;
+    unsigned char* tile_flow;     // velocity activity, tiles indexed tx * tilesY + ty
+    unsigned char* tile_smoke;    // smoke activity, only used by advectSmoke
+    unsigned char* tile_scratch;  // dilation buffer
+
+    // largest |u| or |v| on the grid
+    float maxVelocity() const;
+    // flags tiles holding a cell whose magnitude(c) is above the threshold
+    template <typename Magnitude>
+    void markTiles(unsigned char* flags, Magnitude magnitude) const;
+    // grows the active set by radius tiles in every direction, returns the active fraction
+    float dilateTiles(unsigned char* flags, int radius);
+    int tileColumns() const;
+    // interior columns [i_begin, i_end) covered by tile column tx
+    void tileColumnRange(int tx, int& i_begin, int& i_end) const;
+    // tile column holding grid column i (walls clamp to the outermost tile)
+    int tileColumn(int i) const;
+    // calls fn(j_begin, j_end) for every vertical run of active tiles in tile column tx.
+    // with tiling off (or flags null) that is the whole interior column
+    void forEachActiveRun(const unsigned char* flags, int tx, const std::function<void(int, int)>& fn) const;
+
+    // adaptive stepping, off while cflNumber is 0
+    float cflNumber;
+    int maxSubsteps;
+    // one gravity / projection / advection step of dt
+    void step(float dt, int tot_iter, float g, PressureSolver solver);
+
+    // null while profiling is off, so a stage only pays for one branch
+    StepProfiler* profiler;
+    // times one stage of step() into the profiler, if there is one. solver is the one the
+    // step runs, which need not be the default
+    class StageTimer {
+    private:
+        Fluid* fluid;
+        StepStage stage;
+        PressureSolver solver;
+        StepProfiler::Clock::time_point start;
+    public:
+        StageTimer(Fluid* fluid, StepStage stage, PressureSolver solver);
+        ~StageTimer();
+    };
+    // cells a stage just updated and the field bytes that took, estimated from the fields it
+    // reads and writes once per cell, for a step that ran solver
+    void stageWork(StepStage stage, PressureSolver solver, long long& cells, long long& bytes) const;
+    // largest |div u| of a fluid cell
+    float maxDivergence() const;
+
+    ThreadPool* getThreadPool();
+    // one SOR update of cell (i,j): removes its divergence and accumulates pressure
+    void relaxCell(int i, int j, float dt);
+    // one column of the Gauss-Seidel sweep / of propagateGravity, active runs only
+    void relaxColumn(int i, float dt);
+    void gravityColumn(int i, float dt, float g);
+
+    // Gauss-Seidel iterations per pass over the columns, plain sweeps below 2
+    int temporalBlocking;
+    // `iterations` Gauss-Seidel sweeps as one wavefront over the columns. first(i) runs right
+    // before column i is relaxed for the first time, last(i) right after its last relaxation
+    void relaxWavefront(float dt, int iterations, const std::function<void(int)>& first,
+                        const std::function<void(int)>& last);
+    // gravity, the pressure reset, the Gauss-Seidel projection and extrapolate, fused into
+    // the wavefront passes
+    void stepFused(float dt, int tot_iter, float g);
+
+    // bilinear sample of a field whose samples sit at (i*h + dx, j*h + dy)
+    float sampleField(const float* f, float x, float y, float dx, float dy) const;
+    // same, fetch(c) returns the field value at index c. With lo / hi given, they receive the
+    // smallest and largest of the four samples it blended
+    template <typename Fetch>
+    float sampleWith(Fetch fetch, float x, float y, float dx, float dy, float* lo = nullptr, float* hi = nullptr) const;
+
+    AdvectionScheme advectionScheme;
+    // float scratch fields of the MacCormack / BFECC passes, allocated on first use
+    FieldArena advect_arena;
+    float* advectScratch(int k);
+    // whether the sample of field at index c moves with the flow (its cells are fluid)
+    bool advectsSample(FieldType field, int c) const;
+    // where the sample of field at (i, j) comes from over dt, through the current velocities
+    void backtrace(FieldType field, int i, int j, float dt, float& x, float& y) const;
+    // f advected into out with the MacCormack / BFECC scheme, clamped to the four samples
+    // of f the plain backtrace blends. Visits the cells of the active runs of flags
+    void advectCorrected(FieldType field, const float* f, float* out, float dt, const unsigned char* flags);
     
 public:
-    Fluid(int width, int height, float gravity, float density, float overrelax);
+    // numThreads <= 0 uses every hardware thread; only the red-black solver is threaded.
+    // hugePages asks for transparent huge pages behind the field arena (Linux only)
+    Fluid(int width, int height, float gravity, float density, float overrelax,
+          PressureSolver solver = PressureSolver::GaussSeidel, int numThreads = 0,
+          bool hugePages = false);
     ~Fluid();
+
+    // copies duplicate the fields, obstacles and settings; the thread pool and the CG
+    // workspace are rebuilt on demand. moves only hand over pointers
+    Fluid(const Fluid& other);
+    Fluid& operator=(const Fluid& other);
+    Fluid(Fluid&& other) noexcept;
+    Fluid& operator=(Fluid&& other) noexcept;
     
     void propagateGravity(float dt, float g);
     void applyIncompressibility(float dt, int tot_iter);
+    void applyIncompressibility(float dt, int tot_iter, PressureSolver solver);
+    void applyIncompressibilityGaussSeidel(float dt, int tot_iter);
+    void applyIncompressibilityRedBlack(float dt, int tot_iter);
+    // the red-black sweep in pieces, for callers that exchange data between colour passes:
+    // prepareRedBlack once per solve (after s changed), then relaxRedBlack for one colour
+    // ((i + j) % 2 == color) over the interior columns [i_begin, i_end)
+    void prepareRedBlack();
+    void relaxRedBlack(float dt, int color, int i_begin, int i_end);
+    // tot_iter is ignored, CG runs until the tolerance or the iteration cap is hit
+    void applyIncompressibilityConjugateGradient(float dt);
     void extrapolate();
-    float interpolateComponent(float x, float y, std::string vec_type);
+    // x is in the coordinates set by setColumnOffset
+    float interpolateComponent(float x, float y, FieldType field) const;
+    // makes this grid the strip of a larger one starting at global column offset: advection
+    // computes its backtraces in the larger grid's coordinates, so positions (and their
+    // rounding) are the same as there
+    void setColumnOffset(int offset);
     void advect(float dt);
     void advectSmoke(float dt);
+    // semi-Lagrangian by default. The other schemes cost three backtraces per sample instead of
+    // one and run the scalar loops; the passive scalars stay semi-Lagrangian
+    void setAdvectionScheme(AdvectionScheme scheme);
+    AdvectionScheme getAdvectionScheme() const;
+    // carries the velocity on particles (FLIP / PIC) instead of advecting it on the grid:
+    // particlesPerCell particles per fluid cell are seeded from the current velocities,
+    // splatted onto the faces at the start of every step and updated from the projected
+    // grid in place of advect. flipRatio 1 is pure FLIP (no numerical dissipation, noisier),
+    // 0 pure PIC (as diffusive as the grid); the particles are sorted by cell every
+    // sortInterval steps. The transfers run on the thread pool. The smoke and scalars stay
+    // on the grid, and the advection scheme then only applies to them. 0 particles turns
+    // it off. Single-domain
+    void setFlip(int particlesPerCell, float flipRatio = 0.95f, int sortInterval = 8);
+    // 0 while off
+    int getParticlesPerCell() const;
+    float getFlipRatio() const;
+    int getParticleCount() const;
+    // nullptr while off
+    const FlipParticles* getParticles() const;
+    // advects every registered scalar in one pass: the backtrace and bilinear weights of a
+    // cell are computed once and applied to all of them. Visits the whole interior
+    void advectScalars(float dt);
+    // one step of dt, or with adaptive stepping on, as many substeps as it takes to cover dt
     void simulate(float dt, int tot_iter, float g);
+    void simulate(float dt, int tot_iter, float g, PressureSolver solver);
+    // with cfl > 0, simulate() splits its dt into substeps that move no face more than cfl
+    // cells, at most maxSubsteps of them (the last one takes what is left). cfl 0 turns it off
+    void setAdaptiveStep(float cfl, int maxSubsteps = 16);
+    float getCflNumber() const;
+    int getMaxSubsteps() const;
+    // per-stage wall time over the last `window` steps (substeps count as steps), cells and
+    // estimated bytes per stage and the divergence the projection left. trace also keeps
+    // every stage run for writeChromeTrace. Off by default; turning it on again starts over
+    void setProfiling(bool enabled, int window = 256, bool trace = false);
+    bool isProfiling() const;
+    // false while profiling is off
+    bool getProfile(FluidProfile& profile) const;
+    // false if profiling or tracing is off or the file could not be written
+    bool writeChromeTrace(const std::string& path) const;
+
+    void setPressureSolver(PressureSolver solver);
+    PressureSolver getPressureSolver() const;
+    void setNumThreads(int numThreads);
+    int getNumThreads();
+    // cache blocking for the Gauss-Seidel solver: depth > 1 runs depth SOR iterations per
+    // pass over the grid, as a wavefront across the columns that only keeps a band of about
+    // 2 * depth columns busy, instead of streaming every field in tot_iter times. simulate()
+    // then also folds gravity and the pressure reset into the first pass and extrapolate into
+    // the last. The results are the same as with the plain sweeps. 0 or 1 turns it off, the
+    // other solvers ignore it
+    void setTemporalBlocking(int depth);
+    int getTemporalBlocking() const;
+    // tolerance is the largest divergence (velocity units) a fluid cell may keep
+    void setSolverTolerance(float tolerance, int maxIter);
+    const FluidStats& getStats() const;
+    // defaults to detectSimdLevel(); returns false if the CPU or build lacks the level
+    bool setSimdLevel(SimdLevel level);
+    SimdLevel getSimdLevel() const;
+    // splits the interior into tileSize x tileSize tiles and skips the quiescent ones in
+    // gravity, the SOR sweeps and both advections. tileSize 0 turns it off, other sizes are
+    // raised to 8 so the vector kernels see whole blocks. CG always solves the whole grid
+    void setTileTracking(int tileSize, float threshold = 1e-4f);
+    int getTileSize() const;
+    // refreshes the velocity activity flags; simulate() calls it at the start of every step
+    void updateActiveTiles();
     
+    // fields are (width + 2) columns of getStride() floats, cell (i, j) at i * stride + j.
+    // advection swaps buffers, so the smoke and velocity pointers are only good until the
+    // next step
     float* getPressureField();
-    float* getSmokeField();
+    // with compact smoke storage this decodes into a float copy, writes to it are not kept
+    const float* getSmokeField();
+    float* getUField();
+    float* getVField();
+    int getStride() const;
+    int getFieldSize() const;
+    // interior cells, as passed to the constructor
+    int getWidth() const;
+    int getHeight() const;
+    bool usesHugePages() const;
+    // bytes held by the field arena and the scalar block
+    size_t getFieldBytes() const;
+    // Float32 by default. The compact storages shrink the smoke field and its back buffer
+    // to 2 or 1 bytes per cell; advection decodes on load and encodes on store. Switching
+    // re-lays out the arena and converts the current smoke
+    void setSmokeStorage(SmokeStorage storage);
+    SmokeStorage getSmokeStorage() const;
+    // keeps the smoke at factor x factor cells per velocity cell: it is advected by sampling
+    // the coarse staggered velocities at every fine cell, so the smoke keeps its detail while
+    // the pressure solve stays on the coarse grid. Fine cells take the solid flag of their
+    // cell. getSmokeField then returns the fine smoke box filtered back to the grid, which
+    // is what the tiles, recordings and the setters work with; writes through the setters
+    // and emitters fill every fine cell of the cell. Switching on copies every cell's smoke
+    // into its fine cells. The fine smoke is float and semi-Lagrangian whatever the smoke
+    // storage and advection scheme, and single-domain. 1 (the default) turns it off
+    void setSmokeResolution(int factor);
+    int getSmokeResolution() const;
+    // the fine smoke, (getWidth() * factor + 2) columns of getFineSmokeStride() floats, fine
+    // cell (i, j) at i * stride + j. The same as getSmokeField / getStride / getFieldSize
+    // with factor 1. Swapped by every step like the other fields
+    const float* getFineSmokeField();
+    int getFineSmokeStride() const;
+    int getFineSmokeSize() const;
+    FieldView<const float> viewFineSmoke();
+    // registers a passive scalar, 0 everywhere, advected like the smoke by simulate().
+    // returns its index; a name that is already registered returns the existing index
+    int addScalar(const std::string& name);
+    // index of a registered scalar, -1 if there is none by that name
+    int findScalar(const std::string& name) const;
+    int getScalarCount() const;
+    const std::string& getScalarName(int k) const;
+    void setScalar(int k, int i, int j, float value);
+    float getScalar(int k, int i, int j) const;
+    // scalar k as a field of getFieldSize() floats, indexed like the other fields
+    void copyScalarField(int k, float* out) const;
+    // the interleaved block, getFieldSize() * getScalarCount() floats; swapped by every step
+    float* getScalarData();
     void setFluid(int i, int j, int value);
+    // setFluid for every cell of [i0, i1) x [j0, j1), clipped to the padded grid
+    void setFluidRect(int i0, int j0, int i1, int j1, int value);
+    // setFluid for every cell whose mask entry is non-zero; mask is indexed like the fields
+    // and may be smaller than the grid
+    void setFluidMask(FieldView<const unsigned char> mask, int value);
+    // sets field (u, v or smoke) to value on [i0, i1) x [j0, j1) / the masked cells
+    void fillRect(FieldType field, int i0, int j0, int i1, int j1, float value);
+    void fillMask(FieldType field, FieldView<const unsigned char> mask, float value);
+    // false for walls and obstacle cells
+    bool isFluid(int i, int j) const;
     void setSmoke(int i, int j, float value);
     void setU(int i, int j, float value);
     void setV(int i, int j, float value);
     void activateFluid();
     void resetPressure();
 
+    // obstacles only touch the cells around them when added, moved or removed.
+    // fluid cells they cover become solid and all four faces take the obstacle velocity;
+    // once uncovered they turn back into fluid. Cells that were already solid (walls) are
+    // left alone, as are cells set through setFluid / setFluidRect since.
+    int addCircleObstacle(float x, float y, float radius);
+    int addBoxObstacle(float x, float y, float halfWidth, float halfHeight);
+    // velocity is the displacement over dt; moving to the same spot brings it to rest
+    void moveObstacle(int id, float x, float y, float dt);
+    void removeObstacle(int id);
+    const Obstacle& getObstacle(int id) const;
+
+    // emitters persist until removed and are applied inside simulate(), see Emitter.
+    // addInflow drives u (the demo's jet through the left wall), addEmitter takes any
+    // combination. Return the emitter id
+    int addInflow(int i0, int j0, int i1, int j1, float u, float smoke);
+    int addOutflow(int i0, int j0, int i1, int j1);
+    int addEmitter(const Emitter& emitter);
+    void removeEmitter(int id);
+    const Emitter& getEmitter(int id) const;
+    int getEmitterCount() const;
+
+    // strided windows onto the padded fields, no copies. They follow the buffer swaps of
+    // advection, so take them again after every step. The smoke view is empty with compact
+    // smoke storage; viewSmokeValues then decodes into a copy like getSmokeField. With smoke
+    // detail on, writes through viewSmoke are lost to the next step's box filter
+    FieldView<float> viewU();
+    FieldView<float> viewV();
+    FieldView<float> viewPressure();
+    FieldView<float> viewSmoke();
+    FieldView<const float> viewU() const;
+    FieldView<const float> viewV() const;
+    FieldView<const float> viewPressure() const;
+    FieldView<const float> viewSmokeValues();
+    // 1 for fluid, 0 for solid; change it through setFluid / setFluidRect / obstacles
+    FieldView<const unsigned char> viewSolid() const;
+
+    // checkpoints hold the fields, obstacles and solver settings in native byte order: a
+    // header padded to 64 KB, then an image of the field arena that loadCheckpoint can map
+    // straight back (copy-on-write) instead of parsing. saveCheckpoint writes path + ".tmp"
+    // and renames it over path, so an existing checkpoint survives a crash mid-write.
+    // step is stored for the caller. The thread count and SIMD level belong to the
+    // machine and are kept; false if the file cannot be written / read or does not match
+    bool saveCheckpoint(const std::string& path, long step = 0) const;
+    bool loadCheckpoint(const std::string& path, long* step = nullptr, bool map = true);
+
 };
 
 #endif // FLUID_H 
\ No newline at end of file
@@ -0,0 +1,531 @@
+#include "Fluid.h"
+#include "FlipSolver.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#define FLUID_HAVE_FSYNC
+#endif
+
+// checkpoint layout, native byte order (the arena image is mapped as is):
+//
+//   header     CheckpointHeader, then obstacleCount obstacle records, then scalarCount
+//              names (uint32 length, bytes), then emitterCount emitter records, zero padded
+//   arena      at arenaOffset, a multiple of CHECKPOINT_ALIGN: the FIELD_COUNT slots laid out
+//              as Fluid::slotOffset does, u, v, s, p, m written (dataBytes), the back
+//              buffers and s_mask left as a hole
+//   scalars    at scalarOffset (aligned), the interleaved passive scalars, scalarBytes
+//   fine smoke at fineOffset (aligned), the front buffer of the smoke detail, fineBytes
+//   particles  at particleOffset (aligned), the FLIP x, y, u, v arrays one after the
+//              other, particleCount floats each
+//   obstacle   at obstacleCellOffset (aligned), one byte per cell of the arena layout, 1
+//   cells      where an obstacle made the cell solid (walls under it stay 0), obstacleCellBytes
+
+namespace {
+
+const char CHECKPOINT_MAGIC[8] = {'F', 'L', 'U', 'I', 'D', 'C', 'K', 'P'};
+// 2: byte solid mask, smoke storage
+// 3: passive scalars
+// 4: adaptive stepping
+// 5: emitters
+// 6: advection scheme
+// 7: smoke detail
+// 8: FLIP particles
+// 9: obstacle cell flags
+const std::uint32_t CHECKPOINT_VERSION = 9;
+const std::uint32_t CHECKPOINT_BYTE_ORDER = 0x01020304;
+// covers 4 KB and 16 KB pages as well as the 64 KB mmap granularity some systems have
+const size_t CHECKPOINT_ALIGN = 64 * 1024;
+// fields with data, the leading slots of the arena
+const int CHECKPOINT_FIELDS = 5;
+
+struct CheckpointHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byteOrder;
+    std::uint32_t width;        // padded, like Fluid::width
+    std::uint32_t height;
+    std::uint32_t stride;
+    std::uint32_t fieldCount;   // arena slots
+    std::uint32_t smokeStorage;
+    std::uint64_t dataBytes;    // slots with data, u to m
+    std::uint64_t arenaOffset;
+    std::uint64_t arenaBytes;
+    float gravity;
+    float density;
+    float overrelax;
+    float h;
+    std::uint32_t pressureSolver;
+    float pcgTolerance;
+    std::uint32_t pcgMaxIter;
+    std::uint32_t tileSize;
+    float tileThreshold;
+    std::uint32_t obstacleCount;
+    std::int64_t step;
+    std::uint32_t scalarCount;
+    std::uint32_t scalarNameBytes;  // the name records after the obstacles
+    std::uint64_t scalarOffset;
+    std::uint64_t scalarBytes;
+    float cflNumber;
+    std::uint32_t maxSubsteps;
+    std::uint32_t emitterCount;   // records after the scalar names
+    std::uint32_t advectionScheme;
+    std::uint32_t smokeFactor;
+    std::uint32_t fineStride;
+    std::uint64_t fineOffset;
+    std::uint64_t fineBytes;    // 0 without smoke detail
+    std::uint32_t particlesPerCell;  // 0 without FLIP
+    float flipRatio;
+    std::uint32_t sortInterval;
+    std::uint32_t stepsSinceSort;
+    std::uint32_t flipRandom;
+    std::uint32_t particleCount;
+    std::uint64_t particleOffset;
+    std::uint64_t obstacleCellOffset;
+    std::uint64_t obstacleCellBytes;  // 0 without obstacles
+};
+
+const size_t OBSTACLE_RECORD_SIZE = 40;
+
+void writeObstacle(const Obstacle& obstacle, char* out) {
+    std::uint32_t shape = static_cast<std::uint32_t>(obstacle.shape);
+    std::uint32_t active = obstacle.active ? 1 : 0;
+    float values[7] = {obstacle.x, obstacle.y, obstacle.radius, obstacle.halfWidth,
+                       obstacle.halfHeight, obstacle.vx, obstacle.vy};
+    std::memcpy(out, &shape, 4);
+    std::memcpy(out + 4, values, sizeof(values));
+    std::memcpy(out + 4 + sizeof(values), &active, 4);
+}
+
+Obstacle readObstacle(const char* in) {
+    std::uint32_t shape;
+    std::uint32_t active;
+    float values[7];
+    std::memcpy(&shape, in, 4);
+    std::memcpy(values, in + 4, sizeof(values));
+    std::memcpy(&active, in + 4 + sizeof(values), 4);
+
+    Obstacle obstacle;
+    obstacle.shape = shape == 0 ? ObstacleShape::Circle : ObstacleShape::Box;
+    obstacle.x = values[0];
+    obstacle.y = values[1];
+    obstacle.radius = values[2];
+    obstacle.halfWidth = values[3];
+    obstacle.halfHeight = values[4];
+    obstacle.vx = values[5];
+    obstacle.vy = values[6];
+    obstacle.active = active != 0;
+    return obstacle;
+}
+
+const size_t EMITTER_RECORD_SIZE = 36;
+
+void writeEmitter(const Emitter& emitter, char* out) {
+    std::uint32_t type = static_cast<std::uint32_t>(emitter.type);
+    std::int32_t rect[4] = {emitter.i0, emitter.j0, emitter.i1, emitter.j1};
+    std::uint32_t flags = (emitter.setsU ? 1 : 0) | (emitter.setsV ? 2 : 0) | (emitter.active ? 4 : 0);
+    float values[3] = {emitter.u, emitter.v, emitter.smoke};
+    std::memcpy(out, &type, 4);
+    std::memcpy(out + 4, rect, sizeof(rect));
+    std::memcpy(out + 20, &flags, 4);
+    std::memcpy(out + 24, values, sizeof(values));
+}
+
+Emitter readEmitter(const char* in) {
+    std::uint32_t type;
+    std::int32_t rect[4];
+    std::uint32_t flags;
+    float values[3];
+    std::memcpy(&type, in, 4);
+    std::memcpy(rect, in + 4, sizeof(rect));
+    std::memcpy(&flags, in + 20, 4);
+    std::memcpy(values, in + 24, sizeof(values));
+
+    Emitter emitter;
+    emitter.type = type == 0 ? EmitterType::Inflow : EmitterType::Outflow;
+    emitter.i0 = rect[0];
+    emitter.j0 = rect[1];
+    emitter.i1 = rect[2];
+    emitter.j1 = rect[3];
+    emitter.setsU = (flags & 1) != 0;
+    emitter.setsV = (flags & 2) != 0;
+    emitter.active = (flags & 4) != 0;
+    emitter.u = values[0];
+    emitter.v = values[1];
+    emitter.smoke = values[2];
+    return emitter;
+}
+
+size_t alignUp(size_t bytes, size_t alignment) {
+    return (bytes + alignment - 1) / alignment * alignment;
+}
+
+// padded fine columns or rows of padded coarse ones, as setSmokeResolution lays them out
+size_t fineCells(size_t cells, std::uint32_t factor) {
+    return (cells - 2) * factor + 2;
+}
+
+}
+
+bool Fluid::saveCheckpoint(const std::string& path, long step) const {
+    size_t obstacleBytes = this->obstacles.size() * OBSTACLE_RECORD_SIZE;
+    std::vector<char> names;
+    for (const std::string& name : this->scalar_names) {
+        std::uint32_t length = static_cast<std::uint32_t>(name.size());
+        const char* bytes = reinterpret_cast<const char*>(&length);
+        names.insert(names.end(), bytes, bytes + 4);
+        names.insert(names.end(), name.begin(), name.end());
+    }
+    size_t emitterBytes = this->emitters.size() * EMITTER_RECORD_SIZE;
+
+    CheckpointHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = CHECKPOINT_VERSION;
+    header.byteOrder = CHECKPOINT_BYTE_ORDER;
+    header.width = static_cast<std::uint32_t>(this->width);
+    header.height = static_cast<std::uint32_t>(this->height);
+    header.stride = static_cast<std::uint32_t>(this->stride);
+    header.fieldCount = Fluid::FIELD_COUNT;
+    header.smokeStorage = static_cast<std::uint32_t>(this->smokeStorage);
+    header.dataBytes = Fluid::slotOffset(CHECKPOINT_FIELDS, this->totCells, this->smokeStorage);
+    header.arenaOffset = alignUp(sizeof(header) + obstacleBytes + names.size() + emitterBytes, CHECKPOINT_ALIGN);
+    header.arenaBytes = Fluid::slotOffset(Fluid::FIELD_COUNT, this->totCells, this->smokeStorage);
+    header.gravity = this->gravity;
+    header.density = this->density;
+    header.overrelax = this->overrelax;
+    header.h = this->h;
+    header.pressureSolver = static_cast<std::uint32_t>(this->pressureSolver);
+    header.pcgTolerance = this->pcgTolerance;
+    header.pcgMaxIter = static_cast<std::uint32_t>(this->pcgMaxIter);
+    header.tileSize = static_cast<std::uint32_t>(this->tileSize);
+    header.tileThreshold = this->tileThreshold;
+    header.obstacleCount = static_cast<std::uint32_t>(this->obstacles.size());
+    header.step = step;
+    header.scalarCount = static_cast<std::uint32_t>(this->scalar_names.size());
+    header.scalarNameBytes = static_cast<std::uint32_t>(names.size());
+    header.scalarOffset = alignUp(header.arenaOffset + header.arenaBytes, CHECKPOINT_ALIGN);
+    header.scalarBytes = static_cast<std::uint64_t>(this->totCells) * header.scalarCount * sizeof(float);
+    header.cflNumber = this->cflNumber;
+    header.maxSubsteps = static_cast<std::uint32_t>(this->maxSubsteps);
+    header.emitterCount = static_cast<std::uint32_t>(this->emitters.size());
+    header.advectionScheme = static_cast<std::uint32_t>(this->advectionScheme);
+    header.smokeFactor = static_cast<std::uint32_t>(this->smokeFactor);
+    header.fineStride = static_cast<std::uint32_t>(this->fineStride);
+    header.fineOffset = alignUp(header.scalarOffset + header.scalarBytes, CHECKPOINT_ALIGN);
+    header.fineBytes = static_cast<std::uint64_t>(this->fineWidth) * this->fineStride * sizeof(float);
+    header.particleOffset = alignUp(header.fineOffset + header.fineBytes, CHECKPOINT_ALIGN);
+    if (this->flip != nullptr) {
+        header.particlesPerCell = static_cast<std::uint32_t>(this->flip->getParticlesPerCell());
+        header.flipRatio = this->flip->getFlipRatio();
+        header.sortInterval = static_cast<std::uint32_t>(this->flip->getSortInterval());
+        header.stepsSinceSort = static_cast<std::uint32_t>(this->flip->getStepsSinceSort());
+        header.flipRandom = this->flip->getRandomState();
+        header.particleCount = static_cast<std::uint32_t>(this->flip->getParticles().size());
+    }
+    header.obstacleCellOffset = alignUp(header.particleOffset + static_cast<std::uint64_t>(header.particleCount) * 4 * sizeof(float),
+                                        CHECKPOINT_ALIGN);
+    header.obstacleCellBytes = this->obstacle_cells != nullptr ? static_cast<std::uint64_t>(this->totCells) : 0;
+
+    std::vector<char> head(header.arenaOffset, 0);
+    std::memcpy(head.data(), &header, sizeof(header));
+    for (size_t k = 0; k < this->obstacles.size(); k++) {
+        writeObstacle(this->obstacles[k], head.data() + sizeof(header) + k * OBSTACLE_RECORD_SIZE);
+    }
+    std::copy(names.begin(), names.end(), head.begin() + sizeof(header) + obstacleBytes);
+    for (size_t k = 0; k < this->emitters.size(); k++) {
+        writeEmitter(this->emitters[k], head.data() + sizeof(header) + obstacleBytes + names.size() + k * EMITTER_RECORD_SIZE);
+    }
+
+    // never write into the live file: a restarted run may have it mapped, and MAP_PRIVATE
+    // pages it has not touched yet would pick up the new contents
+    std::string tmpPath = path + ".tmp";
+    std::FILE* file = std::fopen(tmpPath.c_str(), "wb");
+    if (file == nullptr) {
+        return false;
+    }
+
+    // the front buffers go to their canonical slots, wherever the ping-pong left them
+    const void* fields[CHECKPOINT_FIELDS] = {this->u, this->v, this->s, this->p, this->m};
+    bool ok = std::fwrite(head.data(), 1, head.size(), file) == head.size();
+    for (int f = 0; f < CHECKPOINT_FIELDS && ok; f++) {
+        size_t slot = Fluid::slotOffset(f + 1, this->totCells, this->smokeStorage)
+                    - Fluid::slotOffset(f, this->totCells, this->smokeStorage);
+        ok = std::fwrite(fields[f], 1, slot, file) == slot;
+    }
+    // the remaining slots are zeros, seeking past them leaves a hole on most file systems
+    if (ok && header.scalarBytes > 0) {
+        ok = std::fseek(file, static_cast<long>(header.scalarOffset), SEEK_SET) == 0
+          && std::fwrite(this->scalars, 1, header.scalarBytes, file) == header.scalarBytes;
+    }
+    if (ok && header.fineBytes > 0) {
+        ok = std::fseek(file, static_cast<long>(header.fineOffset), SEEK_SET) == 0
+          && std::fwrite(this->fine_m, 1, header.fineBytes, file) == header.fineBytes;
+    }
+    if (ok && header.particleCount > 0) {
+        const FlipParticles& particles = this->flip->getParticles();
+        const std::vector<float>* arrays[4] = {&particles.x, &particles.y, &particles.u, &particles.v};
+        ok = std::fseek(file, static_cast<long>(header.particleOffset), SEEK_SET) == 0;
+        for (int a = 0; a < 4 && ok; a++) {
+            ok = std::fwrite(arrays[a]->data(), sizeof(float), header.particleCount, file) == header.particleCount;
+        }
+    }
+    if (ok && header.obstacleCellBytes > 0) {
+        ok = std::fseek(file, static_cast<long>(header.obstacleCellOffset), SEEK_SET) == 0
+          && std::fwrite(this->obstacle_cells, 1, header.obstacleCellBytes, file) == header.obstacleCellBytes;
+    } else if (ok && header.scalarBytes == 0 && header.fineBytes == 0 && header.particleCount == 0) {
+        long end = static_cast<long>(header.arenaOffset + header.arenaBytes);
+        ok = std::fseek(file, end - 1, SEEK_SET) == 0 && std::fputc(0, file) != EOF;
+    }
+    ok = std::fflush(file) == 0 && ok;
+#if defined(FLUID_HAVE_FSYNC)
+    // the rename must not reach the disk before the data does
+    ok = ok && fsync(fileno(file)) == 0;
+#endif
+    ok = std::fclose(file) == 0 && ok;
+
+#if !defined(FLUID_HAVE_FSYNC)
+    // rename does not replace an existing file everywhere
+    if (ok) {
+        std::remove(path.c_str());
+    }
+#endif
+    if (!ok || std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool Fluid::loadCheckpoint(const std::string& path, long* step, bool map) {
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+
+    CheckpointHeader header;
+    if (std::fread(&header, 1, sizeof(header), file) != sizeof(header)
+        || std::memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) != 0
+        || header.version != CHECKPOINT_VERSION
+        || header.byteOrder != CHECKPOINT_BYTE_ORDER) {
+        std::fclose(file);
+        return false;
+    }
+
+    // the layout has to be the one this build would allocate for these dimensions
+    size_t stride = header.height < 3 ? 0 : FieldArena::slotSize(header.height * sizeof(float)) / sizeof(float);
+    int totCells = static_cast<int>(header.width * stride);
+    SmokeStorage storage = static_cast<SmokeStorage>(header.smokeStorage);
+    size_t obstacleBytes = static_cast<size_t>(header.obstacleCount) * OBSTACLE_RECORD_SIZE;
+    size_t emitterBytes = static_cast<size_t>(header.emitterCount) * EMITTER_RECORD_SIZE;
+    std::uint64_t scalarBytes = static_cast<std::uint64_t>(totCells) * header.scalarCount * sizeof(float);
+    size_t fineWidth = 0;
+    size_t fineStride = 0;
+    if (header.smokeFactor > 1 && header.width >= 3 && stride != 0) {
+        fineWidth = fineCells(header.width, header.smokeFactor);
+        fineStride = FieldArena::slotSize(fineCells(header.height, header.smokeFactor) * sizeof(float)) / sizeof(float);
+    }
+    std::uint64_t fineBytes = static_cast<std::uint64_t>(fineWidth) * fineStride * sizeof(float);
+    std::uint64_t particleBytes = static_cast<std::uint64_t>(header.particleCount) * 4 * sizeof(float);
+    std::fseek(file, 0, SEEK_END);
+    long fileSize = std::ftell(file);
+    if (header.width < 3 || stride == 0 || header.stride != stride
+        || header.fieldCount != static_cast<std::uint32_t>(Fluid::FIELD_COUNT)
+        || header.smokeStorage > static_cast<std::uint32_t>(SmokeStorage::UNorm8)
+        || header.dataBytes != Fluid::slotOffset(CHECKPOINT_FIELDS, totCells, storage)
+        || header.arenaBytes != Fluid::slotOffset(Fluid::FIELD_COUNT, totCells, storage)
+        || header.arenaOffset % CHECKPOINT_ALIGN != 0
+        || header.arenaOffset < sizeof(header) + obstacleBytes + header.scalarNameBytes + emitterBytes
+        || header.scalarBytes != scalarBytes
+        || header.scalarOffset < header.arenaOffset + header.arenaBytes
+        || header.pressureSolver > static_cast<std::uint32_t>(PressureSolver::ConjugateGradient)
+        || header.advectionScheme > static_cast<std::uint32_t>(AdvectionScheme::Bfecc)
+        || header.smokeFactor < 1 || header.smokeFactor > 64
+        || header.fineStride != fineStride
+        || header.fineBytes != fineBytes
+        || header.fineOffset < header.scalarOffset + header.scalarBytes
+        || fileSize < 0
+        || static_cast<std::uint64_t>(fileSize) < header.arenaOffset + header.arenaBytes
+        || (scalarBytes > 0 && static_cast<std::uint64_t>(fileSize) < header.scalarOffset + scalarBytes)
+        || (fineBytes > 0 && static_cast<std::uint64_t>(fileSize) < header.fineOffset + fineBytes)
+        || header.particleOffset < header.fineOffset + header.fineBytes
+        || (header.particlesPerCell == 0 && header.particleCount > 0)
+        || (header.particlesPerCell > 0 && (header.sortInterval < 1 || !(header.flipRatio >= 0.0f && header.flipRatio <= 1.0f)))
+        || (particleBytes > 0 && static_cast<std::uint64_t>(fileSize) < header.particleOffset + particleBytes)
+        || header.obstacleCellOffset < header.particleOffset + particleBytes
+        || (header.obstacleCellBytes != 0 && header.obstacleCellBytes != static_cast<std::uint64_t>(totCells))
+        || (header.obstacleCellBytes > 0
+            && static_cast<std::uint64_t>(fileSize) < header.obstacleCellOffset + header.obstacleCellBytes)) {
+        std::fclose(file);
+        return false;
+    }
+
+    std::vector<char> records(obstacleBytes + header.scalarNameBytes + emitterBytes);
+    if (std::fseek(file, static_cast<long>(sizeof(header)), SEEK_SET) != 0
+        || std::fread(records.data(), 1, records.size(), file) != records.size()) {
+        std::fclose(file);
+        return false;
+    }
+
+    std::vector<std::string> names;
+    size_t pos = obstacleBytes;
+    for (std::uint32_t k = 0; k < header.scalarCount; k++) {
+        std::uint32_t length = 0;
+        if (pos + 4 > records.size()) {
+            break;
+        }
+        std::memcpy(&length, records.data() + pos, 4);
+        pos += 4;
+        if (length > records.size() - pos) {
+            break;
+        }
+        names.emplace_back(records.data() + pos, length);
+        pos += length;
+    }
+    if (names.size() != header.scalarCount || pos != obstacleBytes + header.scalarNameBytes) {
+        std::fclose(file);
+        return false;
+    }
+
+    // the scalars are read, their back buffer follows the front one in the block
+    FieldArena loaded_scalars;
+    size_t scalar_slot = FieldArena::slotSize(scalarBytes);
+    if (scalarBytes > 0) {
+        loaded_scalars = FieldArena(2 * scalar_slot, false);
+        if (std::fseek(file, static_cast<long>(header.scalarOffset), SEEK_SET) != 0
+            || std::fread(loaded_scalars.get(), 1, scalarBytes, file) != scalarBytes) {
+            std::fclose(file);
+            return false;
+        }
+    }
+
+    // the same for the fine smoke
+    FieldArena loaded_fine;
+    size_t fine_slot = FieldArena::slotSize(fineBytes);
+    if (fineBytes > 0) {
+        loaded_fine = FieldArena(2 * fine_slot, false);
+        if (std::fseek(file, static_cast<long>(header.fineOffset), SEEK_SET) != 0
+            || std::fread(loaded_fine.get(), 1, fineBytes, file) != fineBytes) {
+            std::fclose(file);
+            return false;
+        }
+    }
+
+    FlipParticles particles;
+    if (header.particleCount > 0) {
+        std::vector<float>* arrays[4] = {&particles.x, &particles.y, &particles.u, &particles.v};
+        bool ok = std::fseek(file, static_cast<long>(header.particleOffset), SEEK_SET) == 0;
+        for (int a = 0; a < 4 && ok; a++) {
+            arrays[a]->resize(header.particleCount);
+            ok = std::fread(arrays[a]->data(), sizeof(float), header.particleCount, file) == header.particleCount;
+        }
+        if (!ok) {
+            std::fclose(file);
+            return false;
+        }
+    }
+
+    std::vector<unsigned char> obstacleCells(header.obstacleCellBytes);
+    if (header.obstacleCellBytes > 0
+        && (std::fseek(file, static_cast<long>(header.obstacleCellOffset), SEEK_SET) != 0
+            || std::fread(obstacleCells.data(), 1, obstacleCells.size(), file) != obstacleCells.size())) {
+        std::fclose(file);
+        return false;
+    }
+
+    FieldArena loaded;
+    if (map) {
+        loaded = FieldArena::mapFile(path, header.arenaOffset, header.arenaBytes);
+    }
+    if (loaded.get() == nullptr) {
+        // no mmap here (or it failed): read the slots with data into a fresh arena
+        loaded = FieldArena(header.arenaBytes, false);
+        if (std::fseek(file, static_cast<long>(header.arenaOffset), SEEK_SET) != 0
+            || std::fread(loaded.get(), 1, header.dataBytes, file) != header.dataBytes) {
+            std::fclose(file);
+            return false;
+        }
+    }
+    std::fclose(file);
+
+    // from here on nothing can fail; swap the new state in
+    int numThreads = this->numThreads;
+    SimdLevel simdLevel = this->simdLevel;
+    // profiling belongs to the run, not the file
+    StepProfiler* profiler = this->profiler;
+    this->profiler = nullptr;
+    this->release();
+    this->profiler = profiler;
+
+    this->width = static_cast<int>(header.width);
+    this->height = static_cast<int>(header.height);
+    this->stride = static_cast<int>(header.stride);
+    this->totCells = this->width * this->stride;
+    this->gravity = header.gravity;
+    this->density = header.density;
+    this->overrelax = header.overrelax;
+    this->h = header.h;
+    this->smokeStorage = storage;
+    this->pressureSolver = static_cast<PressureSolver>(header.pressureSolver);
+    this->advectionScheme = static_cast<AdvectionScheme>(header.advectionScheme);
+    this->numThreads = numThreads;
+    this->pcgTolerance = header.pcgTolerance;
+    this->pcgMaxIter = static_cast<int>(header.pcgMaxIter);
+    this->stats = FluidStats();
+    this->simdLevel = simdLevel;
+
+    this->arena = std::move(loaded);
+    this->assignFields(this->arena.get());
+
+    this->scalar_names = std::move(names);
+    this->scalar_arena = std::move(loaded_scalars);
+    if (scalarBytes > 0) {
+        this->scalars = reinterpret_cast<float*>(this->scalar_arena.get());
+        this->temp_scalars = reinterpret_cast<float*>(this->scalar_arena.get() + scalar_slot);
+    }
+
+    this->smokeFactor = static_cast<int>(header.smokeFactor);
+    this->fineWidth = static_cast<int>(fineWidth);
+    this->fineHeight = fineBytes > 0 ? static_cast<int>(fineCells(header.height, header.smokeFactor)) : 0;
+    this->fineStride = static_cast<int>(fineStride);
+    this->fine_arena = std::move(loaded_fine);
+    if (fineBytes > 0) {
+        this->fine_m = reinterpret_cast<float*>(this->fine_arena.get());
+        this->temp_fine_m = reinterpret_cast<float*>(this->fine_arena.get() + fine_slot);
+    }
+
+    // the fields already hold the rasterized obstacles. The ownership flags are saved, since
+    // coverage alone cannot tell the cells an obstacle took from walls it passes over
+    for (size_t k = 0; k < header.obstacleCount; k++) {
+        this->obstacles.push_back(readObstacle(records.data() + k * OBSTACLE_RECORD_SIZE));
+    }
+    if (!this->obstacles.empty() || !obstacleCells.empty()) {
+        this->obstacle_cells = new unsigned char[this->totCells]();
+        std::copy(obstacleCells.begin(), obstacleCells.end(), this->obstacle_cells);
+    }
+
+    size_t emitterPos = obstacleBytes + header.scalarNameBytes;
+    for (size_t k = 0; k < header.emitterCount; k++) {
+        this->emitters.push_back(readEmitter(records.data() + emitterPos + k * EMITTER_RECORD_SIZE));
+    }
+
+    if (header.particlesPerCell > 0) {
+        this->flip = new FlipSolver(this->width, this->height, this->stride, this->h,
+                                    static_cast<int>(header.particlesPerCell), header.flipRatio,
+                                    static_cast<int>(header.sortInterval));
+        this->flip->setState(std::move(particles), static_cast<int>(header.stepsSinceSort), header.flipRandom);
+    }
+
+    this->setTileTracking(static_cast<int>(header.tileSize), header.tileThreshold);
+    this->setAdaptiveStep(header.cflNumber, static_cast<int>(header.maxSubsteps));
+
+    if (step != nullptr) {
+        *step = static_cast<long>(header.step);
+    }
+    return true;
+}
@@ -0,0 +1,443 @@
+#ifndef FLUID_T_H
+#define FLUID_T_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include "FieldArena.h"
+
+// size argument of FluidT that leaves the grid size to the constructor
+const int DYNAMIC_SIZE = 0;
+
+// padded grid dimensions of a FluidT. For a fixed size they are compile-time constants, so
+// every index i * stride + j folds into constant offsets and loop bounds are known.
+// Columns are padded to whole cache lines, like Fluid::getStride()
+template <typename Scalar, int W, int H>
+class FluidGrid {
+public:
+    FluidGrid(int, int) {}
+    constexpr int width() const { return W + 2; }
+    constexpr int height() const { return H + 2; }
+    constexpr int stride() const { return FluidGrid::paddedRows(H + 2); }
+
+    static constexpr int paddedRows(int rows) {
+        return static_cast<int>((rows * sizeof(Scalar) + FieldArena::CACHE_LINE - 1) / FieldArena::CACHE_LINE
+                                * FieldArena::CACHE_LINE / sizeof(Scalar));
+    }
+};
+
+template <typename Scalar>
+class FluidGrid<Scalar, DYNAMIC_SIZE, DYNAMIC_SIZE> {
+private:
+    int columns;
+    int rows;
+    int rowStride;
+
+public:
+    FluidGrid(int width, int height) {
+        this->columns = width + 2;
+        this->rows = height + 2;
+        this->rowStride = FluidGrid<Scalar, 1, 1>::paddedRows(height + 2);
+    }
+    int width() const { return this->columns; }
+    int height() const { return this->rows; }
+    int stride() const { return this->rowStride; }
+};
+
+// storage orders of the FluidT fields. A layout maps cell (i, j) of the padded grid to an
+// element index and walks cell ranges in storage order, handing the stage the indices of
+// the four neighbours so the per-cell code is the same for every layout.
+
+// column after column, cell (i, j) at i * stride + j: Fluid's own layout
+class FlatLayout {
+public:
+    template <typename Grid>
+    static int size(const Grid& grid) {
+        return grid.width() * grid.stride();
+    }
+
+    template <typename Grid>
+    static int index(const Grid& grid, int i, int j) {
+        return i * grid.stride() + j;
+    }
+
+    // index of (i + di, j + dj) for c = index(i, j), di and dj in -1..1
+    template <typename Grid>
+    static int shifted(const Grid& grid, int c, int, int, int di, int dj) {
+        return c + di * grid.stride() + dj;
+    }
+
+    // fn(i, j, c, left, right, down, up) for the cells [i_begin, i_end) x [j_begin, j_end)
+    template <typename Grid, typename Fn>
+    static void forEachCell(const Grid& grid, int i_begin, int i_end, int j_begin, int j_end, Fn fn) {
+        const int stride = grid.stride();
+        for (int i = i_begin; i < i_end; i++) {
+            for (int j = j_begin; j < j_end; j++) {
+                int c = i * stride + j;
+                fn(i, j, c, c - stride, c + stride, c - 1, c + 1);
+            }
+        }
+    }
+};
+
+// T x T tiles, each stored column-major in one contiguous T * T block, the tiles themselves
+// column-major. A stage walks tile by tile, so the neighbours it reads in both directions sit
+// in the same few KB instead of a whole column apart. The grid is padded to whole tiles
+template <int T>
+class TiledLayout {
+    static_assert(T >= 8 && (T & (T - 1)) == 0, "the tile size has to be a power of two of at least 8");
+
+public:
+    template <typename Grid>
+    static int tilesX(const Grid& grid) {
+        return (grid.width() + T - 1) / T;
+    }
+
+    template <typename Grid>
+    static int tilesY(const Grid& grid) {
+        return (grid.height() + T - 1) / T;
+    }
+
+    template <typename Grid>
+    static int size(const Grid& grid) {
+        return TiledLayout::tilesX(grid) * TiledLayout::tilesY(grid) * T * T;
+    }
+
+    // cells are never negative, unsigned makes the divisions shifts and masks
+    template <typename Grid>
+    static int index(const Grid& grid, int i, int j) {
+        unsigned ui = static_cast<unsigned>(i);
+        unsigned uj = static_cast<unsigned>(j);
+        unsigned tiles_y = static_cast<unsigned>(TiledLayout::tilesY(grid));
+        return static_cast<int>(((ui / T) * tiles_y + uj / T) * (T * T) + (ui % T) * T + uj % T);
+    }
+
+    template <typename Grid>
+    static int shifted(const Grid& grid, int c, int i, int j, int di, int dj) {
+        // unsigned: -1 wraps past T as well
+        unsigned li = static_cast<unsigned>(i % T + di);
+        unsigned lj = static_cast<unsigned>(j % T + dj);
+        if (li < T && lj < T) {
+            return c + di * T + dj;
+        }
+        return TiledLayout::index(grid, i + di, j + dj);
+    }
+
+    template <typename Grid, typename Fn>
+    static void forEachCell(const Grid& grid, int i_begin, int i_end, int j_begin, int j_end, Fn fn) {
+        // a step of one tile column / one tile row in the storage
+        const int tile_column = TiledLayout::tilesY(grid) * T * T;
+        const int tile_row = T * T;
+
+        for (int ti = i_begin / T; ti * T < i_end; ti++) {
+            int i0 = std::max(i_begin, ti * T);
+            int i1 = std::min(i_end, ti * T + T);
+            for (int tj = j_begin / T; tj * T < j_end; tj++) {
+                int j0 = std::max(j_begin, tj * T);
+                int j1 = std::min(j_end, tj * T + T);
+                int base = (ti * TiledLayout::tilesY(grid) + tj) * tile_row;
+
+                for (int i = i0; i < i1; i++) {
+                    int li = i - ti * T;
+                    int column = base + li * T;
+                    // the outer columns of a tile have their side neighbours in the next tile
+                    int left = li > 0 ? column - T : column - tile_column + (T - 1) * T;
+                    int right = li < T - 1 ? column + T : column + tile_column - li * T;
+                    for (int j = j0; j < j1; j++) {
+                        int lj = j - tj * T;
+                        int c = column + lj;
+                        int down = lj > 0 ? c - 1 : column - tile_row + T - 1;
+                        int up = lj < T - 1 ? c + 1 : column + tile_row;
+                        fn(i, j, c, left + lj, right + lj, down, up);
+                    }
+                }
+            }
+        }
+    }
+};
+
+// the serial solver as a template: Gauss-Seidel projection, extrapolation and semi-Lagrangian
+// advection of velocity and smoke, step for step the scalar loops of Fluid.cpp.
+//
+// Scalar is float or double (double for validation runs). W and H fix the interior size at
+// compile time; DYNAMIC_SIZE for both takes it from the constructor. Layout is the storage
+// order of the fields, every stage walks the grid in it. FluidT<float> gives the same fields
+// as Fluid with SimdLevel::Scalar and the Gauss-Seidel solver in either layout: a cell only
+// shares faces with its four neighbours, and tile by tile the left and lower ones are still
+// relaxed before it and the right and upper ones after it, as in the column sweep.
+// Fluid stays the full solver (threads, vector kernels, CG, tiles, moving obstacles,
+// checkpoints); FluidT is for hot fixed-size grids, double precision and layouts.
+template <typename Scalar, int W = DYNAMIC_SIZE, int H = DYNAMIC_SIZE, typename Layout = FlatLayout>
+class FluidT {
+    static_assert((W == DYNAMIC_SIZE) == (H == DYNAMIC_SIZE), "fix both grid dimensions or neither");
+
+private:
+    FluidGrid<Scalar, W, H> grid;
+    Scalar gravity;
+    Scalar density;
+    Scalar overrelax;
+    Scalar h;
+
+    FieldArena arena;
+
+    Scalar* u;
+    Scalar* v;
+    unsigned char* s;  // 1 for fluid, 0 for solid
+    Scalar* p;
+    Scalar* m;
+
+    Scalar* temp_u;
+    Scalar* temp_v;
+    Scalar* temp_m;
+
+    // Fluid::sampleField
+    Scalar sampleField(const Scalar* f, Scalar x, Scalar y, Scalar dx, Scalar dy) const {
+        const int width = this->grid.width();
+        const int height = this->grid.height();
+
+        // bounding with ghost cells
+        x = std::max(std::min(x, width * this->h), this->h);
+        y = std::max(std::min(y, height * this->h), this->h);
+
+        int x0 = std::min(static_cast<int>(std::floor((x - dx)/this->h)), width-1);
+        int x1 = std::min(x0 + 1, width-1);
+
+        int y0 = std::min(static_cast<int>(std::floor((y - dy)/this->h)), height-1);
+        int y1 = std::min(y0 + 1, height-1);
+
+        Scalar w_right = ((x - dx) - x0*this->h)/this->h;
+        Scalar w_up = ((y - dy) - y0*this->h)/this->h;
+
+        Scalar w_left = 1-w_right;
+        Scalar w_down = 1-w_up;
+
+        // x1 - x0 and y1 - y0 are 0 at the clamped edges
+        int c00 = this->index(x0, y0);
+        int c10 = Layout::shifted(this->grid, c00, x0, y0, x1 - x0, 0);
+        int c11 = Layout::shifted(this->grid, c00, x0, y0, x1 - x0, y1 - y0);
+        int c01 = Layout::shifted(this->grid, c00, x0, y0, 0, y1 - y0);
+        return w_left * w_down * f[c00] + w_right * w_down * f[c10] + w_right * w_up * f[c11] + w_left * w_up * f[c01];
+    }
+
+public:
+    // width / height are the interior cells; for a fixed size they have to be W and H
+    FluidT(int width, int height, Scalar gravity, Scalar density, Scalar overrelax)
+        : grid(width, height) {
+        this->gravity = gravity;
+        this->density = density;
+        this->overrelax = overrelax;
+        this->h = 1;
+
+        // zeroed: every cell solid, all fields 0, same as Fluid
+        int tot_cells = this->getFieldSize();
+        size_t field = FieldArena::slotSize(tot_cells * sizeof(Scalar));
+        size_t mask = FieldArena::slotSize(tot_cells);
+        this->arena = FieldArena(7 * field + mask, false);
+        char* base = this->arena.get();
+        this->u = reinterpret_cast<Scalar*>(base + 0 * field);
+        this->v = reinterpret_cast<Scalar*>(base + 1 * field);
+        this->p = reinterpret_cast<Scalar*>(base + 2 * field);
+        this->m = reinterpret_cast<Scalar*>(base + 3 * field);
+        this->temp_u = reinterpret_cast<Scalar*>(base + 4 * field);
+        this->temp_v = reinterpret_cast<Scalar*>(base + 5 * field);
+        this->temp_m = reinterpret_cast<Scalar*>(base + 6 * field);
+        this->s = reinterpret_cast<unsigned char*>(base + 7 * field);
+    }
+
+    FluidT(const FluidT&) = delete;
+    FluidT& operator=(const FluidT&) = delete;
+
+    void propagateGravity(Scalar dt, Scalar g) {
+        Scalar* v = this->v;
+        const unsigned char* s = this->s;
+
+        Layout::forEachCell(this->grid, 1, this->grid.width(), 1, this->grid.height() - 1,
+                            [=](int, int, int c, int, int, int down, int) {
+            if (s[c] != 0 && s[down] != 0){
+                v[c] -= g * dt;
+            }
+        });
+    }
+
+    void applyIncompressibility(Scalar dt, int tot_iter) {
+        // the fields never overlap; saying so lets the compiler keep v[j + 1] in a register
+        // for the next cell instead of reloading it after every store to u and p
+        Scalar* __restrict u = this->u;
+        Scalar* __restrict v = this->v;
+        Scalar* __restrict p_field = this->p;
+        const unsigned char* __restrict s = this->s;
+        const Scalar overrelax = this->overrelax;
+        const Scalar density = this->density;
+        const Scalar h = this->h;
+
+        for(int iter = 0;iter<tot_iter;iter++){
+            Layout::forEachCell(this->grid, 1, this->grid.width() - 1, 1, this->grid.height() - 1,
+                                [=](int, int, int c, int left, int right, int down, int up) {
+                Scalar cur_s = s[c];
+                if(cur_s == 0){
+                    return;
+                }
+                Scalar s_left = s[left];
+                Scalar s_right = s[right];
+                Scalar s_up = s[up];
+                Scalar s_down = s[down];
+
+                Scalar s_factor = s_left + s_right + s_up + s_down;
+                if(s_factor == 0){
+                    return;
+                }
+
+                Scalar d = u[right] - u[c] + v[up] - v[c];
+                // s_factor is 1 to 4 and mostly 4; a power of two reciprocal gives exactly
+                // the quotient, which takes the divide off the chain from cell to cell
+                Scalar p = s_factor == 3 ? -d / s_factor : -d * (s_factor == 4 ? Scalar(0.25) : s_factor == 2 ? Scalar(0.5) : Scalar(1));
+
+                u[c] -= p * s_left * overrelax;
+                u[right] += p * s_right * overrelax;
+                v[c] -= p * s_down * overrelax;
+                v[up] += p * s_up * overrelax;
+
+                p_field[c] += p * overrelax*density*h/dt;
+            });
+        }
+    }
+
+    void extrapolate() {
+        const int width = this->grid.width();
+        const int height = this->grid.height();
+
+        for (int i = 0; i < width; i++) {
+            this->u[this->index(i, 0)] = this->u[this->index(i, 1)];
+            this->u[this->index(i, height - 1)] = this->u[this->index(i, height - 2)];
+        }
+        for (int j = 0; j < height; j++) {
+            this->v[this->index(0, j)] = this->v[this->index(1, j)];
+            this->v[this->index(width - 1, j)] = this->v[this->index(width - 2, j)];
+        }
+    }
+
+    void advect(Scalar dt) {
+        const int tot_cells = this->getFieldSize();
+        const Scalar h = this->h;
+        Scalar half_cell = this->h/2;
+
+        // faces that are not advected keep their value
+        std::copy(this->u, this->u + tot_cells, this->temp_u);
+        std::copy(this->v, this->v + tot_cells, this->temp_v);
+
+        const Scalar* u = this->u;
+        const Scalar* v = this->v;
+        const unsigned char* s = this->s;
+        Layout::forEachCell(this->grid, 1, this->grid.width() - 1, 1, this->grid.height() - 1,
+                            [&](int i, int j, int c, int left, int right, int down, int up) {
+            if(s[c] != 0 && s[left] != 0){
+                Scalar x = i * h;
+                Scalar y = j * h + half_cell;
+                Scalar cur_u = u[c];
+                Scalar cur_v = (v[c] + v[left]+v[up] + v[Layout::shifted(this->grid, c, i, j, -1, 1)]) / 4;
+                x -= dt * cur_u;
+                y -= dt * cur_v;
+                this->temp_u[c] = this->sampleField(u, x, y, 0, half_cell);
+            }
+            if(s[c] != 0 && s[down] != 0){
+                Scalar x = i * h + half_cell;
+                Scalar y = j * h;
+                Scalar cur_v = v[c];
+                Scalar cur_u = (u[down] + u[c] + u[Layout::shifted(this->grid, c, i, j, 1, -1)] + u[right])/4;
+                x -= dt * cur_u;
+                y -= dt * cur_v;
+                this->temp_v[c] = this->sampleField(v, x, y, half_cell, 0);
+            }
+        });
+
+        std::swap(this->u, this->temp_u);
+        std::swap(this->v, this->temp_v);
+    }
+
+    void advectSmoke(Scalar dt) {
+        const Scalar h = this->h;
+        Scalar h2 = Scalar(0.5) * this->h;
+        Scalar half_cell = this->h/2;
+
+        std::copy(this->m, this->m + this->getFieldSize(), this->temp_m);
+
+        const Scalar* u_field = this->u;
+        const Scalar* v_field = this->v;
+        const unsigned char* s = this->s;
+        Layout::forEachCell(this->grid, 1, this->grid.width() - 1, 1, this->grid.height() - 1,
+                            [&](int i, int j, int c, int, int right, int, int up) {
+            if (s[c] != 0) {
+                Scalar u = (u_field[c] + u_field[right]) * Scalar(0.5);
+                Scalar v = (v_field[c] + v_field[up]) * Scalar(0.5);
+                Scalar x = i * h + h2 - dt * u;
+                Scalar y = j * h + h2 - dt * v;
+                this->temp_m[c] = this->sampleField(this->m, x, y, half_cell, half_cell);
+            }
+        });
+
+        std::swap(this->m, this->temp_m);
+    }
+
+    void resetPressure() {
+        std::fill(this->p, this->p + this->getFieldSize(), Scalar(0));
+    }
+
+    void simulate(Scalar dt, int tot_iter, Scalar g) {
+        this->propagateGravity(dt, g);
+        this->resetPressure();
+        this->applyIncompressibility(dt, tot_iter);
+        this->extrapolate();
+        this->advect(dt);
+        this->advectSmoke(dt);
+    }
+
+    // same conventions as Fluid
+    void setFluid(int i, int j, int value) {
+        int c = this->index(i, j);
+        this->s[c] = value != 0 ? 1 : 0;
+        if (value == 0) {
+            this->u[c] = 0;
+            this->v[c] = 0;
+            this->m[c] = 0;
+        }
+    }
+    void setSmoke(int i, int j, Scalar value) { this->m[this->index(i, j)] = value; }
+    void setU(int i, int j, Scalar value) { this->u[this->index(i, j)] = value; }
+    void setV(int i, int j, Scalar value) { this->v[this->index(i, j)] = value; }
+
+    // a circle that never moves: the covered cells become solid with resting faces, the
+    // same cells Fluid::addCircleObstacle claims. Returns 0, there is no obstacle registry
+    int addCircleObstacle(float x, float y, float radius) {
+        for (int i = 1; i < this->grid.width() - 1; i++) {
+            for (int j = 1; j < this->grid.height() - 1; j++) {
+                float dx = (i - 0.5f) - x;
+                float dy = (j - 0.5f) - y;
+                if (dx*dx + dy*dy > radius * radius) {
+                    continue;
+                }
+                int c = this->index(i, j);
+                this->s[c] = 0;
+                this->u[c] = 0;
+                this->u[this->index(i + 1, j)] = 0;
+                this->v[c] = 0;
+                this->v[this->index(i, j + 1)] = 0;
+                this->m[c] = 0;
+            }
+        }
+        return 0;
+    }
+
+    // fields hold getFieldSize() values in Layout order, cell (i, j) of the padded grid at
+    // index(i, j). With FlatLayout that is i * getStride() + j, like Fluid
+    Scalar* getPressureField() { return this->p; }
+    Scalar* getSmokeField() { return this->m; }
+    Scalar* getUField() { return this->u; }
+    Scalar* getVField() { return this->v; }
+    int index(int i, int j) const { return Layout::index(this->grid, i, j); }
+    int getStride() const { return this->grid.stride(); }
+    int getFieldSize() const { return Layout::size(this->grid); }
+    int getWidth() const { return this->grid.width() - 2; }
+    int getHeight() const { return this->grid.height() - 2; }
+};
+
+#endif // FLUID_T_H
@@ -0,0 +1,189 @@
+#include "FrameRecorder.h"
+#include <algorithm>
+
+FrameRecorder::FrameRecorder(int width, int height, const RecorderOptions& options)
+    : written(0), dropped(0) {
+    this->width = width;
+    this->height = height;
+    this->options = options;
+    this->options.every = std::max(options.every, 1);
+    this->options.bufferCount = std::max(options.bufferCount, 1);
+    this->frameValues = static_cast<size_t>(recordFieldCount(options.fieldMask)) * (width + 2) * (height + 2);
+
+    this->file = nullptr;
+    this->writeOffset = 0;
+    this->failed = false;
+    this->stopping = false;
+}
+
+FrameRecorder::~FrameRecorder() {
+    this->close();
+}
+
+bool FrameRecorder::open(const std::string& path) {
+    if (this->file != nullptr) {
+        return false;
+    }
+    this->file = std::fopen(path.c_str(), "wb");
+    if (this->file == nullptr) {
+        return false;
+    }
+
+    // placeholder header, frame count and index offset are filled in by close()
+    RecordingHeader header;
+    header.width = static_cast<std::uint32_t>(this->width);
+    header.height = static_cast<std::uint32_t>(this->height);
+    header.fieldMask = this->options.fieldMask;
+    header.compression = this->options.compression;
+    header.every = static_cast<std::uint32_t>(this->options.every);
+    std::uint8_t bytes[RECORDING_HEADER_SIZE];
+    writeRecordingHeader(header, bytes);
+    this->failed = std::fwrite(bytes, 1, sizeof(bytes), this->file) != sizeof(bytes);
+    this->writeOffset = RECORDING_HEADER_SIZE;
+    this->index.clear();
+
+    // all buffers are allocated up front, recording never allocates on the solver thread
+    this->frames.assign(this->options.bufferCount, Frame());
+    this->freeFrames.clear();
+    this->queuedFrames.clear();
+    for (int k = 0; k < this->options.bufferCount; k++) {
+        this->frames[k].values.resize(this->frameValues);
+        this->freeFrames.push_back(k);
+    }
+
+    this->stopping = false;
+    this->writer = std::thread(&FrameRecorder::writerLoop, this);
+    return true;
+}
+
+bool FrameRecorder::record(Fluid& fluid, long step, float time) {
+    if (this->file == nullptr || step % this->options.every != 0) {
+        return false;
+    }
+
+    int slot;
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        if (this->freeFrames.empty()) {
+            this->dropped++;
+            return false;
+        }
+        slot = this->freeFrames.back();
+        this->freeFrames.pop_back();
+    }
+
+    // pack the recorded fields without the stride padding
+    Frame& frame = this->frames[slot];
+    frame.step = step;
+    frame.time = time;
+    const float* fields[4] = {fluid.getUField(), fluid.getVField(), fluid.getPressureField(), fluid.getSmokeField()};
+    int stride = fluid.getStride();
+    int columns = this->width + 2;
+    int rows = this->height + 2;
+    float* out = frame.values.data();
+    for (int f = 0; f < 4; f++) {
+        if ((this->options.fieldMask & (1u << f)) == 0) {
+            continue;
+        }
+        for (int i = 0; i < columns; i++) {
+            std::copy(fields[f] + i * stride, fields[f] + i * stride + rows, out);
+            out += rows;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->queuedFrames.push_back(slot);
+    }
+    this->wake.notify_one();
+    return true;
+}
+
+void FrameRecorder::writerLoop() {
+    while (true) {
+        int slot;
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->wake.wait(lock, [this] { return this->stopping || !this->queuedFrames.empty(); });
+            if (this->queuedFrames.empty()) {
+                return;  // stopping and drained
+            }
+            slot = this->queuedFrames.front();
+            this->queuedFrames.pop_front();
+        }
+
+        this->writeFrame(this->frames[slot]);
+
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->freeFrames.push_back(slot);
+    }
+}
+
+void FrameRecorder::writeFrame(const Frame& frame) {
+    encodeFrame(frame.values.data(), frame.values.size(), this->options.compression, this->encoded, this->scratch);
+
+    if (std::fwrite(this->encoded.data(), 1, this->encoded.size(), this->file) != this->encoded.size()) {
+        this->failed = true;
+        return;
+    }
+
+    RecordingIndexEntry entry;
+    entry.offset = this->writeOffset;
+    entry.size = this->encoded.size();
+    entry.step = frame.step;
+    entry.time = frame.time;
+    this->index.push_back(entry);
+    this->writeOffset += this->encoded.size();
+    this->written++;
+}
+
+bool FrameRecorder::close() {
+    if (this->file == nullptr) {
+        return !this->failed;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->wake.notify_one();
+    this->writer.join();
+
+    // index after the last chunk, then the real header over the placeholder
+    std::vector<std::uint8_t> bytes(this->index.size() * RECORDING_INDEX_ENTRY_SIZE);
+    for (size_t k = 0; k < this->index.size(); k++) {
+        writeIndexEntry(this->index[k], bytes.data() + k * RECORDING_INDEX_ENTRY_SIZE);
+    }
+    if (std::fwrite(bytes.data(), 1, bytes.size(), this->file) != bytes.size()) {
+        this->failed = true;
+    }
+
+    RecordingHeader header;
+    header.width = static_cast<std::uint32_t>(this->width);
+    header.height = static_cast<std::uint32_t>(this->height);
+    header.fieldMask = this->options.fieldMask;
+    header.compression = this->options.compression;
+    header.every = static_cast<std::uint32_t>(this->options.every);
+    header.frameCount = this->index.size();
+    header.indexOffset = this->writeOffset;
+    std::uint8_t headerBytes[RECORDING_HEADER_SIZE];
+    writeRecordingHeader(header, headerBytes);
+    if (std::fseek(this->file, 0, SEEK_SET) != 0
+        || std::fwrite(headerBytes, 1, sizeof(headerBytes), this->file) != sizeof(headerBytes)) {
+        this->failed = true;
+    }
+
+    if (std::fclose(this->file) != 0) {
+        this->failed = true;
+    }
+    this->file = nullptr;
+    return !this->failed;
+}
+
+long FrameRecorder::framesWritten() const {
+    return this->written;
+}
+
+long FrameRecorder::framesDropped() const {
+    return this->dropped;
+}
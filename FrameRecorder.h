@@ -0,0 +1,81 @@
+#ifndef FRAME_RECORDER_H
+#define FRAME_RECORDER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Fluid.h"
+#include "RecordingFormat.h"
+
+struct RecorderOptions {
+    int every = 1;                                        // record every Nth step
+    RecordCompression compression = RecordCompression::None;
+    std::uint32_t fieldMask = RECORD_ALL;                 // RecordField bits
+    int bufferCount = 4;                                  // frames that may wait for the writer
+};
+
+// streams Fluid fields into a recording file (RecordingFormat.h). record() only copies the
+// fields into a recycled buffer; encoding and disk writes run on a background thread. When
+// every buffer is still waiting for the writer the frame is dropped, the solver never waits.
+class FrameRecorder {
+private:
+    struct Frame {
+        long step = 0;
+        float time = 0.0f;
+        std::vector<float> values;
+    };
+
+    int width;   // interior cells
+    int height;
+    RecorderOptions options;
+    size_t frameValues;  // floats per frame, all recorded fields
+
+    std::FILE* file;
+    std::uint64_t writeOffset;  // writer thread only while it runs
+    bool failed;
+    std::vector<RecordingIndexEntry> index;
+
+    std::vector<Frame> frames;  // fixed pool, never reallocated while recording
+    std::vector<int> freeFrames;
+    std::deque<int> queuedFrames;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::thread writer;
+    bool stopping;
+
+    std::atomic<long> written;
+    std::atomic<long> dropped;
+
+    // encoder buffers, writer thread only
+    std::vector<std::uint8_t> encoded;
+    std::vector<std::uint8_t> scratch;
+
+    void writerLoop();
+    void writeFrame(const Frame& frame);
+
+public:
+    FrameRecorder(int width, int height, const RecorderOptions& options = RecorderOptions());
+    ~FrameRecorder();
+
+    FrameRecorder(const FrameRecorder&) = delete;
+    FrameRecorder& operator=(const FrameRecorder&) = delete;
+
+    // creates the file and starts the writer thread
+    bool open(const std::string& path);
+    // captures the fields if step is a multiple of `every`. Returns true if the frame was
+    // queued, false if it was not due or had to be dropped
+    bool record(Fluid& fluid, long step, float time);
+    // drains the queue, appends the frame index and finalizes the header. Returns false if
+    // any write failed. Called by the destructor if still open
+    bool close();
+
+    long framesWritten() const;
+    long framesDropped() const;
+};
+
+#endif // FRAME_RECORDER_H
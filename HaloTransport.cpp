@@ -0,0 +1,117 @@
+#include "HaloTransport.h"
+#include <atomic>
+#include <cstring>
+#include <new>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#define FLUID_HAVE_MMAP
+#endif
+
+namespace {
+
+typedef std::atomic<unsigned long long> Sequence;
+
+// the counters live in memory other processes map, they must not hide a lock
+static_assert(Sequence::is_always_lock_free, "halo sequence counters need lock-free 64-bit atomics");
+
+const size_t LINE = 64;
+
+size_t roundUp(size_t bytes) {
+    return (bytes + LINE - 1) / LINE * LINE;
+}
+
+// outbox sides
+const int LEFT = 0;
+const int RIGHT = 1;
+
+}
+
+SharedMemoryTransport::SharedMemoryTransport(int ranks, size_t capacity) {
+    this->numRanks = ranks;
+    this->bytes = roundUp(capacity);
+    // sequence on its own line, then [side][parity] outboxes
+    this->rankBytes = LINE + 4 * this->bytes;
+    this->regionBytes = this->rankBytes * ranks;
+
+    this->region = nullptr;
+    this->mapped = false;
+#if defined(FLUID_HAVE_MMAP)
+    void* address = mmap(nullptr, this->regionBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (address != MAP_FAILED) {
+        this->region = static_cast<char*>(address);
+        this->mapped = true;
+    }
+#endif
+    if (this->region == nullptr) {
+        // no shared mappings here: ranks can still be threads
+        this->region = static_cast<char*>(::operator new(this->regionBytes, std::align_val_t(LINE)));
+    }
+    std::memset(this->region, 0, this->regionBytes);
+
+    for (int rank = 0; rank < ranks; rank++) {
+        new (this->rankBase(rank)) Sequence(0);
+    }
+}
+
+SharedMemoryTransport::~SharedMemoryTransport() {
+#if defined(FLUID_HAVE_MMAP)
+    if (this->mapped) {
+        munmap(this->region, this->regionBytes);
+        return;
+    }
+#endif
+    ::operator delete(this->region, std::align_val_t(LINE));
+}
+
+int SharedMemoryTransport::ranks() const {
+    return this->numRanks;
+}
+
+size_t SharedMemoryTransport::capacity() const {
+    return this->bytes;
+}
+
+char* SharedMemoryTransport::rankBase(int rank) const {
+    return this->region + rank * this->rankBytes;
+}
+
+char* SharedMemoryTransport::outbox(int rank, int side, unsigned long long sequence) const {
+    return this->rankBase(rank) + LINE + (side * 2 + (sequence & 1)) * this->bytes;
+}
+
+void SharedMemoryTransport::exchange(int rank, const void* toLeft, const void* toRight,
+                                     void* fromLeft, void* fromRight, size_t bytes) {
+    Sequence* own = reinterpret_cast<Sequence*>(this->rankBase(rank));
+    // only this rank writes its counter
+    unsigned long long sequence = own->load(std::memory_order_relaxed) + 1;
+
+    // outboxes alternate between exchanges. A neighbour can only start exchange n + 2 after
+    // this rank published n + 1, which it does after it finished reading the neighbour's
+    // n, so the outbox written here is never one still being read
+    bool hasLeft = rank > 0;
+    bool hasRight = rank + 1 < this->numRanks;
+    if (hasLeft) {
+        std::memcpy(this->outbox(rank, LEFT, sequence), toLeft, bytes);
+    }
+    if (hasRight) {
+        std::memcpy(this->outbox(rank, RIGHT, sequence), toRight, bytes);
+    }
+    own->store(sequence, std::memory_order_release);
+
+    auto wait = [&](int neighbour) {
+        Sequence* theirs = reinterpret_cast<Sequence*>(this->rankBase(neighbour));
+        while (theirs->load(std::memory_order_acquire) < sequence) {
+            std::this_thread::yield();
+        }
+    };
+    if (hasLeft) {
+        wait(rank - 1);
+        std::memcpy(fromLeft, this->outbox(rank - 1, RIGHT, sequence), bytes);
+    }
+    if (hasRight) {
+        wait(rank + 1);
+        std::memcpy(fromRight, this->outbox(rank + 1, LEFT, sequence), bytes);
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef HALO_TRANSPORT_H
+#define HALO_TRANSPORT_H
+
+#include <cstddef>
+
+// moves halo data between the subdomains of a DecomposedFluid. Subdomains are strips of
+// columns ranked left to right, so every exchange is with rank - 1 and rank + 1 only.
+// A message-passing backend maps exchange onto a pair of send / receives.
+class HaloTransport {
+public:
+    virtual ~HaloTransport() {}
+
+    virtual int ranks() const = 0;
+    // largest message, in bytes
+    virtual size_t capacity() const = 0;
+
+    // sends toLeft to rank - 1 and toRight to rank + 1 and receives what they sent this
+    // rank into fromLeft / fromRight, blocking until both have arrived. Every rank calls
+    // exchange the same number of times with the same bytes; the buffers of a missing
+    // neighbour (first and last rank) are not touched
+    virtual void exchange(int rank, const void* toLeft, const void* toRight,
+                          void* fromLeft, void* fromRight, size_t bytes) = 0;
+};
+
+// exchange through one shared mapping. Every rank has two double-buffered outboxes (one
+// per side) and a sequence number; exchange writes the outboxes, publishes the sequence
+// and waits for the neighbours' to catch up before copying their outboxes. The mapping is
+// MAP_SHARED and the counters are lock-free atomics, so ranks may be threads or processes
+// forked after the transport was created.
+class SharedMemoryTransport : public HaloTransport {
+private:
+    int numRanks;
+    size_t bytes;     // capacity of one outbox
+    size_t rankBytes; // counters and outboxes of one rank
+    char* region;
+    size_t regionBytes;
+    bool mapped;      // region is a shared mapping, not heap memory
+
+    char* rankBase(int rank) const;
+    char* outbox(int rank, int side, unsigned long long sequence) const;
+
+public:
+    SharedMemoryTransport(int ranks, size_t capacity);
+    ~SharedMemoryTransport() override;
+
+    SharedMemoryTransport(const SharedMemoryTransport&) = delete;
+    SharedMemoryTransport& operator=(const SharedMemoryTransport&) = delete;
+
+    int ranks() const override;
+    size_t capacity() const override;
+    void exchange(int rank, const void* toLeft, const void* toRight,
+                  void* fromLeft, void* fromRight, size_t bytes) override;
+};
+
+#endif // HALO_TRANSPORT_H
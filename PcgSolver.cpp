@@ -0,0 +1,270 @@
+#include "PcgSolver.h"
+#include <algorithm>
+#include <cmath>
+
+PcgSolver::PcgSolver(int width, int height, int stride) {
+    // dimensions include the ghost border, same as Fluid
+    this->width = width;
+    this->height = height;
+    this->stride = stride;
+    this->totCells = width * stride;
+
+    this->diag = new float[this->totCells];
+    this->precon = new float[this->totCells];
+    this->r = new float[this->totCells];
+    this->z = new float[this->totCells];
+    this->dir = new float[this->totCells];
+    this->q = new float[this->totCells];
+
+    for (int i = 0; i < this->totCells; i++) {
+        this->diag[i] = 0.0f;
+        this->precon[i] = 0.0f;
+        this->r[i] = 0.0f;
+        this->z[i] = 0.0f;
+        this->dir[i] = 0.0f;
+        this->q[i] = 0.0f;
+    }
+}
+
+PcgSolver::~PcgSolver() {
+    delete[] this->diag;
+    delete[] this->precon;
+    delete[] this->r;
+    delete[] this->z;
+    delete[] this->dir;
+    delete[] this->q;
+}
+
+void PcgSolver::buildMatrix(const unsigned char* s) {
+    int stride = this->stride;
+
+    for (int i = 0; i < this->totCells; i++) {
+        this->diag[i] = 0.0f;
+    }
+
+    for (int i = 1; i < this->width - 1; i++) {
+        for (int j = 1; j < this->height - 1; j++) {
+            if (s[i * stride + j] != 0) {
+                // every open face counts, including faces to fluid border cells (x = 0 there)
+                int s_factor = (s[(i-1) * stride + j] != 0) + (s[(i+1) * stride + j] != 0)
+                             + (s[i * stride + j-1] != 0) + (s[i * stride + j+1] != 0);
+                this->diag[i * stride + j] = static_cast<float>(s_factor);
+            }
+        }
+    }
+}
+
+void PcgSolver::buildPreconditioner() {
+    int stride = this->stride;
+    const float tau = 0.97f;   // modified incomplete Cholesky blend
+    const float sigma = 0.25f; // safety against tiny pivots
+
+    for (int i = 1; i < this->width - 1; i++) {
+        for (int j = 1; j < this->height - 1; j++) {
+            int c = i * stride + j;
+            if (this->diag[c] == 0.0f) {
+                this->precon[c] = 0.0f;
+                continue;
+            }
+
+            // off-diagonals are -1 between two unknowns, 0 otherwise
+            float a_left = this->diag[c - stride] != 0.0f ? -1.0f : 0.0f;
+            float a_down = this->diag[c - 1] != 0.0f ? -1.0f : 0.0f;
+            // A(i-1,j)->(i-1,j+1) and A(i,j-1)->(i+1,j-1) for the modified term
+            float a_left_up = (a_left != 0.0f && this->diag[c - stride + 1] != 0.0f) ? -1.0f : 0.0f;
+            float a_down_right = (a_down != 0.0f && this->diag[c + stride - 1] != 0.0f) ? -1.0f : 0.0f;
+
+            float pl = this->precon[c - stride];
+            float pd = this->precon[c - 1];
+
+            float e = this->diag[c]
+                    - (a_left * pl) * (a_left * pl)
+                    - (a_down * pd) * (a_down * pd)
+                    - tau * (a_left * a_left_up * pl * pl + a_down * a_down_right * pd * pd);
+
+            if (e < sigma * this->diag[c]) {
+                e = this->diag[c];
+            }
+            this->precon[c] = 1.0f / std::sqrt(e);
+        }
+    }
+}
+
+void PcgSolver::applyA(const float* in, float* out) const {
+    int stride = this->stride;
+
+    for (int i = 1; i < this->width - 1; i++) {
+        for (int j = 1; j < this->height - 1; j++) {
+            int c = i * stride + j;
+            if (this->diag[c] == 0.0f) {
+                out[c] = 0.0f;
+                continue;
+            }
+
+            float sum = this->diag[c] * in[c];
+            if (this->diag[c - stride] != 0.0f) sum -= in[c - stride];
+            if (this->diag[c + stride] != 0.0f) sum -= in[c + stride];
+            if (this->diag[c - 1] != 0.0f) sum -= in[c - 1];
+            if (this->diag[c + 1] != 0.0f) sum -= in[c + 1];
+            out[c] = sum;
+        }
+    }
+}
+
+void PcgSolver::applyPreconditioner(const float* in, float* out) const {
+    int stride = this->stride;
+
+    // forward solve L t = in, t kept in out
+    for (int i = 1; i < this->width - 1; i++) {
+        for (int j = 1; j < this->height - 1; j++) {
+            int c = i * stride + j;
+            if (this->diag[c] == 0.0f) {
+                out[c] = 0.0f;
+                continue;
+            }
+
+            float t = in[c];
+            if (this->diag[c - stride] != 0.0f) t += this->precon[c - stride] * out[c - stride];
+            if (this->diag[c - 1] != 0.0f) t += this->precon[c - 1] * out[c - 1];
+            out[c] = t * this->precon[c];
+        }
+    }
+
+    // backward solve L^T out = t
+    for (int i = this->width - 2; i >= 1; i--) {
+        for (int j = this->height - 2; j >= 1; j--) {
+            int c = i * stride + j;
+            if (this->diag[c] == 0.0f) {
+                continue;
+            }
+
+            float t = out[c];
+            if (this->diag[c + stride] != 0.0f) t += this->precon[c] * out[c + stride];
+            if (this->diag[c + 1] != 0.0f) t += this->precon[c] * out[c + 1];
+            out[c] = t * this->precon[c];
+        }
+    }
+}
+
+double PcgSolver::dot(const float* a, const float* b) const {
+    double sum = 0.0;
+    for (int i = 0; i < this->totCells; i++) {
+        sum += static_cast<double>(a[i]) * b[i];
+    }
+    return sum;
+}
+
+float PcgSolver::maxAbs(const float* a) const {
+    float m = 0.0f;
+    for (int i = 0; i < this->totCells; i++) {
+        m = std::max(m, std::fabs(a[i]));
+    }
+    return m;
+}
+
+void PcgSolver::removeMean(float* a) const {
+    double sum = 0.0;
+    int count = 0;
+    for (int i = 0; i < this->totCells; i++) {
+        if (this->diag[i] != 0.0f) {
+            sum += a[i];
+            count++;
+        }
+    }
+    if (count == 0) {
+        return;
+    }
+
+    float mean = static_cast<float>(sum / count);
+    for (int i = 0; i < this->totCells; i++) {
+        if (this->diag[i] != 0.0f) {
+            a[i] -= mean;
+        }
+    }
+}
+
+void PcgSolver::computeResidual(const float* u, const float* v, float* x) {
+    int stride = this->stride;
+
+    // a fully enclosed domain has only Neumann boundaries; A is then singular and
+    // the right hand side has to be projected onto its range (zero mean)
+    bool hasDirichlet = false;
+
+    // r = b - A x with b = -div(u)
+    this->applyA(x, this->q);
+    for (int i = 0; i < this->width; i++) {
+        for (int j = 0; j < this->height; j++) {
+            int c = i * stride + j;
+            if (this->diag[c] == 0.0f) {
+                x[c] = 0.0f;
+                this->r[c] = 0.0f;
+                continue;
+            }
+
+            float d = u[(i+1) * stride + j] - u[c] + v[c + 1] - v[c];
+            this->r[c] = -d - this->q[c];
+
+            int neighbors = (this->diag[c - stride] != 0.0f) + (this->diag[c + stride] != 0.0f)
+                          + (this->diag[c - 1] != 0.0f) + (this->diag[c + 1] != 0.0f);
+            if (neighbors < this->diag[c]) {
+                hasDirichlet = true;
+            }
+        }
+    }
+
+    if (!hasDirichlet) {
+        this->removeMean(this->r);
+    }
+}
+
+int PcgSolver::solve(const float* u, const float* v, const unsigned char* s, float* x,
+                     float tolerance, int maxIter, float& residual) {
+    this->buildMatrix(s);
+    this->buildPreconditioner();
+
+    this->computeResidual(u, v, x);
+    residual = this->maxAbs(this->r);
+    if (residual <= tolerance) {
+        return 0;
+    }
+
+    this->applyPreconditioner(this->r, this->z);
+    std::copy(this->z, this->z + this->totCells, this->dir);
+    double sigma = this->dot(this->z, this->r);
+
+    int iter = 0;
+    while (iter < maxIter) {
+        iter++;
+
+        this->applyA(this->dir, this->q);
+        double dq = this->dot(this->dir, this->q);
+        if (dq == 0.0) {
+            break;
+        }
+        float alpha = static_cast<float>(sigma / dq);
+
+        for (int c = 0; c < this->totCells; c++) {
+            x[c] += alpha * this->dir[c];
+            this->r[c] -= alpha * this->q[c];
+        }
+
+        if (this->maxAbs(this->r) <= tolerance) {
+            break;
+        }
+
+        this->applyPreconditioner(this->r, this->z);
+        double sigmaNew = this->dot(this->z, this->r);
+        float beta = static_cast<float>(sigmaNew / sigma);
+        sigma = sigmaNew;
+
+        for (int c = 0; c < this->totCells; c++) {
+            this->dir[c] = this->z[c] + beta * this->dir[c];
+        }
+    }
+
+    // the recursively updated r drifts from the true residual in float, report the real one
+    this->computeResidual(u, v, x);
+    residual = this->maxAbs(this->r);
+
+    return iter;
+}
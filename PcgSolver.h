@@ -0,0 +1,50 @@
+#ifndef PCG_SOLVER_H
+#define PCG_SOLVER_H
+
+// MIC(0) preconditioned conjugate gradient for the pressure Poisson equation on the
+// staggered grid (Bridson, "Fluid Simulation for Computer Graphics", ch. 5).
+//
+// Unknowns are the interior cells with s != 0. For every such cell c it solves
+//     sum_n s_n * (x_c - x_n) = -div(u)_c
+// where x is the pressure scaled to velocity units (p * dt / (density * h)) and fluid
+// cells outside the interior (open borders) are held at x = 0. Solid cells are Neumann.
+class PcgSolver {
+private:
+    int width;
+    int height;
+    int stride;
+    int totCells;
+
+    float* diag;    // A_cc, 0 for cells that are not unknowns
+    float* precon;  // MIC(0) factor
+    float* r;       // residual
+    float* z;       // preconditioned residual
+    float* dir;     // search direction
+    float* q;       // A * dir
+
+    void buildMatrix(const unsigned char* s);
+    void buildPreconditioner();
+    void applyA(const float* in, float* out) const;
+    void applyPreconditioner(const float* in, float* out) const;
+    double dot(const float* a, const float* b) const;
+    float maxAbs(const float* a) const;
+    void removeMean(float* a) const;
+    // r = -div(u) - A x, zeroes x outside the unknowns
+    void computeResidual(const float* u, const float* v, float* x);
+
+public:
+    // same dimensions and column stride as the Fluid fields it solves for
+    PcgSolver(int width, int height, int stride);
+    ~PcgSolver();
+
+    PcgSolver(const PcgSolver&) = delete;
+    PcgSolver& operator=(const PcgSolver&) = delete;
+
+    // solves for x in place, starting from the values already in x (warm start). Stops
+    // once the largest remaining cell divergence is <= tolerance or after maxIter
+    // iterations. Returns the iteration count and writes the final max-norm residual.
+    int solve(const float* u, const float* v, const unsigned char* s, float* x,
+              float tolerance, int maxIter, float& residual);
+};
+
+#endif // PCG_SOLVER_H
@@ -0,0 +1,358 @@
+#include "RecordingFormat.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+void put32(std::uint8_t* out, std::uint32_t x) {
+    for (int b = 0; b < 4; b++) {
+        out[b] = static_cast<std::uint8_t>(x >> (8 * b));
+    }
+}
+
+void put64(std::uint8_t* out, std::uint64_t x) {
+    for (int b = 0; b < 8; b++) {
+        out[b] = static_cast<std::uint8_t>(x >> (8 * b));
+    }
+}
+
+std::uint32_t get32(const std::uint8_t* in) {
+    std::uint32_t x = 0;
+    for (int b = 0; b < 4; b++) {
+        x |= static_cast<std::uint32_t>(in[b]) << (8 * b);
+    }
+    return x;
+}
+
+std::uint64_t get64(const std::uint8_t* in) {
+    std::uint64_t x = 0;
+    for (int b = 0; b < 8; b++) {
+        x |= static_cast<std::uint64_t>(in[b]) << (8 * b);
+    }
+    return x;
+}
+
+// xor every float with the one before it and split the result into byte planes. Smooth
+// fields share sign, exponent and high mantissa bits with their neighbours, so the high
+// planes become long runs of zeros
+void deltaPlanes(const float* values, size_t count, std::uint8_t* planes) {
+    std::uint32_t prev = 0;
+    for (size_t k = 0; k < count; k++) {
+        std::uint32_t bits;
+        std::memcpy(&bits, values + k, 4);
+        std::uint32_t d = bits ^ prev;
+        prev = bits;
+        for (int b = 0; b < 4; b++) {
+            planes[b * count + k] = static_cast<std::uint8_t>(d >> (8 * b));
+        }
+    }
+}
+
+void undoDeltaPlanes(const std::uint8_t* planes, size_t count, float* values) {
+    std::uint32_t prev = 0;
+    for (size_t k = 0; k < count; k++) {
+        std::uint32_t d = 0;
+        for (int b = 0; b < 4; b++) {
+            d |= static_cast<std::uint32_t>(planes[b * count + k]) << (8 * b);
+        }
+        prev ^= d;
+        std::memcpy(values + k, &prev, 4);
+    }
+}
+
+void putVarint(std::vector<std::uint8_t>& out, size_t x) {
+    while (x >= 0x80) {
+        out.push_back(static_cast<std::uint8_t>(x | 0x80));
+        x >>= 7;
+    }
+    out.push_back(static_cast<std::uint8_t>(x));
+}
+
+bool getVarint(const std::uint8_t* in, size_t size, size_t& pos, size_t& x) {
+    x = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (pos >= size) {
+            return false;
+        }
+        std::uint8_t byte = in[pos++];
+        x |= static_cast<size_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// non-zero bytes are copied, a run of zeros becomes 0 followed by the run length
+void zeroRunEncode(const std::uint8_t* in, size_t n, std::vector<std::uint8_t>& out) {
+    out.clear();
+    size_t i = 0;
+    while (i < n) {
+        if (in[i] != 0) {
+            out.push_back(in[i]);
+            i++;
+            continue;
+        }
+        size_t j = i;
+        while (j < n && in[j] == 0) {
+            j++;
+        }
+        out.push_back(0);
+        putVarint(out, j - i);
+        i = j;
+    }
+}
+
+bool zeroRunDecode(const std::uint8_t* in, size_t size, std::uint8_t* out, size_t n) {
+    size_t pos = 0;
+    size_t o = 0;
+    while (pos < size) {
+        std::uint8_t byte = in[pos++];
+        if (byte != 0) {
+            if (o >= n) {
+                return false;
+            }
+            out[o++] = byte;
+            continue;
+        }
+        size_t run;
+        if (!getVarint(in, size, pos, run) || run > n - o) {
+            return false;
+        }
+        std::fill(out + o, out + o + run, 0);
+        o += run;
+    }
+    return o == n;
+}
+
+// LZ4-style sequences: token (literal length << 4 | match length - 4), extra length bytes
+// for values >= 15, the literals, a 2 byte offset and extra match length bytes. The last
+// sequence has no match; the decoder stops once the known output size is reached.
+const int LZ_MIN_MATCH = 4;
+const int LZ_HASH_BITS = 16;
+const size_t LZ_WINDOW = 65535;
+
+void putLength(std::vector<std::uint8_t>& out, size_t len) {
+    while (len >= 255) {
+        out.push_back(255);
+        len -= 255;
+    }
+    out.push_back(static_cast<std::uint8_t>(len));
+}
+
+bool getLength(const std::uint8_t* in, size_t size, size_t& pos, size_t& len) {
+    while (true) {
+        if (pos >= size) {
+            return false;
+        }
+        std::uint8_t byte = in[pos++];
+        len += byte;
+        if (byte != 255) {
+            return true;
+        }
+    }
+}
+
+void putSequence(std::vector<std::uint8_t>& out, const std::uint8_t* literals, size_t literal_len,
+                 size_t offset, size_t match_len) {
+    size_t match_code = match_len == 0 ? 0 : match_len - LZ_MIN_MATCH;
+    out.push_back(static_cast<std::uint8_t>((std::min<size_t>(literal_len, 15) << 4) | std::min<size_t>(match_code, 15)));
+    if (literal_len >= 15) {
+        putLength(out, literal_len - 15);
+    }
+    out.insert(out.end(), literals, literals + literal_len);
+
+    if (match_len == 0) {
+        return;
+    }
+    out.push_back(static_cast<std::uint8_t>(offset));
+    out.push_back(static_cast<std::uint8_t>(offset >> 8));
+    if (match_code >= 15) {
+        putLength(out, match_code - 15);
+    }
+}
+
+void lzEncode(const std::uint8_t* in, size_t n, std::vector<std::uint8_t>& out) {
+    // positions + 1 of the last 4-byte sequence with each hash, 0 = none
+    static thread_local std::vector<std::uint32_t> table;
+    table.assign(size_t(1) << LZ_HASH_BITS, 0);
+
+    out.clear();
+    size_t anchor = 0;
+    size_t i = 0;
+    while (i + LZ_MIN_MATCH <= n) {
+        std::uint32_t seq;
+        std::memcpy(&seq, in + i, 4);
+        std::uint32_t hash = (seq * 2654435761u) >> (32 - LZ_HASH_BITS);
+        size_t candidate = table[hash];
+        table[hash] = static_cast<std::uint32_t>(i + 1);
+
+        if (candidate != 0 && i - (candidate - 1) <= LZ_WINDOW
+            && std::memcmp(in + candidate - 1, in + i, LZ_MIN_MATCH) == 0) {
+            size_t ref = candidate - 1;
+            size_t len = LZ_MIN_MATCH;
+            while (i + len < n && in[ref + len] == in[i + len]) {
+                len++;
+            }
+            putSequence(out, in + anchor, i - anchor, i - ref, len);
+            i += len;
+            anchor = i;
+        } else {
+            i++;
+        }
+    }
+
+    if (anchor < n) {
+        putSequence(out, in + anchor, n - anchor, 0, 0);
+    }
+}
+
+bool lzDecode(const std::uint8_t* in, size_t size, std::uint8_t* out, size_t n) {
+    size_t pos = 0;
+    size_t o = 0;
+    while (o < n) {
+        if (pos >= size) {
+            return false;
+        }
+        std::uint8_t token = in[pos++];
+
+        size_t literal_len = token >> 4;
+        if (literal_len == 15 && !getLength(in, size, pos, literal_len)) {
+            return false;
+        }
+        if (literal_len > size - pos || literal_len > n - o) {
+            return false;
+        }
+        std::memcpy(out + o, in + pos, literal_len);
+        pos += literal_len;
+        o += literal_len;
+        if (o == n) {
+            break;
+        }
+
+        if (size - pos < 2) {
+            return false;
+        }
+        size_t offset = in[pos] | (static_cast<size_t>(in[pos + 1]) << 8);
+        pos += 2;
+        size_t match_len = token & 15;
+        if (match_len == 15 && !getLength(in, size, pos, match_len)) {
+            return false;
+        }
+        match_len += LZ_MIN_MATCH;
+        if (offset == 0 || offset > o || match_len > n - o) {
+            return false;
+        }
+        // byte by byte, matches may overlap their own output
+        for (size_t k = 0; k < match_len; k++) {
+            out[o + k] = out[o + k - offset];
+        }
+        o += match_len;
+    }
+    return pos == size;
+}
+
+}
+
+void writeRecordingHeader(const RecordingHeader& header, std::uint8_t* out) {
+    std::memset(out, 0, RECORDING_HEADER_SIZE);
+    std::memcpy(out, RECORDING_MAGIC, 8);
+    put32(out + 8, header.version);
+    put32(out + 12, header.width);
+    put32(out + 16, header.height);
+    put32(out + 20, header.fieldMask);
+    put32(out + 24, static_cast<std::uint32_t>(header.compression));
+    put32(out + 28, header.every);
+    put64(out + 32, header.frameCount);
+    put64(out + 40, header.indexOffset);
+}
+
+bool readRecordingHeader(const std::uint8_t* in, RecordingHeader& header) {
+    if (std::memcmp(in, RECORDING_MAGIC, 8) != 0) {
+        return false;
+    }
+    header.version = get32(in + 8);
+    header.width = get32(in + 12);
+    header.height = get32(in + 16);
+    header.fieldMask = get32(in + 20);
+    header.compression = static_cast<RecordCompression>(get32(in + 24));
+    header.every = get32(in + 28);
+    header.frameCount = get64(in + 32);
+    header.indexOffset = get64(in + 40);
+    return header.version == RECORDING_VERSION;
+}
+
+void writeIndexEntry(const RecordingIndexEntry& entry, std::uint8_t* out) {
+    std::memset(out, 0, RECORDING_INDEX_ENTRY_SIZE);
+    put64(out, entry.offset);
+    put64(out + 8, entry.size);
+    put64(out + 16, static_cast<std::uint64_t>(entry.step));
+    std::uint32_t time_bits;
+    std::memcpy(&time_bits, &entry.time, 4);
+    put32(out + 24, time_bits);
+}
+
+void readIndexEntry(const std::uint8_t* in, RecordingIndexEntry& entry) {
+    entry.offset = get64(in);
+    entry.size = get64(in + 8);
+    entry.step = static_cast<std::int64_t>(get64(in + 16));
+    std::uint32_t time_bits = get32(in + 24);
+    std::memcpy(&entry.time, &time_bits, 4);
+}
+
+int recordFieldCount(std::uint32_t fieldMask) {
+    int count = 0;
+    for (int bit = 0; bit < 4; bit++) {
+        count += (fieldMask >> bit) & 1;
+    }
+    return count;
+}
+
+void encodeFrame(const float* values, size_t count, RecordCompression compression,
+                 std::vector<std::uint8_t>& out, std::vector<std::uint8_t>& scratch) {
+    size_t bytes = count * 4;
+    switch (compression) {
+        case RecordCompression::None:
+            out.resize(bytes);
+            std::memcpy(out.data(), values, bytes);
+            return;
+        case RecordCompression::Delta:
+            scratch.resize(bytes);
+            deltaPlanes(values, count, scratch.data());
+            zeroRunEncode(scratch.data(), bytes, out);
+            return;
+        case RecordCompression::Lz:
+            scratch.resize(bytes);
+            deltaPlanes(values, count, scratch.data());
+            lzEncode(scratch.data(), bytes, out);
+            return;
+    }
+}
+
+bool decodeFrame(const std::uint8_t* in, size_t size, RecordCompression compression,
+                 float* values, size_t count, std::vector<std::uint8_t>& scratch) {
+    size_t bytes = count * 4;
+    switch (compression) {
+        case RecordCompression::None:
+            if (size != bytes) {
+                return false;
+            }
+            std::memcpy(values, in, bytes);
+            return true;
+        case RecordCompression::Delta:
+            scratch.resize(bytes);
+            if (!zeroRunDecode(in, size, scratch.data(), bytes)) {
+                return false;
+            }
+            undoDeltaPlanes(scratch.data(), count, values);
+            return true;
+        case RecordCompression::Lz:
+            scratch.resize(bytes);
+            if (!lzDecode(in, size, scratch.data(), bytes)) {
+                return false;
+            }
+            undoDeltaPlanes(scratch.data(), count, values);
+            return true;
+    }
+    return false;
+}
@@ -0,0 +1,70 @@
+#ifndef RECORDING_FORMAT_H
+#define RECORDING_FORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// on-disk layout shared by FrameRecorder and RecordingReader. Everything is little endian.
+//
+//   header   64 bytes, see RecordingHeader
+//   chunks   one per recorded frame, back to back; each is self-contained so any frame can
+//            be decoded without its neighbours
+//   index    frameCount RecordingIndexEntry, at header.indexOffset
+//
+// a frame holds the recorded fields one after the other (u, v, p, m order, only those in
+// fieldMask), each (width + 2) x (height + 2) floats, column major, without stride padding.
+
+enum class RecordCompression : std::uint32_t {
+    None = 0,   // raw floats
+    Delta = 1,  // xor with the previous value, byte planes, zero runs collapsed
+    Lz = 2      // same transform, then LZ77 with a 64 KB window
+};
+
+enum RecordField : std::uint32_t {
+    RECORD_U = 1,
+    RECORD_V = 2,
+    RECORD_PRESSURE = 4,
+    RECORD_SMOKE = 8,
+    RECORD_ALL = 15
+};
+
+const char RECORDING_MAGIC[8] = {'F', 'L', 'U', 'I', 'D', 'R', 'E', 'C'};
+const std::uint32_t RECORDING_VERSION = 1;
+const size_t RECORDING_HEADER_SIZE = 64;
+const size_t RECORDING_INDEX_ENTRY_SIZE = 32;
+
+struct RecordingHeader {
+    std::uint32_t version = RECORDING_VERSION;
+    std::uint32_t width = 0;       // interior cells
+    std::uint32_t height = 0;
+    std::uint32_t fieldMask = RECORD_ALL;
+    RecordCompression compression = RecordCompression::None;
+    std::uint32_t every = 1;       // steps between recorded frames
+    std::uint64_t frameCount = 0;
+    std::uint64_t indexOffset = 0;
+};
+
+struct RecordingIndexEntry {
+    std::uint64_t offset = 0;  // chunk start in the file
+    std::uint64_t size = 0;    // encoded chunk size in bytes
+    std::int64_t step = 0;
+    float time = 0.0f;
+};
+
+void writeRecordingHeader(const RecordingHeader& header, std::uint8_t* out);
+// false when the magic or the version does not match
+bool readRecordingHeader(const std::uint8_t* in, RecordingHeader& header);
+void writeIndexEntry(const RecordingIndexEntry& entry, std::uint8_t* out);
+void readIndexEntry(const std::uint8_t* in, RecordingIndexEntry& entry);
+
+int recordFieldCount(std::uint32_t fieldMask);
+
+// encodes count floats into out (resized to fit). scratch is reused between calls
+void encodeFrame(const float* values, size_t count, RecordCompression compression,
+                 std::vector<std::uint8_t>& out, std::vector<std::uint8_t>& scratch);
+// decodes a chunk written by encodeFrame into count floats; false if the chunk is corrupt
+bool decodeFrame(const std::uint8_t* in, size_t size, RecordCompression compression,
+                 float* values, size_t count, std::vector<std::uint8_t>& scratch);
+
+#endif // RECORDING_FORMAT_H
@@ -0,0 +1,132 @@
+#include "RecordingReader.h"
+#include <fstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define FLUID_HAVE_MMAP
+#endif
+
+RecordingReader::RecordingReader() {
+    this->data = nullptr;
+    this->size = 0;
+    this->mapped = false;
+}
+
+RecordingReader::~RecordingReader() {
+    this->close();
+}
+
+bool RecordingReader::open(const std::string& path) {
+    this->close();
+
+#if defined(FLUID_HAVE_MMAP)
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(RECORDING_HEADER_SIZE)) {
+        ::close(fd);
+        return false;
+    }
+    void* address = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (address == MAP_FAILED) {
+        return false;
+    }
+    this->data = static_cast<const std::uint8_t*>(address);
+    this->size = static_cast<size_t>(info.st_size);
+    this->mapped = true;
+#else
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    this->contents.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    if (this->contents.size() < RECORDING_HEADER_SIZE) {
+        return false;
+    }
+    this->data = this->contents.data();
+    this->size = this->contents.size();
+#endif
+
+    // the index has to fit behind the chunks, an unfinished recording has no index yet
+    if (!readRecordingHeader(this->data, this->header)
+        || this->header.indexOffset < RECORDING_HEADER_SIZE
+        || this->header.indexOffset > this->size
+        || this->header.frameCount > (this->size - this->header.indexOffset) / RECORDING_INDEX_ENTRY_SIZE) {
+        this->close();
+        return false;
+    }
+    return true;
+}
+
+void RecordingReader::close() {
+#if defined(FLUID_HAVE_MMAP)
+    if (this->mapped) {
+        munmap(const_cast<std::uint8_t*>(this->data), this->size);
+    }
+#endif
+    this->contents.clear();
+    this->data = nullptr;
+    this->size = 0;
+    this->mapped = false;
+    this->header = RecordingHeader();
+}
+
+const RecordingHeader& RecordingReader::getHeader() const {
+    return this->header;
+}
+
+long RecordingReader::frameCount() const {
+    return static_cast<long>(this->header.frameCount);
+}
+
+RecordingIndexEntry RecordingReader::frameInfo(long frame) const {
+    RecordingIndexEntry entry;
+    readIndexEntry(this->data + this->header.indexOffset + frame * RECORDING_INDEX_ENTRY_SIZE, entry);
+    return entry;
+}
+
+long RecordingReader::findStep(long step) const {
+    // frames are written in step order
+    long lo = 0;
+    long hi = this->frameCount();
+    while (lo < hi) {
+        long mid = lo + (hi - lo) / 2;
+        if (this->frameInfo(mid).step < step) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+bool RecordingReader::readFrame(long frame, std::vector<float>& values) {
+    if (frame < 0 || frame >= this->frameCount()) {
+        return false;
+    }
+    RecordingIndexEntry entry = this->frameInfo(frame);
+    if (entry.offset > this->header.indexOffset || entry.size > this->header.indexOffset - entry.offset) {
+        return false;
+    }
+
+    size_t count = static_cast<size_t>(recordFieldCount(this->header.fieldMask))
+                 * (this->header.width + 2) * (this->header.height + 2);
+    values.resize(count);
+    return decodeFrame(this->data + entry.offset, entry.size, this->header.compression,
+                       values.data(), count, this->scratch);
+}
+
+const float* RecordingReader::field(const std::vector<float>& values, RecordField which) const {
+    if ((this->header.fieldMask & which) == 0) {
+        return nullptr;
+    }
+    // fields before this one in u, v, p, m order
+    size_t before = static_cast<size_t>(recordFieldCount(this->header.fieldMask & (which - 1)));
+    return values.data() + before * (this->header.width + 2) * (this->header.height + 2);
+}
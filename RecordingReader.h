@@ -0,0 +1,46 @@
+#ifndef RECORDING_READER_H
+#define RECORDING_READER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "RecordingFormat.h"
+
+// random access to a file written by FrameRecorder. The file is memory-mapped (read into
+// memory where mmap is not available), so seeking is an index lookup and reading a frame
+// only touches that frame's chunk.
+class RecordingReader {
+private:
+    const std::uint8_t* data;
+    size_t size;
+    bool mapped;
+    std::vector<std::uint8_t> contents;  // fallback when the file is not mapped
+
+    RecordingHeader header;
+    std::vector<std::uint8_t> scratch;
+
+public:
+    RecordingReader();
+    ~RecordingReader();
+
+    RecordingReader(const RecordingReader&) = delete;
+    RecordingReader& operator=(const RecordingReader&) = delete;
+
+    // false if the file is missing, truncated or not a recording of this version
+    bool open(const std::string& path);
+    void close();
+
+    const RecordingHeader& getHeader() const;
+    long frameCount() const;
+    RecordingIndexEntry frameInfo(long frame) const;
+    // first frame recorded at or after step, frameCount() if there is none
+    long findStep(long step) const;
+
+    // decodes a frame into values, one (width + 2) x (height + 2) block per recorded field
+    // in u, v, p, m order. False if the chunk is corrupt
+    bool readFrame(long frame, std::vector<float>& values);
+    // start of one field in values decoded by readFrame, nullptr if it was not recorded
+    const float* field(const std::vector<float>& values, RecordField which) const;
+};
+
+#endif // RECORDING_READER_H
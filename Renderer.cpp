@@ -0,0 +1,34 @@
+#include "Renderer.h"
+#include <algorithm>
+#include <stdexcept>
+
+FieldRenderer::FieldRenderer(int width, int height, int stride, float cellWidth, float cellHeight,
+                             int smokeFactor, int smokeStride)
+    : colorizer(width, height, stride, smokeFactor, smokeStride), sprite(texture) {
+    // one texel per smoke cell, scaled back down to the cell size on screen
+    int f = std::max(smokeFactor, 1);
+    width *= f;
+    height *= f;
+    cellWidth /= f;
+    cellHeight /= f;
+
+    // opaque, fill() only writes RGB
+    this->pixels.assign(static_cast<size_t>(width) * height * 4, 255);
+
+    if (!this->texture.resize(sf::Vector2u(static_cast<unsigned>(width), static_cast<unsigned>(height)))) {
+        throw std::runtime_error("FieldRenderer: could not create the field texture");
+    }
+    // keep hard cell edges like the old per-cell rectangles
+    this->texture.setSmooth(false);
+    this->sprite.setTexture(this->texture, true);
+    this->sprite.setScale(sf::Vector2f(cellWidth, cellHeight));
+}
+
+void FieldRenderer::update(const float* pressureField, const float* smokeField) {
+    this->colorizer.fill(pressureField, smokeField, this->pixels.data());
+    this->texture.update(this->pixels.data());
+}
+
+void FieldRenderer::draw(sf::RenderTarget& target) const {
+    target.draw(this->sprite);
+}
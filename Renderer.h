@@ -0,0 +1,30 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <vector>
+#include "FieldColorizer.h"
+
+// draws the pressure / smoke fields as one texture: a single pass into a pixel buffer,
+// one texture upload and one draw call per frame instead of a shape per cell
+class FieldRenderer {
+private:
+    FieldColorizer colorizer;
+    std::vector<std::uint8_t> pixels;  // RGBA, one pixel per cell (per smoke cell with detail)
+    sf::Texture texture;
+    sf::Sprite sprite;
+
+public:
+    // cellWidth / cellHeight are the on-screen size of one cell in pixels, stride is
+    // Fluid::getStride(). smokeFactor / smokeStride describe the smoke field like in
+    // FieldColorizer
+    FieldRenderer(int width, int height, int stride, float cellWidth, float cellHeight,
+                  int smokeFactor = 1, int smokeStride = 0);
+
+    // fields use the Fluid layout: width + 2 columns of stride floats
+    void update(const float* pressureField, const float* smokeField);
+    void draw(sf::RenderTarget& target) const;
+};
+
+#endif // RENDERER_H
@@ -0,0 +1,148 @@
+#include "Scenario.h"
+
+Scenario::Scenario(int width, int height, ScenarioType type) {
+    this->width = width;
+    this->height = height;
+    this->type = type;
+
+    // the demo places the circle at the window centre
+    this->circleCenterX = width * 0.5f;
+    this->circleCenterY = height * 0.5f;
+    this->circleRadius = width * 0.0375f;
+
+    // the demo uses j = 45..54 on a 100 cell high grid
+    this->inflowBegin = static_cast<int>(height * 0.45f);
+    this->inflowEnd = static_cast<int>(height * 0.55f);
+    this->inflowSpeed = 200.0f;
+}
+
+void Scenario::setInflowSpeed(float speed) {
+    this->inflowSpeed = speed;
+}
+
+float Scenario::getInflowSpeed() const {
+    return this->inflowSpeed;
+}
+
+void Scenario::setCircle(float x, float y, float radius) {
+    this->circleCenterX = x;
+    this->circleCenterY = y;
+    this->circleRadius = radius;
+}
+
+bool Scenario::parse(const std::string& name, ScenarioType& type) {
+    if (name == "jet") {
+        type = ScenarioType::Jet;
+    } else if (name == "jet-circle") {
+        type = ScenarioType::JetCircle;
+    } else if (name == "empty") {
+        type = ScenarioType::Empty;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* Scenario::name(ScenarioType type) {
+    switch (type) {
+        case ScenarioType::Jet: return "jet";
+        case ScenarioType::JetCircle: return "jet-circle";
+        case ScenarioType::Empty: return "empty";
+    }
+    return "unknown";
+}
+
+bool parsePressureSolver(const std::string& name, PressureSolver& solver) {
+    if (name == "gs") {
+        solver = PressureSolver::GaussSeidel;
+    } else if (name == "rb") {
+        solver = PressureSolver::RedBlack;
+    } else if (name == "cg") {
+        solver = PressureSolver::ConjugateGradient;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* pressureSolverName(PressureSolver solver) {
+    switch (solver) {
+        case PressureSolver::GaussSeidel: return "gs";
+        case PressureSolver::RedBlack: return "rb";
+        case PressureSolver::ConjugateGradient: return "cg";
+    }
+    return "unknown";
+}
+
+bool parseAdvectionScheme(const std::string& name, AdvectionScheme& scheme) {
+    if (name == "sl") {
+        scheme = AdvectionScheme::SemiLagrangian;
+    } else if (name == "maccormack") {
+        scheme = AdvectionScheme::MacCormack;
+    } else if (name == "bfecc") {
+        scheme = AdvectionScheme::Bfecc;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* advectionSchemeName(AdvectionScheme scheme) {
+    switch (scheme) {
+        case AdvectionScheme::SemiLagrangian: return "sl";
+        case AdvectionScheme::MacCormack: return "maccormack";
+        case AdvectionScheme::Bfecc: return "bfecc";
+    }
+    return "unknown";
+}
+
+bool parseSimdLevel(const std::string& name, SimdLevel& level) {
+    if (name == "scalar") {
+        level = SimdLevel::Scalar;
+    } else if (name == "generic") {
+        level = SimdLevel::Generic;
+    } else if (name == "avx2") {
+        level = SimdLevel::Avx2;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool parseRecordCompression(const std::string& name, RecordCompression& compression) {
+    if (name == "none") {
+        compression = RecordCompression::None;
+    } else if (name == "delta") {
+        compression = RecordCompression::Delta;
+    } else if (name == "lz") {
+        compression = RecordCompression::Lz;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool parseSmokeStorage(const std::string& name, SmokeStorage& storage) {
+    if (name == "float32") {
+        storage = SmokeStorage::Float32;
+    } else if (name == "float16") {
+        storage = SmokeStorage::Float16;
+    } else if (name == "unorm16") {
+        storage = SmokeStorage::UNorm16;
+    } else if (name == "unorm8") {
+        storage = SmokeStorage::UNorm8;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* smokeStorageName(SmokeStorage storage) {
+    switch (storage) {
+        case SmokeStorage::Float32: return "float32";
+        case SmokeStorage::Float16: return "float16";
+        case SmokeStorage::UNorm16: return "unorm16";
+        case SmokeStorage::UNorm8: return "unorm8";
+    }
+    return "unknown";
+}
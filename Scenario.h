@@ -0,0 +1,95 @@
+#ifndef SCENARIO_H
+#define SCENARIO_H
+
+#include <string>
+#include "Fluid.h"
+#include "RecordingFormat.h"
+
+// scene setups shared by the headless runner and the benchmark. Jet and JetCircle
+// reproduce the interactive demo in main.cpp (scaled to the grid size).
+enum class ScenarioType {
+    Jet,        // inflow jet on the left wall of a closed box
+    JetCircle,  // the demo: inflow jet plus the circle obstacle at its default spot
+    Empty       // closed box with no forcing
+};
+
+class Scenario {
+private:
+    int width;
+    int height;
+    ScenarioType type;
+
+    // circle obstacle in grid units (demo: radius 30px / 8px per cell at 100x100)
+    float circleCenterX;
+    float circleCenterY;
+    float circleRadius;
+
+    // inflow rows [inflowBegin, inflowEnd) on the first interior column
+    int inflowBegin;
+    int inflowEnd;
+    float inflowSpeed;
+
+public:
+    Scenario(int width, int height, ScenarioType type);
+
+    // sweep knobs: the inflow speed (200 in the demo) and the circle, in grid units
+    void setInflowSpeed(float speed);
+    float getInflowSpeed() const;
+    void setCircle(float x, float y, float radius);
+
+    // walls around the domain, everything else fluid, plus the circle for JetCircle.
+    // FluidType is Fluid or a FluidT
+    template <typename FluidType>
+    void setup(FluidType& fluid) const;
+    // per-frame forcing, applied right before every simulate() call
+    template <typename FluidType>
+    void apply(FluidType& fluid) const;
+
+    static bool parse(const std::string& name, ScenarioType& type);
+    static const char* name(ScenarioType type);
+};
+
+template <typename FluidType>
+void Scenario::setup(FluidType& fluid) const {
+    for(int i = 0; i < this->width + 2; i++) {
+        for(int j = 0; j < this->height + 2; j++) {
+            fluid.setFluid(i, j, 1);
+
+            if (i == 0 || i == this->width + 1 || j == 0 || j == this->height + 1) {
+                fluid.setFluid(i, j, 0);  // 0 = solid
+            }
+        }
+    }
+
+    // the circle is static, registered once instead of re-rasterized every step
+    if (this->type == ScenarioType::JetCircle) {
+        fluid.addCircleObstacle(this->circleCenterX, this->circleCenterY, this->circleRadius);
+    }
+}
+
+template <typename FluidType>
+void Scenario::apply(FluidType& fluid) const {
+    if (this->type == ScenarioType::Empty) {
+        return;
+    }
+
+    for(int j = this->inflowBegin; j < this->inflowEnd; j++) {
+        fluid.setSmoke(1, j, 1.0f);
+        fluid.setU(1, j, this->inflowSpeed);
+    }
+}
+
+// command line names of the pressure solvers, shared by the headless tools
+bool parsePressureSolver(const std::string& name, PressureSolver& solver);
+const char* pressureSolverName(PressureSolver solver);
+// sl | maccormack | bfecc
+bool parseAdvectionScheme(const std::string& name, AdvectionScheme& scheme);
+const char* advectionSchemeName(AdvectionScheme scheme);
+bool parseSimdLevel(const std::string& name, SimdLevel& level);
+// none | delta | lz
+bool parseRecordCompression(const std::string& name, RecordCompression& compression);
+// float32 | float16 | unorm16 | unorm8
+bool parseSmokeStorage(const std::string& name, SmokeStorage& storage);
+const char* smokeStorageName(SmokeStorage storage);
+
+#endif // SCENARIO_H
@@ -0,0 +1,57 @@
+#include "SimdKernels.h"
+
+// vector extensions are a GCC / Clang feature, other compilers only get the scalar loops
+#if defined(__GNUC__)
+#define FLUID_HAVE_VECTOR_KERNELS
+
+#define FLUID_SIMD_NAMESPACE simd_generic
+#define FLUID_SIMD_TABLE simdKernelsGeneric
+#include "SimdKernelsImpl.h"
+#endif
+
+#if defined(FLUID_HAVE_AVX2_KERNELS)
+const SimdKernels* simdKernelsAvx2();
+#endif
+
+SimdLevel detectSimdLevel() {
+#if defined(FLUID_HAVE_AVX2_KERNELS)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return SimdLevel::Avx2;
+    }
+#endif
+#if defined(FLUID_HAVE_VECTOR_KERNELS)
+    return SimdLevel::Generic;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+const SimdKernels* getSimdKernels(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::Scalar:
+            return nullptr;
+        case SimdLevel::Generic:
+#if defined(FLUID_HAVE_VECTOR_KERNELS)
+            return simdKernelsGeneric();
+#else
+            return nullptr;
+#endif
+        case SimdLevel::Avx2:
+#if defined(FLUID_HAVE_AVX2_KERNELS)
+            return simdKernelsAvx2();
+#else
+            return nullptr;
+#endif
+    }
+    return nullptr;
+}
+
+const char* simdLevelName(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::Scalar: return "scalar";
+        case SimdLevel::Generic: return "generic";
+        case SimdLevel::Avx2: return "avx2";
+    }
+    return "unknown";
+}
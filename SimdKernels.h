@@ -0,0 +1,53 @@
+#ifndef SIMD_KERNELS_H
+#define SIMD_KERNELS_H
+
+#include "SmokeCodec.h"
+
+// vectorized versions of the per-cell loops in Fluid, 8 cells per vector along a column.
+// width / height are the padded grid dimensions and stride the column stride of the fields.
+// the kernels are built once for the baseline target and, on x86-64, once more with AVX2;
+// the best table for the running CPU is picked at runtime so one binary runs everywhere.
+// s is the 0 / 1 solid mask, one byte per cell.
+
+enum class SimdLevel {
+    Scalar,   // the plain member loops in Fluid.cpp
+    Generic,  // vector kernels for the baseline target (SSE2 / NEON)
+    Avx2      // vector kernels built with -mavx2, hardware gathers
+};
+
+struct SimdKernels {
+    // semi-Lagrangian advection of both velocity components into u_new / v_new over the
+    // interior cells [i_begin, i_end) x [j_begin, j_end). only faces that the scalar loop
+    // would advect are written. a range shorter than a vector is widened downwards, the
+    // extra cells get the same advected values the scalar loop would give them.
+    // column_offset is Fluid::setColumnOffset, positions are computed in those coordinates
+    void (*advectVelocity)(const float* u, const float* v, const unsigned char* s,
+                           float* u_new, float* v_new,
+                           int i_begin, int i_end, int j_begin, int j_end,
+                           int column_offset, int width, int height, int stride, float h, float dt);
+
+    // semi-Lagrangian advection of the smoke field into m_new (fluid cells of the range).
+    // m and m_new hold values of the given storage, decoded on load and encoded on store
+    void (*advectSmoke)(const float* u, const float* v, const unsigned char* s,
+                        const unsigned char* m, unsigned char* m_new, SmokeStorage storage,
+                        int i_begin, int i_end, int j_begin, int j_end,
+                        int column_offset, int width, int height, int stride, float h, float dt);
+
+    // one red-black colour pass of the SOR update over [i_begin, i_end) x [j_begin, j_end).
+    // stride is the column stride of every field (Fluid::getStride()).
+    // s_mask is s converted to float once per projection. nullptr when the scalar
+    // sweep is faster on this target
+    void (*relaxColumns)(float* u, float* v, float* p, const float* s_mask,
+                         int i_begin, int i_end, int j_begin, int j_end, int color, int stride,
+                         float overrelax, float density, float h, float dt);
+};
+
+// best level supported by both this build and the running CPU
+SimdLevel detectSimdLevel();
+
+// kernel table for a level, nullptr for Scalar or a level this build does not have
+const SimdKernels* getSimdKernels(SimdLevel level);
+
+const char* simdLevelName(SimdLevel level);
+
+#endif // SIMD_KERNELS_H
@@ -0,0 +1,7 @@
+// AVX2 build of the vector kernels, compiled with -mavx2 and only called after
+// detectSimdLevel() has checked the CPU
+#include "SimdKernels.h"
+
+#define FLUID_SIMD_NAMESPACE simd_avx2
+#define FLUID_SIMD_TABLE simdKernelsAvx2
+#include "SimdKernelsImpl.h"
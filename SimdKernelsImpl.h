@@ -0,0 +1,475 @@
+// kernel bodies for SimdKernels.h. Included once per target by SimdKernels.cpp and
+// SimdKernelsAvx2.cpp, each with its own FLUID_SIMD_NAMESPACE and FLUID_SIMD_TABLE, so no
+// include guard. Everything here has internal linkage and nothing from the standard library
+// is instantiated, so AVX2 code can never be merged into the baseline build by the linker.
+//
+// every expression mirrors the scalar loops in Fluid.cpp operation for operation, so the
+// vector paths give the same results as the scalar ones. The compact smoke storages decode
+// and encode with the static helpers of SmokeCodec.h, the same ones the scalar loops use.
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace FLUID_SIMD_NAMESPACE {
+
+// one native register: 8 lanes with AVX2, 4 on the baseline SSE2 / NEON target where wider
+// vectors would be split and spilled
+#if defined(__AVX2__)
+const int LANES = 8;
+#else
+const int LANES = 4;
+#endif
+typedef float vfloat __attribute__((vector_size(LANES * 4)));
+typedef int vint __attribute__((vector_size(LANES * 4)));
+typedef unsigned char vbyte __attribute__((vector_size(LANES)));
+
+#define FLUID_SIMD_INLINE static inline __attribute__((always_inline))
+#define FLUID_SIMD_MEMBER static inline __attribute__((always_inline))
+
+FLUID_SIMD_INLINE vfloat splat(float x) {
+    vfloat r;
+    for (int k = 0; k < LANES; k++) {
+        r[k] = x;
+    }
+    return r;
+}
+
+FLUID_SIMD_INLINE vint splati(int x) {
+    vint r;
+    for (int k = 0; k < LANES; k++) {
+        r[k] = x;
+    }
+    return r;
+}
+
+// {0, 1, ..., LANES-1}
+FLUID_SIMD_INLINE vint laneIndex() {
+    vint r;
+    for (int k = 0; k < LANES; k++) {
+        r[k] = k;
+    }
+    return r;
+}
+
+FLUID_SIMD_INLINE vfloat loadf(const float* ptr) {
+    vfloat r;
+    __builtin_memcpy(&r, ptr, sizeof(r));
+    return r;
+}
+
+// LANES bytes of the solid mask, widened to one int per lane
+FLUID_SIMD_INLINE vint loadMask(const unsigned char* ptr) {
+    vbyte r;
+    __builtin_memcpy(&r, ptr, sizeof(r));
+    return __builtin_convertvector(r, vint);
+}
+
+FLUID_SIMD_INLINE void storef(float* ptr, vfloat x) {
+    __builtin_memcpy(ptr, &x, sizeof(x));
+}
+
+#if defined(__AVX2__)
+// stores only the lanes set in mask; the others are not written at all, so a neighbouring
+// thread may own them
+FLUID_SIMD_INLINE void storefMasked(float* ptr, vint mask, vfloat x) {
+    _mm256_maskstore_ps(ptr, (__m256i)mask, (__m256)x);
+}
+#endif
+
+// lane-wise mask ? a : b, masks are all ones / all zeros per lane
+FLUID_SIMD_INLINE vfloat select(vint mask, vfloat a, vfloat b) {
+    return (vfloat)((mask & (vint)a) | (~mask & (vint)b));
+}
+
+FLUID_SIMD_INLINE vint selecti(vint mask, vint a, vint b) {
+    return (mask & a) | (~mask & b);
+}
+
+// same argument order as std::min / std::max
+FLUID_SIMD_INLINE vfloat vmin(vfloat a, vfloat b) {
+    return select(b < a, b, a);
+}
+
+FLUID_SIMD_INLINE vfloat vmax(vfloat a, vfloat b) {
+    return select(a < b, b, a);
+}
+
+FLUID_SIMD_INLINE vint vmini(vint a, vint b) {
+    return selecti(b < a, b, a);
+}
+
+FLUID_SIMD_INLINE vfloat gather(const float* f, vint idx) {
+#if defined(__AVX2__)
+    return (vfloat)_mm256_i32gather_ps(f, (__m256i)idx, 4);
+#else
+    vfloat r;
+    for (int k = 0; k < LANES; k++) {
+        r[k] = f[idx[k]];
+    }
+    return r;
+#endif
+}
+
+// {prev[LANES-1], next[0], ..., next[LANES-2]}
+FLUID_SIMD_INLINE vfloat shiftIn(vfloat prev, vfloat next) {
+#if defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 12)
+#if defined(__AVX2__)
+    return __builtin_shufflevector(prev, next, 7, 8, 9, 10, 11, 12, 13, 14);
+#else
+    return __builtin_shufflevector(prev, next, 3, 4, 5, 6);
+#endif
+#else
+    vfloat r;
+    r[0] = prev[LANES - 1];
+    for (int k = 1; k < LANES; k++) {
+        r[k] = next[k - 1];
+    }
+    return r;
+#endif
+}
+
+// compact smoke codes. gather(f, idx) loads and decodes LANES codes, quantize(x) gives the
+// codes of LANES values as ints; both match decodeSmoke / encodeSmoke exactly
+struct SmokeHalfCodec {
+    typedef std::uint16_t Code;
+    FLUID_SIMD_MEMBER vfloat gather(const Code* f, vint idx) {
+        vfloat r;
+        for (int k = 0; k < LANES; k++) {
+            r[k] = halfToFloat(f[idx[k]]);
+        }
+        return r;
+    }
+    FLUID_SIMD_MEMBER vint quantize(vfloat x) {
+        vint r;
+        for (int k = 0; k < LANES; k++) {
+            r[k] = floatToHalf(x[k]);
+        }
+        return r;
+    }
+};
+
+// unsigned normalized codes with `Max` as 1.0
+template <typename CodeType, int Max>
+struct SmokeUNormCodec {
+    typedef CodeType Code;
+    FLUID_SIMD_MEMBER vfloat gather(const Code* f, vint idx) {
+#if defined(__AVX2__)
+        // 32-bit gather at the code's byte offset, the bytes above the code are masked off.
+        // they still get read: the last code of a smoke slot is followed by the rest of the
+        // cache line or by the next arena slot, never by unmapped memory
+        vint raw = (vint)_mm256_i32gather_epi32(reinterpret_cast<const int*>(f), (__m256i)idx, sizeof(Code));
+        vint codes = raw & splati(Max);
+#else
+        vint codes;
+        for (int k = 0; k < LANES; k++) {
+            codes[k] = f[idx[k]];
+        }
+#endif
+        return __builtin_convertvector(codes, vfloat) * splat(1.0f / Max);
+    }
+    FLUID_SIMD_MEMBER vint quantize(vfloat x) {
+        vint zero = splati(0);
+        vint rounded = __builtin_convertvector(x * splat(static_cast<float>(Max)) + splat(0.5f), vint);
+        // lanes that are not > 0 (nan included) give 0, lanes >= 1 give Max. the rounded
+        // value is only used where it is in range
+        vint codes = selecti(x >= splat(1.0f), splati(Max), rounded);
+        return selecti(x > splat(0.0f), codes, zero);
+    }
+};
+
+typedef SmokeUNormCodec<std::uint16_t, 65535> SmokeUNorm16Codec;
+typedef SmokeUNormCodec<unsigned char, 255> SmokeUNorm8Codec;
+
+struct FloatFetch {
+    const float* f;
+    inline __attribute__((always_inline)) vfloat operator()(vint idx) const { return gather(this->f, idx); }
+};
+
+template <typename Codec>
+struct DecodeFetch {
+    const typename Codec::Code* f;
+    inline __attribute__((always_inline)) vfloat operator()(vint idx) const { return Codec::gather(this->f, idx); }
+};
+
+// Fluid::sampleField for 8 points at once, fetch(idx) loads the field at LANES indices.
+// x is in the coordinates of a grid whose column column_offset is column 0 of the fields
+template <typename Fetch>
+FLUID_SIMD_INLINE vfloat sampleWith(Fetch fetch, vfloat x, vfloat y, float dx, float dy,
+                                    int column_offset, int width, int height, int stride, float h) {
+    // bounding with ghost cells
+    x = vmax(vmin(x, splat((column_offset + width) * h)), splat((column_offset + 1) * h));
+    y = vmax(vmin(y, splat(height * h)), splat(h));
+
+    vfloat xs = x - splat(dx);
+    vfloat ys = y - splat(dy);
+
+    // xs, ys >= h/2 after the clamp, so truncation is the floor
+    vint x0 = vmini(__builtin_convertvector(xs / splat(h), vint), splati(column_offset + width - 1));
+    vint x1 = vmini(x0 + 1, splati(column_offset + width - 1));
+    vint y0 = vmini(__builtin_convertvector(ys / splat(h), vint), splati(height - 1));
+    vint y1 = vmini(y0 + 1, splati(height - 1));
+
+    vfloat w_right = (xs - __builtin_convertvector(x0, vfloat) * splat(h)) / splat(h);
+    vfloat w_up = (ys - __builtin_convertvector(y0, vfloat) * splat(h)) / splat(h);
+    vfloat w_left = splat(1.0f) - w_right;
+    vfloat w_down = splat(1.0f) - w_up;
+
+    vint vstride = splati(stride);
+    x0 -= splati(column_offset);
+    x1 -= splati(column_offset);
+    vfloat f00 = fetch(x0 * vstride + y0);
+    vfloat f10 = fetch(x1 * vstride + y0);
+    vfloat f11 = fetch(x1 * vstride + y1);
+    vfloat f01 = fetch(x0 * vstride + y1);
+
+    return w_left * w_down * f00 + w_right * w_down * f10 + w_right * w_up * f11 + w_left * w_up * f01;
+}
+
+FLUID_SIMD_INLINE vfloat sample(const float* f, vfloat x, vfloat y, float dx, float dy,
+                                int column_offset, int width, int height, int stride, float h) {
+    return sampleWith(FloatFetch{f}, x, y, dx, dy, column_offset, width, height, stride, h);
+}
+
+static void advectVelocity(const float* u, const float* v, const unsigned char* s,
+                           float* u_new, float* v_new,
+                           int i_begin, int i_end, int j_begin, int j_end,
+                           int column_offset, int width, int height, int stride, float h, float dt) {
+    float half_cell = h / 2;
+    vint lane = laneIndex();
+    vint zero = splati(0);
+
+    // the last block of a column is shifted back to end at j_end (but not below the first
+    // interior cell); it only reads the old fields, so computing a few cells twice gives
+    // the same values
+    int j_last = j_end - LANES < 1 ? 1 : j_end - LANES;
+
+    for (int i = i_begin; i < i_end; i++) {
+        for (int j0 = j_begin; j0 < j_end; j0 += LANES) {
+            int j = j0 + LANES > j_end ? j_last : j0;
+            int c = i * stride + j;
+            vfloat jf = __builtin_convertvector(splati(j) + lane, vfloat);
+
+            vint s_c = loadMask(s + c) != zero;
+            vint s_left = loadMask(s + c - stride) != zero;
+            vint s_down = loadMask(s + c - 1) != zero;
+
+            // u, only between two open cells
+            vfloat cur_u = loadf(u + c);
+            vfloat cur_v = (loadf(v + c) + loadf(v + c - stride) + loadf(v + c + 1) + loadf(v + c - stride + 1)) / splat(4.0f);
+            vfloat x = splat((i + column_offset) * h) - splat(dt) * cur_u;
+            vfloat y = (jf * splat(h) + splat(half_cell)) - splat(dt) * cur_v;
+            vfloat sampled = sample(u, x, y, 0.0f, half_cell, column_offset, width, height, stride, h);
+            storef(u_new + c, select(s_c & s_left, sampled, cur_u));
+
+            // v
+            cur_v = loadf(v + c);
+            cur_u = (loadf(u + c - 1) + loadf(u + c) + loadf(u + c + stride - 1) + loadf(u + c + stride)) / splat(4.0f);
+            x = splat((i + column_offset) * h + half_cell) - splat(dt) * cur_u;
+            y = jf * splat(h) - splat(dt) * cur_v;
+            sampled = sample(v, x, y, half_cell, 0.0f, column_offset, width, height, stride, h);
+            storef(v_new + c, select(s_c & s_down, sampled, cur_v));
+        }
+    }
+}
+
+static void advectSmokeFloat(const float* u, const float* v, const unsigned char* s,
+                             const float* m, float* m_new,
+                             int i_begin, int i_end, int j_begin, int j_end,
+                             int column_offset, int width, int height, int stride, float h, float dt) {
+    float h2 = 0.5f * h;
+    float half_cell = h / 2;
+    vint lane = laneIndex();
+    vint zero = splati(0);
+
+    int j_last = j_end - LANES < 1 ? 1 : j_end - LANES;
+
+    for (int i = i_begin; i < i_end; i++) {
+        for (int j0 = j_begin; j0 < j_end; j0 += LANES) {
+            int j = j0 + LANES > j_end ? j_last : j0;
+            int c = i * stride + j;
+            vfloat jf = __builtin_convertvector(splati(j) + lane, vfloat);
+
+            vint fluid = loadMask(s + c) != zero;
+
+            // velocity at the cell centre
+            vfloat cu = (loadf(u + c) + loadf(u + c + stride)) * splat(0.5f);
+            vfloat cv = (loadf(v + c) + loadf(v + c + 1)) * splat(0.5f);
+
+            vfloat x = splat((i + column_offset) * h + h2) - splat(dt) * cu;
+            vfloat y = (jf * splat(h) + splat(h2)) - splat(dt) * cv;
+
+            vfloat sampled = sample(m, x, y, half_cell, half_cell, column_offset, width, height, stride, h);
+            storef(m_new + c, select(fluid, sampled, loadf(m + c)));
+        }
+    }
+}
+
+// advectSmokeFloat on encoded smoke: solid cells keep their code, fluid cells get the
+// encoded sample
+template <typename Codec>
+static void advectSmokeCoded(const float* u, const float* v, const unsigned char* s,
+                             const typename Codec::Code* m, typename Codec::Code* m_new,
+                             int i_begin, int i_end, int j_begin, int j_end,
+                             int column_offset, int width, int height, int stride, float h, float dt) {
+    typedef typename Codec::Code Code;
+    typedef Code vcode __attribute__((vector_size(LANES * sizeof(Code))));
+    float h2 = 0.5f * h;
+    float half_cell = h / 2;
+    vint lane = laneIndex();
+    vint zero = splati(0);
+    DecodeFetch<Codec> fetch = {m};
+
+    int j_last = j_end - LANES < 1 ? 1 : j_end - LANES;
+
+    for (int i = i_begin; i < i_end; i++) {
+        for (int j0 = j_begin; j0 < j_end; j0 += LANES) {
+            int j = j0 + LANES > j_end ? j_last : j0;
+            int c = i * stride + j;
+            vfloat jf = __builtin_convertvector(splati(j) + lane, vfloat);
+
+            vfloat cu = (loadf(u + c) + loadf(u + c + stride)) * splat(0.5f);
+            vfloat cv = (loadf(v + c) + loadf(v + c + 1)) * splat(0.5f);
+
+            vfloat x = splat((i + column_offset) * h + h2) - splat(dt) * cu;
+            vfloat y = (jf * splat(h) + splat(h2)) - splat(dt) * cv;
+
+            vint codes = Codec::quantize(sampleWith(fetch, x, y, half_cell, half_cell, column_offset, width, height, stride, h));
+
+            // narrow to the code width, solid cells keep their old code
+            vcode fluid = __builtin_convertvector(loadMask(s + c) != zero, vcode);
+            vcode old_codes;
+            __builtin_memcpy(&old_codes, m + c, sizeof(old_codes));
+            vcode new_codes = (fluid & __builtin_convertvector(codes, vcode)) | (~fluid & old_codes);
+            __builtin_memcpy(m_new + c, &new_codes, sizeof(new_codes));
+        }
+    }
+}
+
+static void advectSmoke(const float* u, const float* v, const unsigned char* s,
+                        const unsigned char* m, unsigned char* m_new, SmokeStorage storage,
+                        int i_begin, int i_end, int j_begin, int j_end,
+                        int column_offset, int width, int height, int stride, float h, float dt) {
+    switch (storage) {
+        case SmokeStorage::Float32:
+            advectSmokeFloat(u, v, s, reinterpret_cast<const float*>(m), reinterpret_cast<float*>(m_new),
+                             i_begin, i_end, j_begin, j_end, column_offset, width, height, stride, h, dt);
+            break;
+        case SmokeStorage::Float16:
+            advectSmokeCoded<SmokeHalfCodec>(u, v, s, reinterpret_cast<const std::uint16_t*>(m),
+                                             reinterpret_cast<std::uint16_t*>(m_new),
+                                             i_begin, i_end, j_begin, j_end, column_offset, width, height, stride, h, dt);
+            break;
+        case SmokeStorage::UNorm16:
+            advectSmokeCoded<SmokeUNorm16Codec>(u, v, s, reinterpret_cast<const std::uint16_t*>(m),
+                                                reinterpret_cast<std::uint16_t*>(m_new),
+                                                i_begin, i_end, j_begin, j_end, column_offset, width, height, stride, h, dt);
+            break;
+        case SmokeStorage::UNorm8:
+            advectSmokeCoded<SmokeUNorm8Codec>(u, v, s, m, m_new,
+                                               i_begin, i_end, j_begin, j_end, column_offset, width, height, stride, h, dt);
+            break;
+    }
+}
+
+// scalar SOR update of one cell, Fluid::relaxCell on the float mask
+FLUID_SIMD_INLINE void relaxCell(float* u, float* v, float* p, const float* s_mask, int c, int stride,
+                                 float overrelax, float density, float h, float dt) {
+    if (s_mask[c] == 0.0f) {
+        return;
+    }
+    float s_left = s_mask[c - stride];
+    float s_right = s_mask[c + stride];
+    float s_up = s_mask[c + 1];
+    float s_down = s_mask[c - 1];
+    float s_factor = s_left + s_right + s_up + s_down;
+    if (s_factor == 0.0f) {
+        return;
+    }
+
+    float d = u[c + stride] - u[c] + v[c + 1] - v[c];
+    float pc = -d / s_factor;
+
+    u[c] -= pc * s_left * overrelax;
+    u[c + stride] += pc * s_right * overrelax;
+    v[c] -= pc * s_down * overrelax;
+    v[c + 1] += pc * s_up * overrelax;
+    p[c] += pc * overrelax * density * h / dt;
+}
+
+#if defined(__AVX2__)
+static void relaxColumns(float* u, float* v, float* p, const float* s_mask,
+                         int i_begin, int i_end, int j_begin, int j_end, int color, int stride,
+                         float overrelax, float density, float h, float dt) {
+    vint lane = laneIndex();
+    vfloat zero = splat(0.0f);
+    // masked-off lanes subtract +0 and add -0, which leaves every value (and its sign) as is
+    vfloat neg_zero = splat(-0.0f);
+    vfloat omega = splat(overrelax);
+
+    for (int i = i_begin; i < i_end; i++) {
+        // up-face contributions of the previous block, its last lane lands on this block's first v
+        vfloat prev_up = neg_zero;
+        int j = j_begin;
+
+        // every cell of the column is evaluated and the other colour is masked off. Cells of
+        // one colour never touch each other's faces, so all loads see pre-pass values.
+        for (; j + LANES <= j_end; j += LANES) {
+            int c = i * stride + j;
+
+            vfloat s_c = loadf(s_mask + c);
+            vfloat s_left = loadf(s_mask + c - stride);
+            vfloat s_right = loadf(s_mask + c + stride);
+            vfloat s_up = loadf(s_mask + c + 1);
+            vfloat s_down = loadf(s_mask + c - 1);
+            vfloat s_factor = s_left + s_right + s_up + s_down;
+
+            vint active = (s_c != zero) & (s_factor != zero) & (((splati(i + j) + lane) & 1) == splati(color));
+
+            vfloat d = loadf(u + c + stride) - loadf(u + c) + loadf(v + c + 1) - loadf(v + c);
+            vfloat pc = select(active, -d / select(active, s_factor, splat(1.0f)), zero);
+
+            // the u faces are shared with the neighbouring columns, which may be relaxed by
+            // another thread in this pass. only the active lanes are written back
+            storefMasked(u + c, active, loadf(u + c) - pc * s_left * omega);
+            storefMasked(u + c + stride, active, loadf(u + c + stride) + pc * s_right * omega);
+
+            // v[j] gets the down face of cell j and the up face of cell j-1, at most one is active
+            vfloat up = select(active, pc * s_up * omega, neg_zero);
+            storef(v + c, loadf(v + c) - pc * s_down * omega + shiftIn(prev_up, up));
+            prev_up = up;
+
+            storef(p + c, loadf(p + c) + select(active, pc * omega * splat(density) * splat(h) / splat(dt), neg_zero));
+        }
+
+        v[i * stride + j] += prev_up[LANES - 1];
+
+        for (; j < j_end; j++) {
+            if (((i + j) & 1) == color) {
+                relaxCell(u, v, p, s_mask, i * stride + j, stride, overrelax, density, h, dt);
+            }
+        }
+    }
+}
+
+#endif
+
+#undef FLUID_SIMD_INLINE
+#undef FLUID_SIMD_MEMBER
+
+} // namespace FLUID_SIMD_NAMESPACE
+
+const SimdKernels* FLUID_SIMD_TABLE() {
+    static const SimdKernels table = {
+        FLUID_SIMD_NAMESPACE::advectVelocity,
+        FLUID_SIMD_NAMESPACE::advectSmoke,
+#if defined(__AVX2__)
+        FLUID_SIMD_NAMESPACE::relaxColumns
+#else
+        // evaluating both colours and masking one off only pays off with 8 lanes; on
+        // 4-lane targets the scalar checkerboard sweep is faster
+        nullptr
+#endif
+    };
+    return &table;
+}
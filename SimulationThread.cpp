@@ -0,0 +1,107 @@
+#include "SimulationThread.h"
+#include <algorithm>
+#include <chrono>
+
+SimulationThread::SimulationThread(Fluid& fluid, int width, int height, float dt, int tot_iter, float g)
+    : fluid(fluid) {
+    this->width = width;
+    this->height = height;
+    this->dt = dt;
+    this->tot_iter = tot_iter;
+    this->g = g;
+    this->realtime = true;
+    this->hasSnapshot = false;
+    this->running = false;
+}
+
+SimulationThread::~SimulationThread() {
+    this->stop();
+}
+
+void SimulationThread::setStepHook(Command hook) {
+    this->stepHook = std::move(hook);
+}
+
+void SimulationThread::setRealtime(bool realtime) {
+    this->realtime = realtime;
+}
+
+void SimulationThread::start() {
+    if (this->running) {
+        return;
+    }
+    this->running = true;
+    this->worker = std::thread(&SimulationThread::run, this);
+}
+
+void SimulationThread::stop() {
+    this->running = false;
+    if (this->worker.joinable()) {
+        this->worker.join();
+    }
+}
+
+void SimulationThread::post(Command command) {
+    std::lock_guard<std::mutex> lock(this->commandMutex);
+    this->commands.push_back(std::move(command));
+}
+
+void SimulationThread::publishSnapshot(long step, float time) {
+    FieldSnapshot& snapshot = this->snapshots.writeBuffer();
+    size_t totCells = static_cast<size_t>(this->fluid.getFieldSize());
+
+    // buffers are recycled, so this only allocates for the first three frames
+    snapshot.pressure.resize(totCells);
+    size_t smokeCells = static_cast<size_t>(this->fluid.getFineSmokeSize());
+    snapshot.smoke.resize(smokeCells);
+    std::copy(this->fluid.getPressureField(), this->fluid.getPressureField() + totCells, snapshot.pressure.begin());
+    // compact smoke is decoded by getSmokeField, once
+    const float* smoke = this->fluid.getFineSmokeField();
+    std::copy(smoke, smoke + smokeCells, snapshot.smoke.begin());
+    snapshot.step = step;
+    snapshot.time = time;
+
+    this->snapshots.publish();
+}
+
+void SimulationThread::run() {
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point start = Clock::now();
+    long step = 0;
+
+    while (this->running) {
+        // grab queued edits with the lock held only for the swap
+        {
+            std::lock_guard<std::mutex> lock(this->commandMutex);
+            this->pending.swap(this->commands);
+        }
+        for (Command& command : this->pending) {
+            command(this->fluid);
+        }
+        this->pending.clear();
+
+        if (this->stepHook) {
+            this->stepHook(this->fluid);
+        }
+        this->fluid.simulate(this->dt, this->tot_iter, this->g);
+        step++;
+
+        this->publishSnapshot(step, step * this->dt);
+
+        if (this->realtime) {
+            std::this_thread::sleep_until(start + std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>(step * static_cast<double>(this->dt))));
+        }
+    }
+}
+
+const FieldSnapshot* SimulationThread::latest(bool* isNew) {
+    bool fresh = this->snapshots.update();
+    if (fresh) {
+        this->hasSnapshot = true;
+    }
+    if (isNew != nullptr) {
+        *isNew = fresh;
+    }
+    return this->hasSnapshot ? &this->snapshots.readBuffer() : nullptr;
+}
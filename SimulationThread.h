@@ -0,0 +1,76 @@
+#ifndef SIMULATION_THREAD_H
+#define SIMULATION_THREAD_H
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Fluid.h"
+#include "TripleBuffer.h"
+
+// copy of the fields the viewer draws, in the Fluid layout (width + 2 columns of getStride())
+struct FieldSnapshot {
+    long step = 0;
+    float time = 0.0f;
+    std::vector<float> pressure;
+    std::vector<float> smoke;  // the fine smoke (getFineSmokeField) with smoke detail
+};
+
+// steps a Fluid on its own thread at a fixed dt. Finished frames are published through a
+// triple buffer, and edits from other threads (obstacles, inflow) are queued and applied
+// between steps, so neither side blocks the other.
+class SimulationThread {
+public:
+    using Command = std::function<void(Fluid&)>;
+
+private:
+    Fluid& fluid;
+    int width;
+    int height;
+    float dt;
+    int tot_iter;
+    float g;
+    bool realtime;
+
+    Command stepHook;
+
+    std::mutex commandMutex;
+    std::vector<Command> commands;
+    std::vector<Command> pending;  // sim thread only
+
+    TripleBuffer<FieldSnapshot> snapshots;
+    bool hasSnapshot;
+
+    std::atomic<bool> running;
+    std::thread worker;
+
+    void run();
+    void publishSnapshot(long step, float time);
+
+public:
+    // width / height are the interior grid size the fluid was created with. The fluid must not
+    // be touched from other threads between start() and stop() except through post().
+    SimulationThread(Fluid& fluid, int width, int height, float dt, int tot_iter, float g);
+    ~SimulationThread();
+
+    SimulationThread(const SimulationThread&) = delete;
+    SimulationThread& operator=(const SimulationThread&) = delete;
+
+    // called on the sim thread before every step, e.g. to re-apply inflow. Set before start().
+    void setStepHook(Command hook);
+    // true: pace steps to wall clock time (dt per step); false: run as fast as possible
+    void setRealtime(bool realtime);
+
+    void start();
+    void stop();
+
+    // queue an edit; it runs on the sim thread before the next step
+    void post(Command command);
+
+    // newest complete frame, nullptr before the first one. isNew reports whether it changed
+    // since the last call. The returned snapshot stays valid until the next call.
+    const FieldSnapshot* latest(bool* isNew = nullptr);
+};
+
+#endif // SIMULATION_THREAD_H
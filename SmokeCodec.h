@@ -0,0 +1,133 @@
+#ifndef SMOKE_CODEC_H
+#define SMOKE_CODEC_H
+
+#include <cstdint>
+#include <cstring>
+
+// element type of the smoke field. Smoke only drives the display blend and stays in [0, 1]
+// (advection only interpolates), so it can be stored in fewer bits than the velocities.
+//
+// the helpers are static so the AVX2 kernel TU gets its own copies, see SimdKernelsImpl.h
+enum class SmokeStorage {
+    Float32,  // plain float, the reference path
+    Float16,  // IEEE half, round to nearest even; finest near 0, 2^-11 steps just below 1
+    UNorm16,  // [0, 1] in 65535 even steps
+    UNorm8    // [0, 1] in 255 even steps, display precision
+};
+
+static inline int smokeStorageBytes(SmokeStorage storage) {
+    switch (storage) {
+        case SmokeStorage::Float32:
+            return 4;
+        case SmokeStorage::Float16:
+        case SmokeStorage::UNorm16:
+            return 2;
+        case SmokeStorage::UNorm8:
+            return 1;
+    }
+    return 4;
+}
+
+static inline float halfToFloat(std::uint16_t half) {
+    // move exponent and mantissa into place and rebias; subnormals are renormalized by
+    // subtracting the smallest normal half
+    std::uint32_t bits = static_cast<std::uint32_t>(half & 0x7fff) << 13;
+    std::uint32_t exponent = bits & (0x7c00u << 13);
+    bits += (127 - 15) << 23;
+    if (exponent == (0x7c00u << 13)) {
+        bits += (128 - 16) << 23;  // inf / nan
+    } else if (exponent == 0) {
+        bits += 1 << 23;
+        float f;
+        std::memcpy(&f, &bits, 4);
+        f -= 6.103515625e-05f;  // 2^-14
+        std::memcpy(&bits, &f, 4);
+    }
+    bits |= static_cast<std::uint32_t>(half & 0x8000) << 16;
+    float f;
+    std::memcpy(&f, &bits, 4);
+    return f;
+}
+
+static inline std::uint16_t floatToHalf(float value) {
+    std::uint32_t bits;
+    std::memcpy(&bits, &value, 4);
+    std::uint32_t sign = (bits >> 16) & 0x8000;
+    bits &= 0x7fffffff;
+
+    std::uint32_t half;
+    if (bits >= (127 + 16) << 23) {
+        half = bits > (255u << 23) ? 0x7e00 : 0x7c00;  // nan : too large for a half
+    } else if (bits < (127 - 14) << 23) {
+        // subnormal half: adding 0.5 lets the float adder round the mantissa into place
+        float f;
+        std::memcpy(&f, &bits, 4);
+        f += 0.5f;
+        std::memcpy(&bits, &f, 4);
+        half = bits - (126u << 23);
+    } else {
+        // rebias and round to nearest even on the 13 dropped mantissa bits
+        std::uint32_t odd = (bits >> 13) & 1;
+        bits += ((15u - 127u) << 23) + 0xfff + odd;
+        half = bits >> 13;
+    }
+    return static_cast<std::uint16_t>(half | sign);
+}
+
+// [0, 1] to 0..scale, rounded; nan and negatives give 0
+static inline std::uint32_t quantizeUnit(float value, float scale) {
+    if (!(value > 0.0f)) {
+        return 0;
+    }
+    if (value >= 1.0f) {
+        return static_cast<std::uint32_t>(scale);
+    }
+    return static_cast<std::uint32_t>(value * scale + 0.5f);
+}
+
+// value c of a smoke field stored as `storage`
+static inline float decodeSmoke(const unsigned char* f, int c, SmokeStorage storage) {
+    switch (storage) {
+        case SmokeStorage::Float32: {
+            float x;
+            std::memcpy(&x, f + 4 * c, 4);
+            return x;
+        }
+        case SmokeStorage::Float16: {
+            std::uint16_t x;
+            std::memcpy(&x, f + 2 * c, 2);
+            return halfToFloat(x);
+        }
+        case SmokeStorage::UNorm16: {
+            std::uint16_t x;
+            std::memcpy(&x, f + 2 * c, 2);
+            return x * (1.0f / 65535.0f);
+        }
+        case SmokeStorage::UNorm8:
+            return f[c] * (1.0f / 255.0f);
+    }
+    return 0.0f;
+}
+
+static inline void encodeSmoke(unsigned char* f, int c, SmokeStorage storage, float value) {
+    switch (storage) {
+        case SmokeStorage::Float32:
+            std::memcpy(f + 4 * c, &value, 4);
+            break;
+        case SmokeStorage::Float16: {
+            std::uint16_t x = floatToHalf(value);
+            std::memcpy(f + 2 * c, &x, 2);
+            break;
+        }
+        case SmokeStorage::UNorm16: {
+            std::uint16_t x = static_cast<std::uint16_t>(quantizeUnit(value, 65535.0f));
+            std::memcpy(f + 2 * c, &x, 2);
+            break;
+        }
+        case SmokeStorage::UNorm8:
+            f[c] = static_cast<unsigned char>(quantizeUnit(value, 255.0f));
+            break;
+    }
+}
+
+#endif // SMOKE_CODEC_H
@@ -0,0 +1,145 @@
+#include "StepProfiler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+const char* stepStageName(StepStage stage) {
+    switch (stage) {
+        case StepStage::ParticleToGrid: return "particleToGrid";
+        case StepStage::Emitters: return "emitters";
+        case StepStage::Tiles: return "tiles";
+        case StepStage::Gravity: return "gravity";
+        case StepStage::ResetPressure: return "resetPressure";
+        case StepStage::Pressure: return "pressure";
+        case StepStage::Extrapolate: return "extrapolate";
+        case StepStage::Advect: return "advect";
+        case StepStage::AdvectSmoke: return "advectSmoke";
+        case StepStage::AdvectScalars: return "advectScalars";
+        default: return "unknown";
+    }
+}
+
+StepProfiler::StepProfiler(int window, bool trace, size_t maxEvents) {
+    this->window = std::max(window, 1);
+    this->durations.assign(static_cast<size_t>(STEP_STAGE_COUNT) * this->window, 0.0f);
+    for (int k = 0; k < STEP_STAGE_COUNT; k++) {
+        this->heads[k] = 0;
+        this->counts[k] = 0;
+        this->cells[k] = 0;
+        this->bytes[k] = 0;
+    }
+    this->steps = 0;
+    this->divergence = 0.0f;
+
+    this->trace = trace;
+    this->maxEvents = maxEvents;
+    this->droppedEvents = 0;
+    this->origin = Clock::now();
+}
+
+void StepProfiler::beginStep() {
+    this->steps++;
+}
+
+void StepProfiler::record(StepStage stage, Clock::time_point start, Clock::time_point end, long long cells, long long bytes) {
+    int k = static_cast<int>(stage);
+    double ms = std::chrono::duration<double, std::milli>(end - start).count();
+    this->durations[static_cast<size_t>(k) * this->window + this->heads[k]] = static_cast<float>(ms);
+    this->heads[k] = (this->heads[k] + 1) % this->window;
+    this->counts[k] = std::min(this->counts[k] + 1, this->window);
+    this->cells[k] = cells;
+    this->bytes[k] = bytes;
+
+    if (!this->trace) {
+        return;
+    }
+    if (this->events.size() >= this->maxEvents) {
+        this->droppedEvents++;
+        return;
+    }
+    Event event;
+    event.stage = k;
+    event.step = this->steps;
+    event.startUs = std::chrono::duration<double, std::micro>(start - this->origin).count();
+    event.durationUs = ms * 1000.0;
+    event.cells = cells;
+    event.bytes = bytes;
+    this->events.push_back(event);
+}
+
+void StepProfiler::setDivergence(float divergence) {
+    this->divergence = divergence;
+}
+
+int StepProfiler::getWindow() const {
+    return this->window;
+}
+
+bool StepProfiler::isTracing() const {
+    return this->trace;
+}
+
+void StepProfiler::summarize(FluidProfile& profile) const {
+    profile.window = this->window;
+    profile.steps = this->steps;
+    profile.divergence = this->divergence;
+
+    std::vector<float> sorted;
+    for (int k = 0; k < STEP_STAGE_COUNT; k++) {
+        StageProfile& stage = profile.stages[k];
+        stage = StageProfile();
+        stage.cells = this->cells[k];
+        stage.bytes = this->bytes[k];
+        stage.samples = this->counts[k];
+        if (stage.samples == 0) {
+            continue;
+        }
+
+        // the ring is only full once window runs were recorded, the first counts[k] are valid
+        const float* ring = this->durations.data() + static_cast<size_t>(k) * this->window;
+        sorted.assign(ring, ring + stage.samples);
+        std::sort(sorted.begin(), sorted.end());
+
+        double sum = 0.0;
+        for (float ms : sorted) {
+            sum += ms;
+            double us = ms * 1000.0;
+            int bucket = us < 1.0 ? 0 : 1 + static_cast<int>(std::log2(us));
+            stage.histogram[std::min(bucket, PROFILE_BUCKETS - 1)]++;
+        }
+        int n = stage.samples;
+        stage.meanMs = sum / n;
+        stage.minMs = sorted.front();
+        stage.maxMs = sorted.back();
+        stage.p50Ms = sorted[(n - 1) / 2];
+        stage.p95Ms = sorted[std::min(n - 1, static_cast<int>(std::ceil(0.95 * n)) - 1)];
+    }
+}
+
+bool StepProfiler::writeChromeTrace(const std::string& path) const {
+    std::FILE* file = std::fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        return false;
+    }
+
+    std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    std::fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"Fluid\"}}");
+    for (const Event& event : this->events) {
+        std::fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"step\",\"ph\":\"X\",\"pid\":1,\"tid\":1,"
+                           "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"step\":%lld,\"cells\":%lld,\"bytes\":%lld}}",
+                     stepStageName(static_cast<StepStage>(event.stage)), event.startUs, event.durationUs,
+                     event.step, event.cells, event.bytes);
+    }
+    std::fprintf(file, "\n]}\n");
+
+    bool ok = std::ferror(file) == 0;
+    return std::fclose(file) == 0 && ok;
+}
+
+size_t StepProfiler::eventCount() const {
+    return this->events.size();
+}
+
+size_t StepProfiler::eventsDropped() const {
+    return this->droppedEvents;
+}
@@ -0,0 +1,98 @@
+#ifndef STEP_PROFILER_H
+#define STEP_PROFILER_H
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+// stages of one Fluid step, in the order they run
+enum class StepStage {
+    ParticleToGrid, // only with FLIP, sorts the particles and splats them onto the faces
+    Emitters,       // only with registered emitters
+    Tiles,          // updateActiveTiles, only with tile tracking
+    Gravity,
+    ResetPressure,  // skipped by CG
+    Pressure,
+    Extrapolate,
+    Advect,         // with FLIP the grid-to-particle update and the particle moves
+    AdvectSmoke,
+    AdvectScalars,  // only with registered scalars
+    Count
+};
+
+const int STEP_STAGE_COUNT = static_cast<int>(StepStage::Count);
+
+const char* stepStageName(StepStage stage);
+
+// stage times are binned in powers of two of microseconds: bucket 0 is below 1 us, bucket
+// k covers [2^(k-1), 2^k) us and the last bucket everything above
+const int PROFILE_BUCKETS = 24;
+
+struct StageProfile {
+    int samples = 0;          // runs of the stage in the window
+    double meanMs = 0.0;
+    double minMs = 0.0;
+    double maxMs = 0.0;
+    double p50Ms = 0.0;
+    double p95Ms = 0.0;
+    int histogram[PROFILE_BUCKETS] = {};
+    long long cells = 0;      // cell updates of the last run (pressure: cells * iterations)
+    long long bytes = 0;      // estimated field bytes it read and wrote
+};
+
+struct FluidProfile {
+    int window = 0;           // steps kept per stage
+    long long steps = 0;      // steps profiled since profiling was turned on
+    float divergence = 0.0f;  // largest |div u| of a fluid cell after the last projection
+    StageProfile stages[STEP_STAGE_COUNT];
+};
+
+// per-stage timings of the last `window` steps, kept in one ring per stage. With trace on,
+// every stage run is also kept as an event (up to maxEvents) for writeChromeTrace.
+class StepProfiler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+private:
+    struct Event {
+        int stage;
+        long long step;
+        double startUs;
+        double durationUs;
+        long long cells;
+        long long bytes;
+    };
+
+    int window;
+    std::vector<float> durations;  // [stage][window] in ms
+    int heads[STEP_STAGE_COUNT];
+    int counts[STEP_STAGE_COUNT];
+    long long cells[STEP_STAGE_COUNT];
+    long long bytes[STEP_STAGE_COUNT];
+    long long steps;
+    float divergence;
+
+    bool trace;
+    size_t maxEvents;
+    size_t droppedEvents;
+    std::vector<Event> events;
+    Clock::time_point origin;
+
+public:
+    StepProfiler(int window, bool trace, size_t maxEvents = 1 << 20);
+
+    void beginStep();
+    void record(StepStage stage, Clock::time_point start, Clock::time_point end, long long cells, long long bytes);
+    void setDivergence(float divergence);
+
+    int getWindow() const;
+    bool isTracing() const;
+    void summarize(FluidProfile& profile) const;
+    // chrome://tracing / Perfetto JSON, one complete event per stage run. False if the file
+    // could not be written
+    bool writeChromeTrace(const std::string& path) const;
+    size_t eventCount() const;
+    size_t eventsDropped() const;
+};
+
+#endif // STEP_PROFILER_H
@@ -0,0 +1,96 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(int numThreads) {
+    if (numThreads <= 0) {
+        numThreads = static_cast<int>(std::thread::hardware_concurrency());
+    }
+    this->numThreads = std::max(numThreads, 1);
+    this->job = nullptr;
+    this->jobBegin = 0;
+    this->jobEnd = 0;
+    this->generation = 0;
+    this->stopping = false;
+    this->remaining = 0;
+
+    // worker 0 is the caller
+    for (int t = 1; t < this->numThreads; t++) {
+        this->workers.emplace_back(&ThreadPool::workerLoop, this, t);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->wake.notify_all();
+    for (std::thread& worker : this->workers) {
+        worker.join();
+    }
+}
+
+int ThreadPool::size() const {
+    return this->numThreads;
+}
+
+void ThreadPool::runChunk(int index, const std::function<void(int, int)>& fn, int begin, int end) const {
+    int count = end - begin;
+    int chunkBegin = begin + static_cast<int>(static_cast<long long>(count) * index / this->numThreads);
+    int chunkEnd = begin + static_cast<int>(static_cast<long long>(count) * (index + 1) / this->numThreads);
+    if (chunkBegin < chunkEnd) {
+        fn(chunkBegin, chunkEnd);
+    }
+}
+
+void ThreadPool::workerLoop(int index) {
+    unsigned long seen = 0;
+    while (true) {
+        const std::function<void(int, int)>* fn;
+        int begin;
+        int end;
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->wake.wait(lock, [&] { return this->stopping || this->generation != seen; });
+            if (this->stopping) {
+                return;
+            }
+            seen = this->generation;
+            fn = this->job;
+            begin = this->jobBegin;
+            end = this->jobEnd;
+        }
+
+        this->runChunk(index, *fn, begin, end);
+
+        if (this->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->done.notify_one();
+        }
+    }
+}
+
+void ThreadPool::parallelFor(int begin, int end, const std::function<void(int, int)>& fn) {
+    if (end <= begin) {
+        return;
+    }
+    if (this->numThreads == 1) {
+        fn(begin, end);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->job = &fn;
+        this->jobBegin = begin;
+        this->jobEnd = end;
+        this->remaining.store(this->numThreads - 1, std::memory_order_relaxed);
+        this->generation++;
+    }
+    this->wake.notify_all();
+
+    this->runChunk(0, fn, begin, end);
+
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->done.wait(lock, [&] { return this->remaining.load(std::memory_order_acquire) == 0; });
+}
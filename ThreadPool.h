@@ -0,0 +1,49 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// fixed set of worker threads for data-parallel loops over grid columns.
+// the calling thread takes part in every loop, so a pool of size 1 spawns no threads.
+class ThreadPool {
+private:
+    std::vector<std::thread> workers;
+    int numThreads;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+
+    // current job, published under mutex
+    const std::function<void(int, int)>* job;
+    int jobBegin;
+    int jobEnd;
+    unsigned long generation;
+    bool stopping;
+
+    std::atomic<int> remaining;
+
+    void workerLoop(int index);
+    void runChunk(int index, const std::function<void(int, int)>& fn, int begin, int end) const;
+
+public:
+    // numThreads <= 0 picks std::thread::hardware_concurrency()
+    explicit ThreadPool(int numThreads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int size() const;
+
+    // calls fn(chunkBegin, chunkEnd) on contiguous chunks covering [begin, end), one per thread,
+    // and returns once all chunks are done
+    void parallelFor(int begin, int end, const std::function<void(int, int)>& fn);
+};
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,52 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+
+// lock-free single producer / single consumer triple buffer. The producer fills
+// writeBuffer() and publishes it; the consumer picks up the newest published buffer
+// whenever it likes. Neither side ever waits for the other, and the consumer always
+// sees a complete buffer.
+template <typename T>
+class TripleBuffer {
+private:
+    static const int INDEX_MASK = 3;
+    static const int FRESH = 4;  // set while the middle buffer has not been picked up
+
+    T buffers[3];
+    std::atomic<int> middle;
+    int back;   // owned by the producer
+    int front;  // owned by the consumer
+
+public:
+    TripleBuffer() : middle(1), back(0), front(2) {}
+
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    // producer side
+    T& writeBuffer() {
+        return this->buffers[this->back];
+    }
+
+    void publish() {
+        int previous = this->middle.exchange(this->back | FRESH, std::memory_order_acq_rel);
+        this->back = previous & INDEX_MASK;
+    }
+
+    // consumer side: swaps in the newest published buffer, false if nothing new
+    bool update() {
+        if ((this->middle.load(std::memory_order_relaxed) & FRESH) == 0) {
+            return false;
+        }
+        int previous = this->middle.exchange(this->front, std::memory_order_acq_rel);
+        this->front = previous & INDEX_MASK;
+        return true;
+    }
+
+    const T& readBuffer() const {
+        return this->buffers[this->front];
+    }
+};
+
+#endif // TRIPLE_BUFFER_H
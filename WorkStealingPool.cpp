@@ -0,0 +1,130 @@
+#include "WorkStealingPool.h"
+#include <algorithm>
+
+WorkStealingPool::WorkStealingPool(int numThreads) {
+    if (numThreads <= 0) {
+        numThreads = static_cast<int>(std::thread::hardware_concurrency());
+    }
+    this->numThreads = std::max(numThreads, 1);
+    this->job = nullptr;
+    this->generation = 0;
+    this->stopping = false;
+    this->remaining = 0;
+    this->steals = 0;
+
+    for (int t = 0; t < this->numThreads; t++) {
+        this->queues.emplace_back(new TaskQueue());
+    }
+    // worker 0 is the caller
+    for (int t = 1; t < this->numThreads; t++) {
+        this->workers.emplace_back(&WorkStealingPool::workerLoop, this, t);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->wake.notify_all();
+    for (std::thread& worker : this->workers) {
+        worker.join();
+    }
+}
+
+int WorkStealingPool::size() const {
+    return this->numThreads;
+}
+
+long WorkStealingPool::stealCount() const {
+    return this->steals.load(std::memory_order_relaxed);
+}
+
+bool WorkStealingPool::popOwn(int index, int& task) {
+    TaskQueue& queue = *this->queues[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) {
+        return false;
+    }
+    task = queue.tasks.back();
+    queue.tasks.pop_back();
+    return true;
+}
+
+bool WorkStealingPool::steal(int index, int& task) {
+    // victims in order after the thief, so thieves do not all hit worker 0 first
+    for (int k = 1; k < this->numThreads; k++) {
+        TaskQueue& queue = *this->queues[(index + k) % this->numThreads];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = queue.tasks.front();
+            queue.tasks.pop_front();
+            this->steals.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::drain(int index, const std::function<void(int, int)>& fn) {
+    // tasks never add tasks, so once every queue is empty this worker is done
+    int task;
+    while (this->popOwn(index, task) || this->steal(index, task)) {
+        fn(task, index);
+    }
+}
+
+void WorkStealingPool::workerLoop(int index) {
+    unsigned long seen = 0;
+    while (true) {
+        const std::function<void(int, int)>* fn;
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->wake.wait(lock, [&] { return this->stopping || this->generation != seen; });
+            if (this->stopping) {
+                return;
+            }
+            seen = this->generation;
+            fn = this->job;
+        }
+
+        this->drain(index, *fn);
+
+        if (this->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->done.notify_one();
+        }
+    }
+}
+
+void WorkStealingPool::run(int count, const std::function<void(int, int)>& fn) {
+    if (count <= 0) {
+        return;
+    }
+    if (this->numThreads == 1) {
+        for (int task = 0; task < count; task++) {
+            fn(task, 0);
+        }
+        return;
+    }
+
+    // deal before waking anyone, the queues are only touched by workers of this batch
+    for (int task = 0; task < count; task++) {
+        TaskQueue& queue = *this->queues[task % this->numThreads];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(task);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->job = &fn;
+        this->remaining.store(this->numThreads - 1, std::memory_order_relaxed);
+        this->generation++;
+    }
+    this->wake.notify_all();
+
+    this->drain(0, fn);
+
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->done.wait(lock, [&] { return this->remaining.load(std::memory_order_acquire) == 0; });
+}
@@ -0,0 +1,66 @@
+#ifndef WORK_STEALING_POOL_H
+#define WORK_STEALING_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// worker threads for batches of independent tasks of uneven cost (whole simulations of
+// different grid sizes, say). Every worker owns a deque: it takes its own tasks from the
+// back and, once that is empty, steals from the front of the others, so a worker stuck
+// with long tasks is relieved without a shared queue every task goes through.
+// Like ThreadPool the calling thread is worker 0.
+class WorkStealingPool {
+private:
+    // a deque with its own lock, on its own cache lines
+    struct alignas(64) TaskQueue {
+        std::mutex mutex;
+        std::deque<int> tasks;
+    };
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<TaskQueue>> queues;
+    int numThreads;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+
+    // current batch, published under mutex
+    const std::function<void(int, int)>* job;
+    unsigned long generation;
+    bool stopping;
+
+    std::atomic<int> remaining;
+    std::atomic<long> steals;
+
+    void workerLoop(int index);
+    // runs tasks until every queue is empty
+    void drain(int index, const std::function<void(int, int)>& fn);
+    bool popOwn(int index, int& task);
+    bool steal(int index, int& task);
+
+public:
+    // numThreads <= 0 picks std::thread::hardware_concurrency()
+    explicit WorkStealingPool(int numThreads);
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    int size() const;
+
+    // calls fn(task, worker) once for every task in [0, count) and returns once all are
+    // done. Tasks are dealt round-robin, worker is the index of the thread running it
+    void run(int count, const std::function<void(int, int)>& fn);
+
+    // tasks taken from another worker's queue since construction
+    long stealCount() const;
+};
+
+#endif // WORK_STEALING_POOL_H
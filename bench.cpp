@@ -0,0 +1,752 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstdint>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include "Fluid.h"
+#include "FluidT.h"
+#include "Scenario.h"
+#include "FieldColorizer.h"
+
+// per-stage timings of Fluid::simulate across a sweep of grid sizes
+
+using Clock = std::chrono::steady_clock;
+
+enum Stage {
+    STAGE_GRAVITY,
+    STAGE_RESET_PRESSURE,
+    STAGE_INCOMPRESSIBILITY,
+    STAGE_EXTRAPOLATE,
+    STAGE_ADVECT,
+    STAGE_ADVECT_SMOKE,
+    STAGE_ADVECT_SCALARS,
+    STAGE_COUNT
+};
+
+static const char* stageNames[STAGE_COUNT] = {
+    "gravity", "resetPressure", "incompress", "extrapolate", "advect", "advectSmoke", "advectScalars"
+};
+
+static std::vector<std::string> splitList(const std::string& value) {
+    std::vector<std::string> list;
+    size_t pos = 0;
+    while (pos < value.size()) {
+        size_t comma = value.find(',', pos);
+        if (comma == std::string::npos) comma = value.size();
+        list.push_back(value.substr(pos, comma - pos));
+        pos = comma + 1;
+    }
+    return list;
+}
+
+static std::vector<int> parseList(const std::string& value) {
+    // comma separated list, e.g. 128,256,1024
+    std::vector<int> list;
+    size_t pos = 0;
+    while (pos < value.size()) {
+        size_t comma = value.find(',', pos);
+        if (comma == std::string::npos) comma = value.size();
+        list.push_back(std::atoi(value.substr(pos, comma - pos).c_str()));
+        pos = comma + 1;
+    }
+    return list;
+}
+
+static double elapsedMs(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// runs the same stage sequence as Fluid::simulate, timing each stage separately. Compact
+// smoke storage is checked against a float run stepped alongside (untimed). scalarCount
+// passive scalars start as gradients across the grid and are advected after the smoke
+static void benchGrid(int n, int steps, int warmup, int tot_iter, ScenarioType scenarioType,
+                      PressureSolver solver, int numThreads, SimdLevel simdLevel, SmokeStorage smokeStorage,
+                      int scalarCount) {
+    float g = 9.81f;
+    float dt = 1.0f / 60.0f;
+    Fluid fluid(n, n, g, 1.0f, 1.9f, solver, numThreads);
+    fluid.setSimdLevel(simdLevel);
+    Scenario scenario(n, n, scenarioType);
+    scenario.setup(fluid);
+    for (int k = 0; k < scalarCount; k++) {
+        fluid.addScalar("scalar" + std::to_string(k));
+        for (int i = 1; i <= n; i++) {
+            for (int j = 1; j <= n; j++) {
+                fluid.setScalar(k, i, j, static_cast<float>((k % 2 == 0 ? i : j) * (k + 1)) / n);
+            }
+        }
+    }
+
+    bool compare = smokeStorage != SmokeStorage::Float32;
+    Fluid reference(fluid);
+    fluid.setSmokeStorage(smokeStorage);
+
+    for (int step = 0; step < warmup; step++) {
+        scenario.apply(fluid);
+        fluid.simulate(dt, tot_iter, g);
+        if (compare) {
+            scenario.apply(reference);
+            reference.simulate(dt, tot_iter, g);
+        }
+    }
+
+    // the viewer's per-frame colour pass, reported next to the step so the two can be compared
+    FieldColorizer colorizer(n, n, fluid.getStride());
+    std::vector<std::uint8_t> rgba(static_cast<size_t>(n) * n * 4, 255);
+    double renderMs = 0.0;
+
+    double total[STAGE_COUNT] = {};
+    for (int step = 0; step < steps; step++) {
+        scenario.apply(fluid);
+
+        Clock::time_point t = Clock::now();
+        fluid.propagateGravity(dt, g);
+        total[STAGE_GRAVITY] += elapsedMs(t);
+
+        // CG warm-starts from the last pressure, simulate() skips the reset for it
+        if (solver != PressureSolver::ConjugateGradient) {
+            t = Clock::now();
+            fluid.resetPressure();
+            total[STAGE_RESET_PRESSURE] += elapsedMs(t);
+        }
+
+        t = Clock::now();
+        fluid.applyIncompressibility(dt, tot_iter);
+        total[STAGE_INCOMPRESSIBILITY] += elapsedMs(t);
+
+        t = Clock::now();
+        fluid.extrapolate();
+        total[STAGE_EXTRAPOLATE] += elapsedMs(t);
+
+        t = Clock::now();
+        fluid.advect(dt);
+        total[STAGE_ADVECT] += elapsedMs(t);
+
+        t = Clock::now();
+        fluid.advectSmoke(dt);
+        total[STAGE_ADVECT_SMOKE] += elapsedMs(t);
+
+        t = Clock::now();
+        fluid.advectScalars(dt);
+        total[STAGE_ADVECT_SCALARS] += elapsedMs(t);
+
+        t = Clock::now();
+        colorizer.fill(fluid.getPressureField(), fluid.getSmokeField(), rgba.data());
+        renderMs += elapsedMs(t);
+
+        if (compare) {
+            scenario.apply(reference);
+            reference.simulate(dt, tot_iter, g);
+        }
+    }
+
+    // largest smoke difference and largest colour channel difference of the rendered frame
+    float smokeError = 0.0f;
+    int colorError = 0;
+    if (compare) {
+        const float* smoke = fluid.getSmokeField();
+        const float* expected = reference.getSmokeField();
+        for (int c = 0; c < fluid.getFieldSize(); c++) {
+            smokeError = std::max(smokeError, std::fabs(smoke[c] - expected[c]));
+        }
+        std::vector<std::uint8_t> expectedRgba(rgba.size(), 255);
+        colorizer.fill(reference.getPressureField(), reference.getSmokeField(), expectedRgba.data());
+        for (size_t k = 0; k < rgba.size(); k++) {
+            colorError = std::max(colorError, std::abs(rgba[k] - expectedRgba[k]));
+        }
+    }
+
+    double stepMs = 0.0;
+    std::cout << std::setw(6) << n << std::setw(8) << fluid.getNumThreads()
+              << std::setw(9) << smokeStorageName(smokeStorage) << std::setw(8) << scalarCount;
+    for (int s = 0; s < STAGE_COUNT; s++) {
+        double ms = total[s] / steps;
+        stepMs += ms;
+        std::cout << std::setw(14) << ms;
+    }
+    double cellSteps = static_cast<double>(n) * n;
+    std::cout << std::setw(14) << stepMs
+              << std::setw(14) << cellSteps / (stepMs * 1e-3) / 1e6
+              << std::setw(14) << renderMs / steps
+              << std::setw(10) << fluid.getFieldBytes() / (1024.0 * 1024.0)
+              << std::setw(12) << std::setprecision(6) << smokeError << std::setprecision(3)
+              << std::setw(7) << colorError << std::endl;
+}
+
+// whole steps of one solver, ms per step
+template <typename FluidType>
+static double timeSteps(FluidType& fluid, const Scenario& scenario, int steps, int warmup, int tot_iter) {
+    float g = 9.81f;
+    float dt = 1.0f / 60.0f;
+    for (int step = 0; step < warmup; step++) {
+        scenario.apply(fluid);
+        fluid.simulate(dt, tot_iter, g);
+    }
+    Clock::time_point t = Clock::now();
+    for (int step = 0; step < steps; step++) {
+        scenario.apply(fluid);
+        fluid.simulate(dt, tot_iter, g);
+    }
+    return elapsedMs(t) / steps;
+}
+
+static double smokeAt(Fluid& fluid, int i, int j) {
+    return fluid.getSmokeField()[i * fluid.getStride() + j];
+}
+
+template <typename Scalar, int W, int H, typename Layout>
+static double smokeAt(FluidT<Scalar, W, H, Layout>& fluid, int i, int j) {
+    return fluid.getSmokeField()[fluid.index(i, j)];
+}
+
+// largest smoke difference of two runs over the interior cells
+template <typename FluidA, typename FluidB>
+static double smokeDifference(FluidA& a, FluidB& b) {
+    double error = 0.0;
+    for (int i = 1; i <= a.getWidth(); i++) {
+        for (int j = 1; j <= a.getHeight(); j++) {
+            double da = smokeAt(a, i, j);
+            double db = smokeAt(b, i, j);
+            error = std::max(error, std::fabs(da - db));
+        }
+    }
+    return error;
+}
+
+// Gauss-Seidel steps of Fluid next to the FluidT specializations of the same grid: the
+// dynamic float template, the fixed size float one (sizes N are the instantiated ones),
+// fixed size double and fixed size float in 32 x 32 tiles. dm double is the smoke
+// difference of float to double, dm tiled of the tiled run to the flat one (0, the layout
+// does not change the result)
+template <int N>
+static void benchTemplatedGrid(int steps, int warmup, int tot_iter, ScenarioType scenarioType, SimdLevel simdLevel) {
+    Scenario scenario(N, N, scenarioType);
+
+    Fluid fluid(N, N, 9.81f, 1.0f, 1.9f);
+    fluid.setSimdLevel(SimdLevel::Scalar);
+    scenario.setup(fluid);
+    Fluid vectorFluid(fluid);
+    vectorFluid.setSimdLevel(simdLevel);
+    FluidT<float> dynamicFluid(N, N, 9.81f, 1.0f, 1.9f);
+    scenario.setup(dynamicFluid);
+    FluidT<float, N, N> fixedFluid(N, N, 9.81f, 1.0f, 1.9f);
+    scenario.setup(fixedFluid);
+    FluidT<double, N, N> doubleFluid(N, N, 9.81, 1.0, 1.9);
+    scenario.setup(doubleFluid);
+    FluidT<float, N, N, TiledLayout<32>> tiledFluid(N, N, 9.81f, 1.0f, 1.9f);
+    scenario.setup(tiledFluid);
+
+    double ms[6];
+    ms[0] = timeSteps(fluid, scenario, steps, warmup, tot_iter);
+    ms[1] = timeSteps(vectorFluid, scenario, steps, warmup, tot_iter);
+    ms[2] = timeSteps(dynamicFluid, scenario, steps, warmup, tot_iter);
+    ms[3] = timeSteps(fixedFluid, scenario, steps, warmup, tot_iter);
+    ms[4] = timeSteps(doubleFluid, scenario, steps, warmup, tot_iter);
+    ms[5] = timeSteps(tiledFluid, scenario, steps, warmup, tot_iter);
+
+    std::cout << std::setw(6) << N;
+    for (double value : ms) {
+        std::cout << std::setw(14) << value;
+    }
+    // the float template has to reproduce the scalar loops exactly
+    std::cout << std::setw(14) << smokeDifference(fluid, fixedFluid)
+              << std::setw(14) << std::setprecision(6) << smokeDifference(fixedFluid, doubleFluid)
+              << std::setw(14) << smokeDifference(fixedFluid, tiledFluid)
+              << std::setprecision(3) << std::endl;
+}
+
+static bool benchTemplated(int n, int steps, int warmup, int tot_iter, ScenarioType scenarioType, SimdLevel simdLevel) {
+    switch (n) {
+        case 64:
+            benchTemplatedGrid<64>(steps, warmup, tot_iter, scenarioType, simdLevel);
+            return true;
+        case 128:
+            benchTemplatedGrid<128>(steps, warmup, tot_iter, scenarioType, simdLevel);
+            return true;
+        case 256:
+            benchTemplatedGrid<256>(steps, warmup, tot_iter, scenarioType, simdLevel);
+            return true;
+        case 512:
+            benchTemplatedGrid<512>(steps, warmup, tot_iter, scenarioType, simdLevel);
+            return true;
+        case 1024:
+            benchTemplatedGrid<1024>(steps, warmup, tot_iter, scenarioType, simdLevel);
+            return true;
+        case 2048:
+            benchTemplatedGrid<2048>(steps, warmup, tot_iter, scenarioType, simdLevel);
+            return true;
+    }
+    return false;
+}
+
+// the scenario on an n x n grid with the demo's speeds scaled to it, so every size sees the
+// same flow in units of the box (the demo is 100 cells across). particlesPerCell turns on
+// FLIP once the scenario is set up
+static void runScaled(Fluid& fluid, int n, ScenarioType scenarioType, int steps, int tot_iter,
+                      int particlesPerCell = 0) {
+    float scale = n / 100.0f;
+    float g = 9.81f * scale;
+    Scenario scenario(n, n, scenarioType);
+    scenario.setInflowSpeed(200.0f * scale);
+    scenario.setup(fluid);
+    if (particlesPerCell > 0) {
+        fluid.setFlip(particlesPerCell);
+    }
+    for (int step = 0; step < steps; step++) {
+        scenario.apply(fluid);
+        fluid.simulate(1.0f / 60.0f, tot_iter, g);
+    }
+}
+
+// a square of smoke, n/4 cells on a side, carried by a uniform flow for 2 s (120 steps of
+// advectSmoke alone) by n/2 cells right and n/4 up. The exact answer is the same square
+// moved by whole cells, so the error is measured against that: sum |m - exact| / sum exact.
+// sharpness is sum(m^2) / sum(m), 1 for the exact square and lower the more it is smeared.
+// With smoke detail the square is carried on the fine grid and scored after the box filter
+static void transportError(int n, AdvectionScheme scheme, SimdLevel simdLevel, double& error, double& sharpness,
+                           int smokeFactor = 1) {
+    int steps = 120;
+    float dt = 1.0f / 60.0f;
+    int side = n / 4;
+    int shiftX = n / 2;
+    int shiftY = n / 4;
+
+    Fluid fluid(n, n, 0.0f, 1.0f, 1.9f);
+    fluid.setSimdLevel(simdLevel);
+    fluid.setAdvectionScheme(scheme);
+    fluid.setSmokeResolution(smokeFactor);
+    fluid.setFluidRect(1, 1, n + 1, n + 1, 1);
+    fluid.fillRect(FieldType::U, 0, 0, n + 2, n + 2, shiftX / (steps * dt));
+    fluid.fillRect(FieldType::V, 0, 0, n + 2, n + 2, shiftY / (steps * dt));
+    int x0 = n / 8 + 1;
+    int y0 = n / 8 + 1;
+    fluid.fillRect(FieldType::Smoke, x0, y0, x0 + side, y0 + side, 1.0f);
+
+    for (int step = 0; step < steps; step++) {
+        fluid.advectSmoke(dt);
+    }
+
+    double difference = 0.0;
+    double mass = 0.0;
+    double squares = 0.0;
+    for (int i = 1; i <= n; i++) {
+        for (int j = 1; j <= n; j++) {
+            double m = smokeAt(fluid, i, j);
+            bool inside = i >= x0 + shiftX && i < x0 + shiftX + side && j >= y0 + shiftY && j < y0 + shiftY + side;
+            difference += std::fabs(m - (inside ? 1.0 : 0.0));
+            mass += m;
+            squares += m * m;
+        }
+    }
+    error = difference / (static_cast<double>(side) * side);
+    sharpness = mass > 0.0 ? squares / mass : 0.0;
+}
+
+// cost and quality of the advection schemes across grid sizes. step and advect (velocity
+// plus smoke) are timed on the scaled scenario; error and sharpness come from the transport
+// test above, where the exact answer is known
+static void benchAdvection(const std::vector<int>& sizes, int steps, int tot_iter, ScenarioType scenarioType,
+                           SimdLevel simdLevel) {
+    const AdvectionScheme schemes[3] = {AdvectionScheme::SemiLagrangian, AdvectionScheme::MacCormack, AdvectionScheme::Bfecc};
+
+    for (int n : sizes) {
+        if (n <= 0 || n % 8 != 0) {
+            std::cerr << "skipping " << n << ", the transport test needs a multiple of 8" << std::endl;
+            continue;
+        }
+        for (AdvectionScheme scheme : schemes) {
+            Fluid fluid(n, n, 9.81f, 1.0f, 1.9f);
+            fluid.setSimdLevel(simdLevel);
+            fluid.setAdvectionScheme(scheme);
+            fluid.setProfiling(true, steps);
+            Clock::time_point t = Clock::now();
+            runScaled(fluid, n, scenarioType, steps, tot_iter);
+            double stepMs = elapsedMs(t) / steps;
+
+            FluidProfile profile;
+            fluid.getProfile(profile);
+            double advectMs = profile.stages[static_cast<int>(StepStage::Advect)].meanMs
+                            + profile.stages[static_cast<int>(StepStage::AdvectSmoke)].meanMs;
+
+            double error, sharpness;
+            transportError(n, scheme, simdLevel, error, sharpness);
+
+            std::cout << std::setw(6) << n << std::setw(12) << advectionSchemeName(scheme)
+                      << std::setw(14) << stepMs << std::setw(14) << advectMs
+                      << std::setw(14) << error << std::setw(14) << sharpness << std::endl;
+        }
+    }
+}
+
+// smoke detail against plain grids: step and advectSmoke times on the scaled scenario, error
+// and sharpness from the transport test. Factor f on n cells is meant to be read against
+// factor 1 on n * f cells, which carries the same smoke detail
+static void benchSmokeResolution(const std::vector<int>& sizes, const std::vector<int>& factors, int steps,
+                                 int tot_iter, ScenarioType scenarioType, SimdLevel simdLevel) {
+    for (int n : sizes) {
+        if (n <= 0 || n % 8 != 0) {
+            std::cerr << "skipping " << n << ", the transport test needs a multiple of 8" << std::endl;
+            continue;
+        }
+        for (int factor : factors) {
+            Fluid fluid(n, n, 9.81f, 1.0f, 1.9f);
+            fluid.setSimdLevel(simdLevel);
+            fluid.setSmokeResolution(factor);
+            fluid.setProfiling(true, steps);
+            Clock::time_point t = Clock::now();
+            runScaled(fluid, n, scenarioType, steps, tot_iter);
+            double stepMs = elapsedMs(t) / steps;
+
+            FluidProfile profile;
+            fluid.getProfile(profile);
+
+            double error, sharpness;
+            transportError(n, AdvectionScheme::SemiLagrangian, simdLevel, error, sharpness, factor);
+
+            std::cout << std::setw(6) << n << std::setw(8) << fluid.getSmokeResolution()
+                      << std::setw(14) << stepMs
+                      << std::setw(14) << profile.stages[static_cast<int>(StepStage::AdvectSmoke)].meanMs
+                      << std::setw(14) << error << std::setw(14) << sharpness << std::endl;
+        }
+    }
+}
+
+static double kineticEnergy(Fluid& fluid) {
+    const float* u = fluid.getUField();
+    const float* v = fluid.getVField();
+    int n = fluid.getStride();
+    double energy = 0.0;
+    for (int i = 1; i <= fluid.getWidth(); i++) {
+        for (int j = 1; j <= fluid.getHeight(); j++) {
+            energy += u[i * n + j] * u[i * n + j] + v[i * n + j] * v[i * n + j];
+        }
+    }
+    return energy;
+}
+
+// share of its kinetic energy a 2 x 2 grid of Taylor-Green vortices in a closed n x n box
+// keeps over 240 steps (4 s, about two turns). Nothing drives the flow and the projection
+// is converged, so what goes is lost to the velocity transport: to interpolation on the
+// grid, to the PIC share and the splat with particles
+static double vortexEnergy(int n, int particlesPerCell, SimdLevel simdLevel) {
+    const float pi = 3.14159265f;
+    float speed = n / 2.0f;
+
+    Fluid fluid(n, n, 0.0f, 1.0f, 1.9f, PressureSolver::ConjugateGradient);
+    fluid.setSimdLevel(simdLevel);
+    fluid.setSolverTolerance(1e-4f, 500);
+    fluid.setFluidRect(1, 1, n + 1, n + 1, 1);
+    for (int i = 2; i <= n; i++) {
+        for (int j = 1; j <= n; j++) {
+            float x = (i - 1) / static_cast<float>(n);
+            float y = (j - 0.5f) / n;
+            fluid.setU(i, j, speed * std::sin(2 * pi * x) * std::cos(2 * pi * y));
+        }
+    }
+    for (int i = 1; i <= n; i++) {
+        for (int j = 2; j <= n; j++) {
+            float x = (i - 0.5f) / n;
+            float y = (j - 1) / static_cast<float>(n);
+            fluid.setV(i, j, -speed * std::cos(2 * pi * x) * std::sin(2 * pi * y));
+        }
+    }
+    // project the discrete field once, so the start is divergence free on this grid
+    fluid.simulate(1e-6f, 100, 0.0f);
+    fluid.setFlip(particlesPerCell);
+
+    double start = kineticEnergy(fluid);
+    for (int step = 0; step < 240; step++) {
+        fluid.simulate(1.0f / 60.0f, 60, 0.0f);
+    }
+    return start > 0.0 ? kineticEnergy(fluid) / start : 0.0;
+}
+
+// FLIP against the grid (0 particles per cell, semi-Lagrangian): step, particle-to-grid and
+// advect (grid-to-particle and moves with FLIP) times on the scaled scenario for every thread
+// count of the transfers, and the energy the vortex test keeps
+static void benchFlip(const std::vector<int>& sizes, const std::vector<int>& counts, const std::vector<int>& threads,
+                      int steps, int tot_iter, ScenarioType scenarioType, SimdLevel simdLevel) {
+    for (int n : sizes) {
+        if (n <= 0) {
+            continue;
+        }
+        for (int particlesPerCell : counts) {
+            double energy = vortexEnergy(n, particlesPerCell, simdLevel);
+            for (int numThreads : threads) {
+                Fluid fluid(n, n, 9.81f, 1.0f, 1.9f, PressureSolver::GaussSeidel, numThreads);
+                fluid.setSimdLevel(simdLevel);
+                fluid.setProfiling(true, steps);
+                Clock::time_point t = Clock::now();
+                runScaled(fluid, n, scenarioType, steps, tot_iter, particlesPerCell);
+                double stepMs = elapsedMs(t) / steps;
+
+                FluidProfile profile;
+                fluid.getProfile(profile);
+
+                std::cout << std::setw(6) << n << std::setw(6) << particlesPerCell << std::setw(8) << fluid.getNumThreads()
+                          << std::setw(14) << stepMs
+                          << std::setw(16) << profile.stages[static_cast<int>(StepStage::ParticleToGrid)].meanMs
+                          << std::setw(14) << profile.stages[static_cast<int>(StepStage::Advect)].meanMs
+                          << std::setw(12) << fluid.getParticleCount() << std::setw(10) << energy << std::endl;
+                if (particlesPerCell == 0) {
+                    // the grid does not use the threads
+                    break;
+                }
+            }
+        }
+    }
+}
+
+// whole Gauss-Seidel steps with the plain sweeps (depth 0) and with temporal blocking of
+// each depth. MB is the field traffic per step the profiler estimates, dm the largest smoke
+// difference to the plain sweeps (0, blocking only reorders independent updates)
+static void benchBlocking(int n, const std::vector<int>& depths, int steps, int warmup, int tot_iter,
+                          ScenarioType scenarioType, SimdLevel simdLevel) {
+    Scenario scenario(n, n, scenarioType);
+    Fluid start(n, n, 9.81f, 1.0f, 1.9f);
+    start.setSimdLevel(simdLevel);
+    scenario.setup(start);
+    Fluid plain(start);
+
+    std::vector<int> sweep = {0};
+    sweep.insert(sweep.end(), depths.begin(), depths.end());
+    for (int depth : sweep) {
+        // depth 0 runs on plain itself, the rest compare against it
+        Fluid blocked(start);
+        Fluid& fluid = depth == 0 ? plain : blocked;
+        fluid.setTemporalBlocking(depth);
+        fluid.setProfiling(true, steps);
+        double stepMs = timeSteps(fluid, scenario, steps, warmup, tot_iter);
+
+        FluidProfile profile;
+        fluid.getProfile(profile);
+        double bytes = 0.0;
+        for (int k = 0; k < STEP_STAGE_COUNT; k++) {
+            if (profile.stages[k].samples > 0) {
+                bytes += profile.stages[k].bytes;
+            }
+        }
+
+        std::cout << std::setw(6) << n << std::setw(8) << depth << std::setw(14) << stepMs
+                  << std::setw(14) << profile.stages[static_cast<int>(StepStage::Pressure)].meanMs
+                  << std::setw(14) << bytes / (1024.0 * 1024.0)
+                  << std::setw(14) << smokeDifference(plain, fluid) << std::endl;
+    }
+}
+
+int main(int argc, char** argv) {
+    std::vector<int> sizes = {64, 128, 256, 512};
+    int steps = 20;
+    int warmup = 5;
+    int tot_iter = 20;
+    ScenarioType scenarioType = ScenarioType::JetCircle;
+    PressureSolver solver = PressureSolver::GaussSeidel;
+    std::vector<int> threads = {0};
+    SimdLevel simdLevel = detectSimdLevel();
+    std::vector<SmokeStorage> smokeStorages = {SmokeStorage::Float32};
+    std::vector<int> scalarCounts = {0};
+    bool templated = false;
+    bool advection = false;
+    std::vector<int> blockingDepths;
+    std::vector<int> smokeFactors;
+    std::vector<int> flipCounts;
+    bool sizesGiven = false;
+    bool stepsGiven = false;
+
+    for (int a = 1; a < argc; a += 2) {
+        std::string arg = argv[a];
+        if (arg == "--templated") {
+            // a flag, no value
+            templated = true;
+            a--;
+            continue;
+        }
+        if (arg == "--advection") {
+            advection = true;
+            a--;
+            continue;
+        }
+        if (a + 1 >= argc) {
+            std::cerr << "missing value for " << arg << std::endl;
+            return 1;
+        }
+        std::string value = argv[a + 1];
+        if (arg == "--sizes") {
+            sizes = parseList(value);
+            sizesGiven = true;
+        } else if (arg == "--threads") {
+            // a list gives a scaling sweep, e.g. --solver rb --threads 1,2,4,8
+            threads = parseList(value);
+        } else if (arg == "--solver") {
+            if (!parsePressureSolver(value, solver)) {
+                std::cerr << "unknown solver: " << value << std::endl;
+                return 1;
+            }
+        } else if (arg == "--simd") {
+            if (!parseSimdLevel(value, simdLevel) || simdLevel > detectSimdLevel()) {
+                std::cerr << "unsupported simd level: " << value << std::endl;
+                return 1;
+            }
+        } else if (arg == "--smoke") {
+            // a list compares storages, e.g. --smoke float32,float16,unorm8
+            smokeStorages.clear();
+            for (const std::string& name : splitList(value)) {
+                SmokeStorage storage;
+                if (!parseSmokeStorage(name, storage)) {
+                    std::cerr << "unknown smoke storage: " << name << std::endl;
+                    return 1;
+                }
+                smokeStorages.push_back(storage);
+            }
+        } else if (arg == "--blocking") {
+            // temporal blocking depths to compare with the plain sweeps, e.g. --blocking 4,8,16
+            blockingDepths = parseList(value);
+        } else if (arg == "--smoke-resolution") {
+            // smoke detail factors, e.g. --smoke-resolution 1,2,4
+            smokeFactors = parseList(value);
+        } else if (arg == "--flip") {
+            // particles per cell, 0 for the grid, e.g. --flip 0,4,8 (with --threads 1,2,4)
+            flipCounts = parseList(value);
+        } else if (arg == "--scalars") {
+            // a list sweeps the number of passive scalars, e.g. --scalars 0,1,4,8
+            scalarCounts = parseList(value);
+        } else if (arg == "--steps") {
+            steps = std::atoi(value.c_str());
+            stepsGiven = true;
+        } else if (arg == "--warmup") {
+            warmup = std::atoi(value.c_str());
+        } else if (arg == "--iters") {
+            tot_iter = std::atoi(value.c_str());
+        } else if (arg == "--scenario") {
+            if (!Scenario::parse(value, scenarioType)) {
+                std::cerr << "unknown scenario: " << value << std::endl;
+                return 1;
+            }
+        } else {
+            std::cerr << "unknown option: " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    if (steps <= 0) {
+        std::cerr << "--steps must be positive" << std::endl;
+        return 1;
+    }
+
+    if (advection) {
+        // the transport test needs sizes divisible by 8
+        if (!sizesGiven) {
+            sizes = {64, 128, 256};
+        }
+        if (!stepsGiven) {
+            steps = 60;
+        }
+        std::cout << "scenario " << Scenario::name(scenarioType)
+                  << ", solver gs, " << steps << " steps, " << tot_iter << " iters"
+                  << " (ms per step)" << std::endl;
+        std::cout << std::fixed << std::setprecision(3);
+        std::cout << std::setw(6) << "n" << std::setw(12) << "advection" << std::setw(14) << "step"
+                  << std::setw(14) << "advect" << std::setw(14) << "error" << std::setw(14) << "sharpness" << std::endl;
+        benchAdvection(sizes, steps, tot_iter, scenarioType, simdLevel);
+        return 0;
+    }
+
+    if (!smokeFactors.empty()) {
+        if (!sizesGiven) {
+            sizes = {64, 128, 256};
+        }
+        if (!stepsGiven) {
+            steps = 60;
+        }
+        std::cout << "scenario " << Scenario::name(scenarioType)
+                  << ", solver gs, " << steps << " steps, " << tot_iter << " iters"
+                  << " (ms per step)" << std::endl;
+        std::cout << std::fixed << std::setprecision(3);
+        std::cout << std::setw(6) << "n" << std::setw(8) << "factor" << std::setw(14) << "step"
+                  << std::setw(14) << "advectSmoke" << std::setw(14) << "error" << std::setw(14) << "sharpness" << std::endl;
+        benchSmokeResolution(sizes, smokeFactors, steps, tot_iter, scenarioType, simdLevel);
+        return 0;
+    }
+
+    if (!flipCounts.empty()) {
+        if (!sizesGiven) {
+            sizes = {64, 128, 256};
+        }
+        if (!stepsGiven) {
+            steps = 60;
+        }
+        std::cout << "scenario " << Scenario::name(scenarioType)
+                  << ", solver gs, " << steps << " steps, " << tot_iter << " iters"
+                  << " (ms per step)" << std::endl;
+        std::cout << std::fixed << std::setprecision(3);
+        std::cout << std::setw(6) << "n" << std::setw(6) << "ppc" << std::setw(8) << "threads" << std::setw(14) << "step"
+                  << std::setw(16) << "particleToGrid" << std::setw(14) << "advect" << std::setw(12) << "particles"
+                  << std::setw(10) << "energy" << std::endl;
+        benchFlip(sizes, flipCounts, threads, steps, tot_iter, scenarioType, simdLevel);
+        return 0;
+    }
+
+    if (!blockingDepths.empty()) {
+        std::cout << "scenario " << Scenario::name(scenarioType)
+                  << ", solver gs, " << steps << " steps, " << tot_iter << " iters"
+                  << " (ms per step)" << std::endl;
+        std::cout << std::fixed << std::setprecision(3);
+        std::cout << std::setw(6) << "n" << std::setw(8) << "depth" << std::setw(14) << "step"
+                  << std::setw(14) << "pressure" << std::setw(14) << "MB" << std::setw(14) << "dm" << std::endl;
+        for (int n : sizes) {
+            benchBlocking(n, blockingDepths, steps, warmup, tot_iter, scenarioType, simdLevel);
+        }
+        return 0;
+    }
+
+    if (templated) {
+        std::cout << "scenario " << Scenario::name(scenarioType)
+                  << ", solver gs, " << steps << " steps, " << tot_iter << " iters"
+                  << " (ms per step)" << std::endl;
+        std::cout << std::fixed << std::setprecision(3);
+        // Fluid with the scalar loops and with the vector kernels, then FluidT
+        std::cout << std::setw(6) << "n" << std::setw(14) << "Fluid scalar" << std::setw(14) << "Fluid simd"
+                  << std::setw(14) << "T<float>" << std::setw(14) << "T<float,N,N>" << std::setw(14) << "T<double,N,N>"
+                  << std::setw(14) << "T tiled 32" << std::setw(14) << "dm scalar" << std::setw(14) << "dm double"
+                  << std::setw(14) << "dm tiled" << std::endl;
+        for (int n : sizes) {
+            if (!benchTemplated(n, steps, warmup, tot_iter, scenarioType, simdLevel)) {
+                std::cerr << "no fixed size instantiation for " << n << " (64, 128, 256, 512, 1024, 2048)" << std::endl;
+            }
+        }
+        return 0;
+    }
+
+    std::cout << "scenario " << Scenario::name(scenarioType)
+              << ", solver " << pressureSolverName(solver)
+              << ", simd " << simdLevelName(simdLevel)
+              << ", " << steps << " steps, " << tot_iter << " iters"
+              << " (ms per step)" << std::endl;
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << std::setw(6) << "n" << std::setw(8) << "threads" << std::setw(9) << "smoke" << std::setw(8) << "scalars";
+    for (int s = 0; s < STAGE_COUNT; s++) {
+        std::cout << std::setw(14) << stageNames[s];
+    }
+    // fields MB is the arena footprint; max dm / max drgb compare compact smoke to float
+    std::cout << std::setw(14) << "total" << std::setw(14) << "Mcells/s" << std::setw(14) << "colorize"
+              << std::setw(10) << "fields MB" << std::setw(12) << "max dm" << std::setw(7) << "drgb" << std::endl;
+
+    for (int n : sizes) {
+        for (int numThreads : threads) {
+            for (SmokeStorage smokeStorage : smokeStorages) {
+                for (int scalarCount : scalarCounts) {
+                    if (n > 0 && scalarCount >= 0) {
+                        benchGrid(n, steps, warmup, tot_iter, scenarioType, solver, numThreads, simdLevel,
+                                  smokeStorage, scalarCount);
+                    }
+                }
+            }
+        }
+    }
+
+    return 0;
+}
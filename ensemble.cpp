@@ -0,0 +1,211 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <chrono>
+#include "Ensemble.h"
+
+// parameter sweeps: one ensemble member per combination of the listed values, stepped on
+// a work-stealing pool, with a summary line per member
+
+static void printUsage(const char* prog) {
+    std::cout << "usage: " << prog << " [options]\n"
+              << "  lists are comma separated; every combination becomes a member\n"
+              << "  --sizes LIST     interior grid sizes N (N x N, default 64)\n"
+              << "  --overrelax LIST SOR factors (default 1.9)\n"
+              << "  --density LIST   densities (default 1)\n"
+              << "  --inflow LIST    inflow speeds (default 200)\n"
+              << "  --circle-x LIST  circle centre as a fraction of the width (default 0.5)\n"
+              << "  --threads LIST   pool sizes, more than one gives a scaling sweep, 0 = all (default 0)\n"
+              << "  --steps N        steps per member (default 200)\n"
+              << "  --iters N        pressure solver iterations per step (default 20)\n"
+              << "  --scenario NAME  jet | jet-circle | empty (default jet-circle)\n"
+              << "  --solver NAME    gs | rb | cg (default gs)\n"
+              << "  --simd NAME      scalar | generic | avx2 (default: best the CPU supports)\n"
+              << "  --quiet          only the throughput lines, no per-member table\n";
+}
+
+static std::vector<std::string> splitList(const std::string& value) {
+    std::vector<std::string> list;
+    size_t pos = 0;
+    while (pos < value.size()) {
+        size_t comma = value.find(',', pos);
+        if (comma == std::string::npos) comma = value.size();
+        list.push_back(value.substr(pos, comma - pos));
+        pos = comma + 1;
+    }
+    return list;
+}
+
+static std::vector<float> parseFloats(const std::string& value) {
+    std::vector<float> list;
+    for (const std::string& item : splitList(value)) {
+        list.push_back(static_cast<float>(std::atof(item.c_str())));
+    }
+    return list;
+}
+
+static std::vector<int> parseInts(const std::string& value) {
+    std::vector<int> list;
+    for (const std::string& item : splitList(value)) {
+        list.push_back(std::atoi(item.c_str()));
+    }
+    return list;
+}
+
+int main(int argc, char** argv) {
+    std::vector<int> sizes = {64};
+    std::vector<float> overrelaxes = {1.9f};
+    std::vector<float> densities = {1.0f};
+    std::vector<float> inflows = {200.0f};
+    std::vector<float> circleXs = {0.5f};
+    std::vector<int> threads = {0};
+    int steps = 200;
+    int tot_iter = 20;
+    ScenarioType scenarioType = ScenarioType::JetCircle;
+    PressureSolver solver = PressureSolver::GaussSeidel;
+    SimdLevel simdLevel = detectSimdLevel();
+    bool quiet = false;
+
+    for (int a = 1; a < argc; a++) {
+        std::string arg = argv[a];
+        if (arg == "--help" || arg == "-h") {
+            printUsage(argv[0]);
+            return 0;
+        }
+        if (arg == "--quiet") {
+            quiet = true;
+            continue;
+        }
+        if (a + 1 >= argc) {
+            std::cerr << "missing value for " << arg << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+        std::string value = argv[++a];
+        if (arg == "--sizes") {
+            sizes = parseInts(value);
+        } else if (arg == "--overrelax") {
+            overrelaxes = parseFloats(value);
+        } else if (arg == "--density") {
+            densities = parseFloats(value);
+        } else if (arg == "--inflow") {
+            inflows = parseFloats(value);
+        } else if (arg == "--circle-x") {
+            circleXs = parseFloats(value);
+        } else if (arg == "--threads") {
+            threads = parseInts(value);
+        } else if (arg == "--steps") {
+            steps = std::atoi(value.c_str());
+        } else if (arg == "--iters") {
+            tot_iter = std::atoi(value.c_str());
+        } else if (arg == "--scenario") {
+            if (!Scenario::parse(value, scenarioType)) {
+                std::cerr << "unknown scenario: " << value << std::endl;
+                return 1;
+            }
+        } else if (arg == "--solver") {
+            if (!parsePressureSolver(value, solver)) {
+                std::cerr << "unknown solver: " << value << std::endl;
+                return 1;
+            }
+        } else if (arg == "--simd") {
+            if (!parseSimdLevel(value, simdLevel) || simdLevel > detectSimdLevel()) {
+                std::cerr << "unsupported simd level: " << value << std::endl;
+                return 1;
+            }
+        } else {
+            std::cerr << "unknown option: " << arg << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (steps <= 0 || tot_iter < 0) {
+        std::cerr << "--steps must be positive" << std::endl;
+        return 1;
+    }
+
+    std::vector<EnsembleMember> members;
+    for (int n : sizes) {
+        if (n <= 0) {
+            continue;
+        }
+        for (float overrelax : overrelaxes) {
+            for (float density : densities) {
+                for (float inflow : inflows) {
+                    for (float circleX : circleXs) {
+                        EnsembleMember member;
+                        member.width = n;
+                        member.height = n;
+                        member.scenario = scenarioType;
+                        member.solver = solver;
+                        member.overrelax = overrelax;
+                        member.density = density;
+                        member.inflowSpeed = inflow;
+                        // the scenario's circle, moved along x
+                        member.circleX = n * circleX;
+                        member.circleY = n * 0.5f;
+                        member.circleRadius = n * 0.0375f;
+                        members.push_back(member);
+                    }
+                }
+            }
+        }
+    }
+
+    double cellSteps = 0.0;
+    for (const EnsembleMember& member : members) {
+        cellSteps += static_cast<double>(member.width) * member.height * steps;
+    }
+
+    std::cout << members.size() << " members, scenario " << Scenario::name(scenarioType)
+              << ", solver " << pressureSolverName(solver)
+              << ", simd " << simdLevelName(simdLevel)
+              << ", " << steps << " steps, " << tot_iter << " iters" << std::endl;
+    std::cout << std::fixed << std::setprecision(3);
+
+    double baseSeconds = 0.0;
+    for (size_t t = 0; t < threads.size(); t++) {
+        // a fresh ensemble per pool size, so every run steps the same members from the start
+        Ensemble ensemble(threads[t]);
+        ensemble.setSimdLevel(simdLevel);
+        for (const EnsembleMember& member : members) {
+            ensemble.add(member);
+        }
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        ensemble.run(steps, 1.0f / 60.0f, tot_iter);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (t == 0) {
+            baseSeconds = seconds;
+        }
+
+        std::cout << "threads " << std::setw(3) << ensemble.getNumThreads()
+                  << "  " << std::setw(9) << seconds << " s"
+                  << "  " << std::setw(10) << cellSteps / seconds / 1e6 << " Mcells*steps/s"
+                  << "  speedup " << std::setw(6) << baseSeconds / seconds
+                  << "  steals " << ensemble.stealCount() << std::endl;
+
+        if (quiet || t + 1 < threads.size()) {
+            continue;
+        }
+        std::cout << std::setw(6) << "n" << std::setw(10) << "overrelax" << std::setw(9) << "density"
+                  << std::setw(9) << "inflow" << std::setw(9) << "circle x"
+                  << std::setw(11) << "ms/step" << std::setw(14) << "mean p" << std::setw(12) << "max div"
+                  << std::setw(12) << "smoke" << std::setw(12) << "outflow" << std::endl;
+        for (int k = 0; k < ensemble.size(); k++) {
+            const EnsembleMember& member = ensemble.getMember(k);
+            const EnsembleStats& stats = ensemble.getStats(k);
+            std::cout << std::setw(6) << member.width << std::setw(10) << member.overrelax
+                      << std::setw(9) << member.density << std::setw(9) << member.inflowSpeed
+                      << std::setw(9) << member.circleX
+                      << std::setw(11) << stats.stepMs << std::setw(14) << stats.meanPressure
+                      << std::setw(12) << stats.maxDivergence << std::setw(12) << stats.totalSmoke
+                      << std::setw(12) << stats.smokeOutflow << std::endl;
+        }
+    }
+
+    return 0;
+}
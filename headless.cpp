@@ -0,0 +1,442 @@
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <string>
+#include <cstdlib>
+#include <chrono>
+#include "Fluid.h"
+#include "Scenario.h"
+#include "FrameRecorder.h"
+#include "CheckpointWriter.h"
+#include "DecomposedFluid.h"
+
+// render-less runner for compute nodes: steps a scenario and reports throughput
+
+static void printUsage(const char* prog) {
+    std::cout << "usage: " << prog << " [options]\n"
+              << "  --width N        interior grid width (default 100)\n"
+              << "  --height N       interior grid height (default 100)\n"
+              << "  --steps N        number of simulate() calls (default 600)\n"
+              << "  --iters N        pressure solver iterations per step (default 20)\n"
+              << "  --dt X           time step (default 1/60)\n"
+              << "  --scenario NAME  jet | jet-circle | empty (default jet-circle)\n"
+              << "  --solver NAME    gs | rb | cg, pressure solver (default gs)\n"
+              << "  --blocking N     gs: run N SOR iterations per pass over the grid (temporal blocking), 0 = off (default 0)\n"
+              << "  --threads N      worker threads for the rb solver, 0 = all (default 0)\n"
+              << "  --tol X          cg residual tolerance, max cell divergence (default 1e-3)\n"
+              << "  --max-iter N     cg iteration cap (default 500)\n"
+              << "  --simd NAME      scalar | generic | avx2 (default: best the CPU supports)\n"
+              << "  --smoke NAME     float32 | float16 | unorm16 | unorm8, smoke storage (default float32)\n"
+              << "  --advection NAME sl | maccormack | bfecc, velocity and smoke advection (default sl)\n"
+              << "  --smoke-resolution F  advect the smoke on F x F cells per velocity cell (default 1)\n"
+              << "  --flip N         carry the velocity on N particles per fluid cell (FLIP / PIC), 0 = off (default 0)\n"
+              << "  --flip-ratio X   FLIP share of the particle update, 1 = pure FLIP, 0 = PIC (default 0.95)\n"
+              << "  --cfl X          adaptive stepping: split each --dt into substeps moving at most X cells, 0 = off (default 0)\n"
+              << "  --max-substeps N substep cap per step with --cfl (default 16)\n"
+              << "  --profile N      time every stage over the last N steps and print a summary, 0 = off (default 0)\n"
+              << "  --trace FILE     write a Chrome trace (chrome://tracing, Perfetto) of every stage to FILE\n"
+              << "  --tiles N        skip quiescent N x N tiles, 0 = off (default 0)\n"
+              << "  --tile-threshold X  velocity / smoke magnitude that keeps a tile active (default 1e-4)\n"
+              << "  --record FILE    stream u, v, p and smoke into FILE (read back with RecordingReader)\n"
+              << "  --record-every N record every Nth step (default 1)\n"
+              << "  --record-compression NAME  none | delta | lz (default lz)\n"
+              << "  --checkpoint FILE   write a restartable checkpoint to FILE in the background\n"
+              << "  --checkpoint-every N  steps between checkpoints (default 100)\n"
+              << "  --restart FILE   continue from a checkpoint; grid, solver, tile, smoke and FLIP settings come from FILE\n"
+              << "  --domains N      split the grid into N column strips stepped by their own threads (rb only)\n"
+              << "  --halo N         halo columns per strip side with --domains (default 6)\n"
+              << "  --pin 0|1        pin every strip to its share of the CPUs (default 0)\n";
+}
+
+static void printProfile(const FluidProfile& profile) {
+    std::cout << "profile over the last " << std::min<long long>(profile.window, profile.steps) << " of "
+              << profile.steps << " steps, divergence after projection " << profile.divergence << std::endl;
+    std::cout << std::setw(14) << "stage" << std::setw(10) << "mean ms" << std::setw(10) << "p50 ms"
+              << std::setw(10) << "p95 ms" << std::setw(10) << "max ms" << std::setw(12) << "cells"
+              << std::setw(10) << "GB/s" << "  histogram (us, 2^k buckets)" << std::endl;
+    for (int k = 0; k < STEP_STAGE_COUNT; k++) {
+        const StageProfile& stage = profile.stages[k];
+        if (stage.samples == 0) {
+            continue;
+        }
+        double bandwidth = stage.meanMs > 0.0 ? stage.bytes / (stage.meanMs * 1e6) : 0.0;
+        std::cout << std::setw(14) << stepStageName(static_cast<StepStage>(k)) << std::fixed << std::setprecision(3)
+                  << std::setw(10) << stage.meanMs << std::setw(10) << stage.p50Ms
+                  << std::setw(10) << stage.p95Ms << std::setw(10) << stage.maxMs
+                  << std::setw(12) << stage.cells << std::setw(10) << std::setprecision(2) << bandwidth << " ";
+        std::cout.unsetf(std::ios::floatfield);
+        std::cout << std::setprecision(6);
+        for (int b = 0; b < PROFILE_BUCKETS; b++) {
+            if (stage.histogram[b] > 0) {
+                std::cout << " <" << (1L << b) << ":" << stage.histogram[b];
+            }
+        }
+        std::cout << std::endl;
+    }
+}
+
+// --domains: the same scenario on a DecomposedFluid. --threads is per strip, where the
+// default of all CPUs would oversubscribe, so 0 means one
+static int runDecomposed(int width, int height, int steps, int tot_iter, float dt, ScenarioType scenarioType,
+                         SimdLevel simdLevel, int domains, int halo, int numThreads, bool pin) {
+    float g = 9.81f;
+    float density = 1.0f;
+    float overrelax = 1.9f;
+    DecomposedFluid fluid(width, height, g, density, overrelax, domains, halo, std::max(numThreads, 1), pin);
+    if (!fluid.setSimdLevel(simdLevel)) {
+        std::cerr << "simd level " << simdLevelName(simdLevel) << " is not supported here" << std::endl;
+        return 1;
+    }
+
+    Scenario scenario(width, height, scenarioType);
+    scenario.setup(fluid);
+
+    std::cout << "grid " << width << "x" << height
+              << ", steps " << steps
+              << ", iters " << tot_iter
+              << ", scenario " << Scenario::name(scenarioType)
+              << ", solver rb (" << fluid.getThreadsPerRank() << " threads per domain)"
+              << ", simd " << simdLevelName(fluid.getSimdLevel())
+              << ", domains " << fluid.getRanks() << ", halo " << fluid.getHalo() << std::endl;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int step = 0; step < steps; step++) {
+        scenario.apply(fluid);
+        fluid.simulate(dt, tot_iter, g);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    double cellSteps = static_cast<double>(width) * height * steps;
+
+    std::cout << "elapsed " << seconds << " s, "
+              << seconds * 1000.0 / steps << " ms/step, "
+              << cellSteps / seconds << " cells*steps/s" << std::endl;
+    std::cout << "halo overruns " << fluid.getHaloOverruns()
+              << " (domain steps whose backtraces may have left the halo)" << std::endl;
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    int width = 100;
+    int height = 100;
+    int steps = 600;
+    int tot_iter = 20;
+    float dt = 1.0f / 60.0f;
+    ScenarioType scenarioType = ScenarioType::JetCircle;
+    PressureSolver solver = PressureSolver::GaussSeidel;
+    int numThreads = 0;
+    int blocking = 0;
+    float tolerance = 1e-3f;
+    int maxIter = 500;
+    SimdLevel simdLevel = detectSimdLevel();
+    SmokeStorage smokeStorage = SmokeStorage::Float32;
+    int tileSize = 0;
+    float tileThreshold = 1e-4f;
+    AdvectionScheme advection = AdvectionScheme::SemiLagrangian;
+    int smokeFactor = 1;
+    int particlesPerCell = 0;
+    float flipRatio = 0.95f;
+    float cfl = 0.0f;
+    int maxSubsteps = 16;
+    int profileWindow = 0;
+    std::string tracePath;
+    std::string recordPath;
+    RecorderOptions recordOptions;
+    recordOptions.compression = RecordCompression::Lz;
+    std::string checkpointPath;
+    int checkpointEvery = 100;
+    std::string restartPath;
+    int domains = 0;
+    int halo = 6;
+    bool pin = false;
+
+    for (int a = 1; a < argc; a++) {
+        std::string arg = argv[a];
+        if (arg == "--help" || arg == "-h") {
+            printUsage(argv[0]);
+            return 0;
+        }
+        if (a + 1 >= argc) {
+            std::cerr << "missing value for " << arg << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+        std::string value = argv[++a];
+        if (arg == "--width") {
+            width = std::atoi(value.c_str());
+        } else if (arg == "--height") {
+            height = std::atoi(value.c_str());
+        } else if (arg == "--steps") {
+            steps = std::atoi(value.c_str());
+        } else if (arg == "--iters") {
+            tot_iter = std::atoi(value.c_str());
+        } else if (arg == "--dt") {
+            dt = static_cast<float>(std::atof(value.c_str()));
+        } else if (arg == "--scenario") {
+            if (!Scenario::parse(value, scenarioType)) {
+                std::cerr << "unknown scenario: " << value << std::endl;
+                return 1;
+            }
+        } else if (arg == "--solver") {
+            if (!parsePressureSolver(value, solver)) {
+                std::cerr << "unknown solver: " << value << std::endl;
+                return 1;
+            }
+        } else if (arg == "--blocking") {
+            blocking = std::atoi(value.c_str());
+        } else if (arg == "--threads") {
+            numThreads = std::atoi(value.c_str());
+        } else if (arg == "--tol") {
+            tolerance = static_cast<float>(std::atof(value.c_str()));
+        } else if (arg == "--max-iter") {
+            maxIter = std::atoi(value.c_str());
+        } else if (arg == "--simd") {
+            if (!parseSimdLevel(value, simdLevel)) {
+                std::cerr << "unknown simd level: " << value << std::endl;
+                return 1;
+            }
+        } else if (arg == "--smoke") {
+            if (!parseSmokeStorage(value, smokeStorage)) {
+                std::cerr << "unknown smoke storage: " << value << std::endl;
+                return 1;
+            }
+        } else if (arg == "--advection") {
+            if (!parseAdvectionScheme(value, advection)) {
+                std::cerr << "unknown advection scheme: " << value << std::endl;
+                return 1;
+            }
+        } else if (arg == "--smoke-resolution") {
+            smokeFactor = std::atoi(value.c_str());
+        } else if (arg == "--flip") {
+            particlesPerCell = std::atoi(value.c_str());
+        } else if (arg == "--flip-ratio") {
+            flipRatio = static_cast<float>(std::atof(value.c_str()));
+        } else if (arg == "--cfl") {
+            cfl = static_cast<float>(std::atof(value.c_str()));
+        } else if (arg == "--max-substeps") {
+            maxSubsteps = std::atoi(value.c_str());
+        } else if (arg == "--profile") {
+            profileWindow = std::atoi(value.c_str());
+        } else if (arg == "--trace") {
+            tracePath = value;
+        } else if (arg == "--tiles") {
+            tileSize = std::atoi(value.c_str());
+        } else if (arg == "--tile-threshold") {
+            tileThreshold = static_cast<float>(std::atof(value.c_str()));
+        } else if (arg == "--record") {
+            recordPath = value;
+        } else if (arg == "--record-every") {
+            recordOptions.every = std::atoi(value.c_str());
+        } else if (arg == "--record-compression") {
+            if (!parseRecordCompression(value, recordOptions.compression)) {
+                std::cerr << "unknown compression: " << value << std::endl;
+                return 1;
+            }
+        } else if (arg == "--checkpoint") {
+            checkpointPath = value;
+        } else if (arg == "--checkpoint-every") {
+            checkpointEvery = std::atoi(value.c_str());
+        } else if (arg == "--restart") {
+            restartPath = value;
+        } else if (arg == "--domains") {
+            domains = std::atoi(value.c_str());
+        } else if (arg == "--halo") {
+            halo = std::atoi(value.c_str());
+        } else if (arg == "--pin") {
+            pin = std::atoi(value.c_str()) != 0;
+        } else {
+            std::cerr << "unknown option: " << arg << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (width <= 0 || height <= 0 || steps <= 0 || tot_iter < 0) {
+        std::cerr << "grid size and step count must be positive" << std::endl;
+        return 1;
+    }
+
+    if (domains > 0) {
+        if (solver != PressureSolver::RedBlack || tileSize > 0 || smokeStorage != SmokeStorage::Float32
+            || advection != AdvectionScheme::SemiLagrangian || smokeFactor > 1 || particlesPerCell > 0
+            || !recordPath.empty() || !checkpointPath.empty() || !restartPath.empty()) {
+            std::cerr << "--domains needs --solver rb and no tiles, compact smoke, --advection, --smoke-resolution, --flip, recording or checkpoints" << std::endl;
+            return 1;
+        }
+        if (halo < 1) {
+            std::cerr << "--halo must be positive" << std::endl;
+            return 1;
+        }
+        return runDecomposed(width, height, steps, tot_iter, dt, scenarioType, simdLevel, domains, halo, numThreads, pin);
+    }
+
+    float g = 9.81f;
+    float density = 1.0f;
+    float overrelax = 1.9f;
+    Fluid fluid(width, height, g, density, overrelax, solver, numThreads);
+    fluid.setSolverTolerance(tolerance, maxIter);
+    if (!fluid.setSimdLevel(simdLevel)) {
+        std::cerr << "simd level " << simdLevelName(simdLevel) << " is not supported here" << std::endl;
+        return 1;
+    }
+    fluid.setTileTracking(tileSize, tileThreshold);
+    fluid.setAdaptiveStep(cfl, maxSubsteps);
+    fluid.setAdvectionScheme(advection);
+    fluid.setTemporalBlocking(blocking);
+    if (profileWindow > 0 || !tracePath.empty()) {
+        fluid.setProfiling(true, profileWindow > 0 ? profileWindow : 256, !tracePath.empty());
+    }
+    fluid.setSmokeStorage(smokeStorage);
+    fluid.setSmokeResolution(smokeFactor);
+
+    // a restart maps the saved fields in place of the fresh ones; walls and obstacles are
+    // part of them, so the scenario only keeps driving the inflow
+    long firstStep = 0;
+    if (!restartPath.empty()) {
+        if (!fluid.loadCheckpoint(restartPath, &firstStep)) {
+            std::cerr << "could not load checkpoint " << restartPath << std::endl;
+            return 1;
+        }
+        width = fluid.getWidth();
+        height = fluid.getHeight();
+        solver = fluid.getPressureSolver();
+    }
+
+    Scenario scenario(width, height, scenarioType);
+    if (restartPath.empty()) {
+        scenario.setup(fluid);
+        // seeded after the walls and obstacles are in
+        fluid.setFlip(particlesPerCell, flipRatio);
+    }
+
+    std::cout << "grid " << width << "x" << height
+              << ", steps " << steps
+              << ", iters " << tot_iter
+              << ", scenario " << Scenario::name(scenarioType)
+              << ", solver " << pressureSolverName(solver);
+    if (solver == PressureSolver::RedBlack) {
+        std::cout << " (" << fluid.getNumThreads() << " threads)";
+    }
+    if (solver == PressureSolver::GaussSeidel && fluid.getTemporalBlocking() > 1) {
+        std::cout << " (blocking " << fluid.getTemporalBlocking() << ")";
+    }
+    std::cout << ", simd " << simdLevelName(fluid.getSimdLevel());
+    if (fluid.getSmokeStorage() != SmokeStorage::Float32) {
+        std::cout << ", smoke " << smokeStorageName(fluid.getSmokeStorage());
+    }
+    if (fluid.getAdvectionScheme() != AdvectionScheme::SemiLagrangian) {
+        std::cout << ", advection " << advectionSchemeName(fluid.getAdvectionScheme());
+    }
+    if (fluid.getSmokeResolution() > 1) {
+        std::cout << ", smoke resolution " << fluid.getSmokeResolution();
+    }
+    if (fluid.getParticlesPerCell() > 0) {
+        std::cout << ", flip " << fluid.getParticlesPerCell() << " per cell (ratio " << fluid.getFlipRatio()
+                  << ", " << fluid.getParticleCount() << " particles)";
+    }
+    if (fluid.getTileSize() > 0) {
+        std::cout << ", tiles " << fluid.getTileSize();
+    }
+    if (fluid.getCflNumber() > 0.0f) {
+        std::cout << ", cfl " << fluid.getCflNumber() << " (at most " << fluid.getMaxSubsteps() << " substeps)";
+    }
+    if (!restartPath.empty()) {
+        std::cout << ", restarted at step " << firstStep;
+    }
+    std::cout << std::endl;
+
+    // encoding and disk writes happen on the recorder's thread
+    FrameRecorder recorder(width, height, recordOptions);
+    if (!recordPath.empty() && !recorder.open(recordPath)) {
+        std::cerr << "could not create " << recordPath << std::endl;
+        return 1;
+    }
+
+    // the step loop only pays for a copy of the fields, the file is written on another thread
+    CheckpointWriter checkpointer(checkpointEvery);
+    if (!checkpointPath.empty()) {
+        checkpointer.open(checkpointPath);
+    }
+
+    long long pressureIterations = 0;
+    double activeTiles = 0.0;
+    double smokeTiles = 0.0;
+    long long substeps = 0;
+    float smallestDt = dt;
+    float largestCfl = 0.0f;
+    auto start = std::chrono::steady_clock::now();
+    for (int step = 0; step < steps; step++) {
+        scenario.apply(fluid);
+        fluid.simulate(dt, tot_iter, g);
+        pressureIterations += fluid.getStats().pressureIterations;
+        activeTiles += fluid.getStats().activeTileFraction;
+        smokeTiles += fluid.getStats().smokeTileFraction;
+        substeps += fluid.getStats().substeps;
+        smallestDt = std::min(smallestDt, fluid.getStats().substepDt);
+        largestCfl = std::max(largestCfl, fluid.getStats().maxCfl);
+        long current = firstStep + step + 1;
+        if (!recordPath.empty()) {
+            recorder.record(fluid, current, current * dt);
+        }
+        if (!checkpointPath.empty()) {
+            checkpointer.checkpoint(fluid, current);
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    if (!recordPath.empty() && !recorder.close()) {
+        std::cerr << "writing " << recordPath << " failed" << std::endl;
+        return 1;
+    }
+    if (!checkpointPath.empty() && !checkpointer.close()) {
+        std::cerr << "writing " << checkpointPath << " failed" << std::endl;
+        return 1;
+    }
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    double cellSteps = static_cast<double>(width) * height * steps;
+
+    std::cout << "elapsed " << seconds << " s, "
+              << seconds * 1000.0 / steps << " ms/step, "
+              << cellSteps / seconds << " cells*steps/s" << std::endl;
+
+    if (fluid.getCflNumber() > 0.0f) {
+        std::cout << "substeps: " << static_cast<double>(substeps) / steps << " per step, smallest dt "
+                  << smallestDt << ", largest cfl " << largestCfl << std::endl;
+    }
+
+    if (solver == PressureSolver::ConjugateGradient) {
+        std::cout << "cg: " << static_cast<double>(pressureIterations) / steps
+                  << " iterations/step, last residual " << fluid.getStats().pressureResidual << std::endl;
+    }
+
+    if (!recordPath.empty()) {
+        std::cout << "recorded " << recorder.framesWritten() << " frames to " << recordPath
+                  << ", dropped " << recorder.framesDropped() << std::endl;
+    }
+
+    if (!checkpointPath.empty()) {
+        std::cout << "wrote " << checkpointer.checkpointsWritten() << " checkpoints to " << checkpointPath
+                  << ", skipped " << checkpointer.checkpointsSkipped() << std::endl;
+    }
+
+    FluidProfile profile;
+    if (fluid.getProfile(profile)) {
+        printProfile(profile);
+    }
+    if (!tracePath.empty()) {
+        if (!fluid.writeChromeTrace(tracePath)) {
+            std::cerr << "writing " << tracePath << " failed" << std::endl;
+            return 1;
+        }
+        std::cout << "wrote the stage trace to " << tracePath << std::endl;
+    }
+
+    if (fluid.getTileSize() > 0) {
+        std::cout << "tiles: " << 100.0 * activeTiles / steps << "% active, "
+                  << 100.0 * smokeTiles / steps << "% with smoke (average over all steps)" << std::endl;
+    }
+
+    return 0;
+}
@@ -6,6 +6,12 @@
 #include <cmath>
 #include <algorithm>
 #include "Fluid.h"
+#include "Renderer.h"
+#include "SimulationThread.h"
+#include "RecordingReader.h"
+#include <cstdlib>
+#include <memory>
+#include <string>
 
 class DraggableCircle {
 private:
@@ -59,8 +65,90 @@ public:
 
 
 
-int main() {
+// replays a FluidHeadless --record file: space pauses, left / right step 10 frames, home
+// restarts. Frames are decoded straight from the memory-mapped file
+static int playRecording(const std::string& path) {
+    RecordingReader reader;
+    if (!reader.open(path)) {
+        std::cerr << "could not open recording " << path << std::endl;
+        return 1;
+    }
+    const RecordingHeader& header = reader.getHeader();
+    if ((header.fieldMask & RECORD_PRESSURE) == 0 || (header.fieldMask & RECORD_SMOKE) == 0 || reader.frameCount() == 0) {
+        std::cerr << path << " has no pressure / smoke frames to show" << std::endl;
+        return 1;
+    }
+
+    int width = static_cast<int>(header.width);
+    int height = static_cast<int>(header.height);
+    sf::RenderWindow window(sf::VideoMode(sf::Vector2u(800, 600)), "Fluid Simulation - " + path);
+    window.setFramerateLimit(30);
+
+    // recorded fields are packed, one column is height + 2 floats
+    FieldRenderer renderer(width, height, height + 2, 800.0f / width, 600.0f / height);
+    std::vector<float> values;
+
+    long frame = 0;
+    long shown = -1;
+    bool paused = false;
+    while (window.isOpen()) {
+        while (auto event = window.pollEvent()) {
+            if (event->is<sf::Event::Closed>()) {
+                window.close();
+            } else if (const auto* key = event->getIf<sf::Event::KeyPressed>()) {
+                if (key->code == sf::Keyboard::Key::Space) {
+                    paused = !paused;
+                } else if (key->code == sf::Keyboard::Key::Left) {
+                    frame = std::max(frame - 10, 0L);
+                } else if (key->code == sf::Keyboard::Key::Right) {
+                    frame = std::min(frame + 10, reader.frameCount() - 1);
+                } else if (key->code == sf::Keyboard::Key::Home) {
+                    frame = 0;
+                }
+            }
+        }
+
+        if (frame != shown) {
+            if (!reader.readFrame(frame, values)) {
+                std::cerr << "frame " << frame << " is corrupt" << std::endl;
+                return 1;
+            }
+            renderer.update(reader.field(values, RECORD_PRESSURE), reader.field(values, RECORD_SMOKE));
+            shown = frame;
+        }
+
+        window.clear(sf::Color::White);
+        renderer.draw(window);
+        window.display();
+
+        if (!paused) {
+            frame = (frame + 1) % reader.frameCount();
+        }
+    }
+
+    return 0;
+}
+
+int main(int argc, char** argv) {
     std::cout << "start fluid sim" << std::endl;
+
+    // --play FILE: show a recording instead of simulating
+    if (argc > 2 && std::string(argv[1]) == "--play") {
+        return playRecording(argv[2]);
+    }
+
+    // --threaded: step the simulation on its own thread, decoupled from the frame rate
+    // --smoke-resolution F: smoke on F x F cells per velocity cell
+    bool threaded = false;
+    int smokeFactor = 1;
+    for (int k = 1; k < argc; k++) {
+        std::string arg = argv[k];
+        if (arg == "--threaded") {
+            threaded = true;
+        } else if (arg == "--smoke-resolution" && k + 1 < argc) {
+            smokeFactor = std::max(std::atoi(argv[++k]), 1);
+        }
+    }
     
     // Create window
     int width = 100;  
@@ -77,32 +165,44 @@ int main() {
     Fluid *fluid_main = new Fluid(width, height, g, density, overrelax);
 
     // Set up boundary conditions - walls around the domain
-    for(int i = 0; i < width + 2; i++) {
-        for(int j = 0; j < height + 2; j++) {
-            // Set all cells as fluid initially
-            fluid_main->setFluid(i, j, 1);
-            
-            // Set boundary walls as solid
-            if (i == 0 || i == width + 1 || j == 0 || j == height + 1) {
-                fluid_main->setFluid(i, j, 0);  // 0 = solid
-            }
-        }
-    }
-    
+    fluid_main->setFluidRect(0, 0, width + 2, height + 2, 1);
+    fluid_main->setFluidRect(0, 0, 1, height + 2, 0);  // 0 = solid
+    fluid_main->setFluidRect(width + 1, 0, width + 2, height + 2, 0);
+    fluid_main->setFluidRect(0, 0, width + 2, 1, 0);
+    fluid_main->setFluidRect(0, height + 1, width + 2, height + 2, 0);
+
     // Initialize smoke field
-    for(int i = 0; i < width + 2; i++) {
-        for(int j = 0; j < height + 2; j++) {
-            fluid_main->setSmoke(i, j, 0.0f); // maybe wrap in function in Fluid.cpp later...
-        }
-    }
-    
-    
+    fluid_main->fillRect(FieldType::Smoke, 0, 0, width + 2, height + 2, 0.0f);
+
+    // smoke jet through the left wall, applied by every simulate()
+    fluid_main->addInflow(1, 45, 2, 55, 200.0f, 1.0f);
+    fluid_main->setSmokeResolution(smokeFactor);
+
+
+    // cellWidth = 8.0f, cellHeight = 6.0f on the 800x600 window
+    FieldRenderer renderer(width, height, fluid_main->getStride(), 8.0f, 6.0f,
+                           smokeFactor, fluid_main->getFineSmokeStride());
 
     // Create draggable circle
     DraggableCircle circle(30.0f, sf::Vector2f(400, 300), sf::Color::Red);
 
+    // the circle is a registered obstacle, moving it only touches the cells around it
+    int circleId = fluid_main->addCircleObstacle(circle.getPosition().x / 8.0f,
+                                                 circle.getPosition().y / 6.0f,
+                                                 circle.getRadius() / 8.0f);
+
+    // sim thread at a fixed 1/60 s step; obstacle edits reach it through its command queue
+    std::unique_ptr<SimulationThread> sim;
+    float sentCenterX = circle.getPosition().x / 8.0f;
+    float sentCenterY = circle.getPosition().y / 6.0f;
+    bool circleMoving = false;
+    sf::Clock moveClock;
+    if (threaded) {
+        sim.reset(new SimulationThread(*fluid_main, width, height, 1.0f/60.0f, 20, g));
+        sim->start();
+    }
+
     // Main loop
-    int frame = 0;
     while (window.isOpen()) {
         while (auto event = window.pollEvent()) {
             // Window closed
@@ -139,110 +239,49 @@ int main() {
         // Convert circle position from screen coordinates to grid coordinates
         float circleCenterX = circle.getPosition().x / 8.0f;  // cellWidth = 8.0f
         float circleCenterY = circle.getPosition().y / 6.0f;  // cellHeight = 6.0f
-        float circleRadius = circle.getRadius() / 8.0f;       // Approximate radius in grid units
-        
-        // Reset all interior cells to fluid first
-        for(int i = 1; i < width + 1; i++) {
-            for(int j = 1; j < height + 1; j++) {
-                fluid_main->setFluid(i, j, 1);  // 1 = fluid
+
+        if (sim) {
+            // the sim thread keeps the obstacle until the next edit, only send moves.
+            // velocity comes from the wall time between moves, one more post once the
+            // circle stops brings it back to rest.
+            bool moved = circleCenterX != sentCenterX || circleCenterY != sentCenterY;
+            if (moved || circleMoving) {
+                float moveDt = std::max(moveClock.restart().asSeconds(), 1.0f/60.0f);
+                sim->post([=](Fluid& fluid) {
+                    fluid.moveObstacle(circleId, circleCenterX, circleCenterY, moveDt);
+                });
+                sentCenterX = circleCenterX;
+                sentCenterY = circleCenterY;
+                circleMoving = moved;
             }
-        }
-        
-        // set all cells to s = 0 if contained within floor of radius circle
-        for(int i = 1; i < width + 1; i++) {
-            for(int j = 1; j < height + 1; j++) {
-                // Calculate distance from cell center to circle center
-                float dx = (i - 0.5f) - circleCenterX;
-                float dy = (j - 0.5f) - circleCenterY;
-                float distance = std::sqrt(dx*dx + dy*dy);
-                
-                // maybe add compensation factor to avoid boundary showing due to interpolation
-                if (distance <= circleRadius) {
-                    fluid_main->setFluid(i, j, 0);  // 0 = solid boundary
+
+            window.clear(sf::Color::White);
+
+            // draw the newest finished frame, never wait for the solver
+            bool isNew = false;
+            const FieldSnapshot* snapshot = sim->latest(&isNew);
+            if (snapshot != nullptr) {
+                if (isNew) {
+                    renderer.update(snapshot->pressure.data(), snapshot->smoke.data());
                 }
+                renderer.draw(window);
             }
-        }
-        
-        // Set inflow conditions
-        for(int j = 45; j < 55; j++) {
-            fluid_main->setSmoke(1, j, 1.0f); // Set smoke density to 1.0 at inflow
-            fluid_main->setU(1, j, 200.0f); // Set inflow velocity to 20.0 at inflow
-        }
-        // Update fluid simulation frame by frame
-        fluid_main->simulate(1.0f/60.0f, 20, g);
-        frame++;
-        
-        // Get pressure field and smoke field for visualization
-        float* pressureField = fluid_main->getPressureField();
-        float* smokeField = fluid_main->getSmokeField();
-        
-        // Debug: Check smoke values at inflow
-        if (frame == 0) {
-            std::cout << "Initial smoke values at inflow:" << std::endl;
-            for(int j = 40; j < 60; j++) {
-                int index = 1 * (height + 2) + j;
-                std::cout << "Smoke[" << 1 << "," << j << "] = " << smokeField[index] << std::endl;
-            }
-        }
-        
-        
-        window.clear(sf::Color::White);
+        } else {
+            // one sim step per frame, so the displacement over 1/60 s is the obstacle velocity
+            fluid_main->moveObstacle(circleId, circleCenterX, circleCenterY, 1.0f/60.0f);
 
-        auto getScientificColor = [](float val, float minVal, float maxVal) -> sf::Color {
-            val = std::max(minVal, std::min(maxVal - 0.0001f, val));
-            float d = maxVal - minVal;
-            val = (d == 0.0f) ? 0.5f : (val - minVal) / d;
-            
-            float m = 0.25f;
-            int num = static_cast<int>(val / m);
-            float s = (val - num * m) / m;
-            float r, g, b;
+            // Update fluid simulation frame by frame
+            fluid_main->simulate(1.0f/60.0f, 20, g);
             
-            switch (num) {
-                case 0: r = 0.0f; g = s; b = 1.0f; break;      // Blue to Cyan
-                case 1: r = 0.0f; g = 1.0f; b = 1.0f - s; break; // Cyan to Green
-                case 2: r = s; g = 1.0f; b = 0.0f; break;      // Green to Yellow
-            case 3: r = 1.0f; g = 1.0f - s; b = 0.0f; break; // Yellow to Red
-            }
-            
-            return sf::Color(
-                static_cast<uint8_t>(255 * r),
-                static_cast<uint8_t>(255 * g),
-                static_cast<uint8_t>(255 * b)
-            );
-        };
-
-        // Draw pressure field visualization
-        float cellWidth = 8.0f; 
-        float cellHeight = 6.0f; 
-        
-        // Find pressure range for proper normalization
-        float minPressure = pressureField[0];
-        float maxPressure = pressureField[0];
-        for (int i = 0; i < (width + 2) * (height + 2); i++) {
-            minPressure = std::min(minPressure, pressureField[i]);
-            maxPressure = std::max(maxPressure, pressureField[i]);
-        }
-        
-        for (int i = 1; i < width + 1; i++) {
-            for (int j = 1; j < height + 1; j++) {
-                int index = i * (height + 2) + j;  // Fix indexing to match Fluid class
-                float pressure = pressureField[index];
-                float smoke = smokeField[index];
-                
-                sf::RectangleShape cell;
-                cell.setSize(sf::Vector2f(cellWidth, cellHeight));
-                cell.setPosition(sf::Vector2f((i-1) * cellWidth, (j-1) * cellHeight));
-                
-                // Blend smoke (white) with pressure color (for efficiency; otherwise adnimation is very slow :(
-                sf::Color pressureColor = getScientificColor(pressure, minPressure, maxPressure);
-                uint8_t r = static_cast<uint8_t>(pressureColor.r * (smoke) + 255 * (1.0f - smoke));
-                uint8_t g = static_cast<uint8_t>(pressureColor.g * (smoke) + 255 * (1.0f - smoke));
-                uint8_t b = static_cast<uint8_t>(pressureColor.b * (smoke) + 255 * (1.0f - smoke));
-                
-                cell.setFillColor(sf::Color(r, g, b));
-                window.draw(cell);
-            }
+            // Get pressure field and smoke field for visualization
+            float* pressureField = fluid_main->getPressureField();
+            const float* smokeField = fluid_main->getFineSmokeField();
+
+            window.clear(sf::Color::White);
+
+            // Draw pressure field visualization, one texture for the whole grid
+            renderer.update(pressureField, smokeField);
+            renderer.draw(window);
         }
 
         // Draw circle
@@ -252,5 +291,9 @@ int main() {
         window.display();
     }
 
+    if (sim) {
+        sim->stop();
+    }
+
     return 0;
 } 
\ No newline at end of file